@@ -0,0 +1,273 @@
+/*
+ * AudioAnalysis.cpp
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AudioAnalysis.h"
+
+#include <QtGlobal>
+#include <QDebug>
+#include <qmath.h>
+#include <cstring>
+
+// GStreamer includes.
+#include <gst/gst.h>
+
+namespace mmp {
+
+// Maximum number of measures waiting for their audio to be heard (a few seconds).
+static const int MAX_PENDING_MEASURES = 256;
+
+AudioAnalysis::AudioAnalysis()
+{
+  reset();
+}
+
+bool AudioAnalysis::createTap(GstElement** level, GstElement** spectrum)
+{
+  *level    = gst_element_factory_make("level", NULL);
+  *spectrum = gst_element_factory_make("spectrum", NULL);
+  if (!*level || !*spectrum)
+  {
+    qWarning() << "Not all audio analysis elements could be created." << endl;
+    if (*level) gst_object_unref(*level);
+    if (*spectrum) gst_object_unref(*spectrum);
+    *level = *spectrum = NULL;
+    return false;
+  }
+
+  g_object_set(*level,
+               "interval", (guint64) INTERVAL * GST_MSECOND,
+               "post-messages", TRUE,
+               NULL);
+
+  // Channels are mixed down before the FFT.
+  g_object_set(*spectrum,
+               "bands", (guint) N_BINS,
+               "threshold", (gint) MIN_DB,
+               "interval", (guint64) INTERVAL * GST_MSECOND,
+               "post-messages", TRUE,
+               "message-phase", FALSE,
+               "multi-channel", FALSE,
+               NULL);
+  return true;
+}
+
+bool AudioAnalysis::handleMessage(GstMessage* message)
+{
+  if (GST_MESSAGE_TYPE(message) != GST_MESSAGE_ELEMENT)
+    return false;
+
+  const GstStructure* s = gst_message_get_structure(message);
+  if (!s)
+    return false;
+
+  Measure measure;
+  if (!gst_structure_get_clock_time(s, "running-time", &measure.runningTime))
+    measure.runningTime = GST_CLOCK_TIME_NONE;
+
+  // Level: keep the loudest channel.
+  if (gst_structure_has_name(s, "level"))
+  {
+    const GValue* rms = gst_structure_get_value(s, "rms");
+    if (!rms)
+      return true;
+    G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+    GValueArray* channels = (GValueArray*) g_value_get_boxed(rms);
+    qreal db = MIN_DB;
+    for (guint c=0; c<channels->n_values; c++)
+      db = qMax(db, g_value_get_double(g_value_array_get_nth(channels, c)));
+    G_GNUC_END_IGNORE_DEPRECATIONS
+
+    measure.level = _normalize(db);
+    _push(measure);
+    return true;
+  }
+
+  // Spectrum: average the power of the frequency bins of each band.
+  else if (gst_structure_has_name(s, "spectrum"))
+  {
+    const GValue* magnitudes = gst_structure_get_value(s, "magnitude");
+    if (!magnitudes)
+      return true;
+    int nBins = gst_value_list_get_size(magnitudes);
+
+    measure.level = -1;
+    for (int b=0; b<N_BANDS; b++)
+    {
+      int first = (b == 0 ? 0 : nBins >> (N_BANDS - b));
+      int last  = nBins >> (N_BANDS - 1 - b);
+      qreal power = 0;
+      for (int i=first; i<last; i++)
+        power += qPow(10, g_value_get_float(gst_value_list_get_value(magnitudes, i)) / 10);
+      measure.bands[b] = (last > first ? _normalize(10 * log10(power / (last - first))) : 0);
+    }
+    _push(measure);
+    return true;
+  }
+
+  return false;
+}
+
+void AudioAnalysis::update(quint64 runningTime)
+{
+  QMutexLocker locker(&_mutex);
+  while (!_pending.isEmpty())
+  {
+    const Measure& measure = _pending.first();
+    if (GST_CLOCK_TIME_IS_VALID(runningTime) && GST_CLOCK_TIME_IS_VALID(measure.runningTime) &&
+        measure.runningTime > runningTime)
+      break;
+
+    if (measure.level >= 0)
+      _level = measure.level;
+    else
+      memcpy(_bands, measure.bands, sizeof(_bands));
+    _pending.removeFirst();
+  }
+}
+
+void AudioAnalysis::reset()
+{
+  QMutexLocker locker(&_mutex);
+  _pending.clear();
+  _level = 0;
+  for (int b=0; b<N_BANDS; b++)
+    _bands[b] = 0;
+}
+
+qreal AudioAnalysis::getLevel() const
+{
+  QMutexLocker locker(&_mutex);
+  return _level;
+}
+
+qreal AudioAnalysis::getBand(int i) const
+{
+  QMutexLocker locker(&_mutex);
+  return (i >= 0 && i < N_BANDS ? _bands[i] : 0);
+}
+
+qreal AudioAnalysis::_normalize(qreal db)
+{
+  return qBound(qreal(0), (db - MIN_DB) / -MIN_DB, qreal(1));
+}
+
+void AudioAnalysis::_push(const Measure& measure)
+{
+  QMutexLocker locker(&_mutex);
+
+  // Nobody is reading (eg. paused): drop the oldest measures.
+  if (_pending.size() >= MAX_PENDING_MEASURES)
+    _pending.removeFirst();
+  _pending.append(measure);
+}
+
+/* Implementation of the AudioInput class */
+GstElement* AudioInput::_pipeline = NULL;
+GstBus* AudioInput::_bus = NULL;
+AudioAnalysis AudioInput::_analysis;
+
+// Measures are handled on the streaming thread, other messages are left on the bus.
+static GstBusSyncReply _audioInputSyncHandler(GstBus* bus, GstMessage* message, AudioAnalysis* analysis)
+{
+  Q_UNUSED(bus);
+  return (analysis->handleMessage(message) ? GST_BUS_DROP : GST_BUS_PASS);
+}
+
+bool AudioInput::start()
+{
+  stop();
+
+  _pipeline = gst_pipeline_new("audioinput");
+  GstElement* source  = gst_element_factory_make("autoaudiosrc", NULL);
+  GstElement* convert = gst_element_factory_make("audioconvert", NULL);
+  GstElement* sink    = gst_element_factory_make("fakesink", NULL);
+  GstElement* level;
+  GstElement* spectrum;
+  if (!_pipeline || !source || !convert || !sink || !AudioAnalysis::createTap(&level, &spectrum))
+  {
+    qWarning() << "Not all audio input elements could be created." << endl;
+    if (source) gst_object_unref(source);
+    if (convert) gst_object_unref(convert);
+    if (sink) gst_object_unref(sink);
+    stop();
+    return false;
+  }
+
+  // Measures are used as soon as they are made.
+  g_object_set(sink, "sync", FALSE, NULL);
+
+  gst_bin_add_many(GST_BIN(_pipeline), source, convert, level, spectrum, sink, NULL);
+  if (!gst_element_link_many(source, convert, level, spectrum, sink, NULL))
+  {
+    qWarning() << "Could not link audio input elements." << endl;
+    stop();
+    return false;
+  }
+
+  _bus = gst_element_get_bus(_pipeline);
+  gst_bus_set_sync_handler(_bus, (GstBusSyncHandler) _audioInputSyncHandler, &_analysis, NULL);
+
+  if (gst_element_set_state(_pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+  {
+    qWarning() << "Cannot start audio input." << endl;
+    stop();
+    return false;
+  }
+
+  qDebug() << "Audio input started." << endl;
+  return true;
+}
+
+void AudioInput::stop()
+{
+  if (_pipeline)
+    gst_element_set_state(_pipeline, GST_STATE_NULL);
+  if (_bus)
+  {
+    gst_bus_set_sync_handler(_bus, NULL, NULL, NULL);
+    gst_object_unref(_bus);
+    _bus = NULL;
+  }
+  if (_pipeline)
+  {
+    gst_object_unref(_pipeline);
+    _pipeline = NULL;
+  }
+  _analysis.reset();
+}
+
+void AudioInput::update()
+{
+  if (!_pipeline)
+    return;
+
+  _analysis.update(GST_CLOCK_TIME_NONE);
+
+  // Stop on error (eg. input unplugged).
+  GstMessage* msg = gst_bus_pop_filtered(_bus, GST_MESSAGE_ERROR);
+  if (msg)
+  {
+    GError* err = NULL;
+    gst_message_parse_error(msg, &err, NULL);
+    qWarning() << "Audio input error: " << (err ? err->message : "unknown") << endl;
+    g_clear_error(&err);
+    gst_message_unref(msg);
+    stop();
+  }
+}
+
+}
@@ -0,0 +1,130 @@
+/*
+ * AudioAnalysis.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUDIO_ANALYSIS_H_
+#define AUDIO_ANALYSIS_H_
+
+#include <QList>
+#include <QMutex>
+
+#include "MM.h"
+
+// Avoids including GStreamer headers in the whole project.
+typedef struct _GstElement GstElement;
+typedef struct _GstMessage GstMessage;
+typedef struct _GstBus GstBus;
+
+namespace mmp {
+
+/**
+ * Level and band energies of an audio stream.
+ *
+ * Measures are made on the streaming thread by a GStreamer level element (RMS level) and
+ * spectrum element (FFT), tapped into an audio branch (see createTap()). Their messages are
+ * handled as they are posted (handleMessage(), from a bus sync handler) and kept until the
+ * audio they were measured on is heard (update()). All values are normalized to [0, 1].
+ */
+class AudioAnalysis
+{
+public:
+  /// Number of bands (octaves, the highest one ending at half the sample rate).
+  static const int N_BANDS = 8;
+
+  /// Number of frequency bins computed by the FFT (must be at least 2^N_BANDS).
+  static const int N_BINS = 256;
+
+  /// Interval between two measures (in ms).
+  static const int INTERVAL = 20;
+
+  /// Level (in dB) mapped to 0 (levels at 0 dB are mapped to 1).
+  static const int MIN_DB = -60;
+
+  AudioAnalysis();
+
+  /**
+   * Creates the elements analyzing an audio stream, to be linked one after the other
+   * (in that order) in an audio branch. Returns false on failure.
+   */
+  static bool createTap(GstElement** level, GstElement** spectrum);
+
+  /// Handles a message of the tap (from any thread). Returns false if not one of its messages.
+  bool handleMessage(GstMessage* message);
+
+  /**
+   * Makes the measures made on audio played up to given running time (in ns) current.
+   * Passing GST_CLOCK_TIME_NONE makes the last measures current (eg. for live input).
+   */
+  void update(quint64 runningTime);
+
+  /// Discards all measures.
+  void reset();
+
+  /// RMS level (loudest channel).
+  qreal getLevel() const;
+
+  /// Energy in band i (0 = lowest frequencies).
+  qreal getBand(int i) const;
+
+private:
+  struct Measure
+  {
+    quint64 runningTime;
+    qreal   level;            // < 0 ==> not a level measure
+    qreal   bands[N_BANDS];
+  };
+
+  static qreal _normalize(qreal db);
+
+  // Adds a measure to the pending ones.
+  void _push(const Measure& measure);
+
+  mutable QMutex _mutex;
+  QList<Measure> _pending;
+
+  qreal _level;
+  qreal _bands[N_BANDS];
+};
+
+/**
+ * Analysis of the default audio input (eg. line-in), used as a modulation source.
+ * Not running unless start() is called (see command line options).
+ */
+class AudioInput
+{
+public:
+  /// Starts capturing and analyzing. Returns false on error.
+  static bool start();
+
+  /// Stops capturing.
+  static void stop();
+
+  static bool isActive() { return _pipeline != NULL; }
+
+  /// Makes the last measures current (to be called regularly from the main thread).
+  static void update();
+
+  static const AudioAnalysis& analysis() { return _analysis; }
+
+private:
+  static GstElement* _pipeline;
+  static GstBus* _bus;
+  static AudioAnalysis _analysis;
+};
+
+}
+
+#endif /* AUDIO_ANALYSIS_H_ */
@@ -20,6 +20,7 @@
 #include "Element.h"
 
 #include <QDebug>
+#include <QMetaProperty>
 
 namespace mmp {
 
@@ -49,6 +50,72 @@ void Element::setName(const QString& name)
   }
 }
 
+bool Element::setModulation(const QString& modulation)
+{
+  QList<ModulationBinding> bindings;
+  if (!Modulation::parse(modulation, &bindings))
+    return false;
+
+  // Only writable numeric properties can be modulated.
+  foreach (const ModulationBinding& binding, bindings)
+  {
+    int index = metaObject()->indexOfProperty(binding.property.toLatin1());
+    if (index < 0 || !metaObject()->property(index).isWritable() ||
+        !_isNumericType(metaObject()->property(index).userType()))
+    {
+      qWarning() << "Property '" << binding.property << "' cannot be modulated." << endl;
+      return false;
+    }
+  }
+
+  QString previous = getModulation();
+  _modulationBindings = bindings;
+
+  // Properties that are not modulated anymore go back to their base value.
+  foreach (const QString& name, _modulationBaseValues.keys())
+  {
+    bool bound = false;
+    foreach (const ModulationBinding& binding, bindings)
+      bound = bound || (binding.property == name);
+    if (!bound)
+    {
+      setProperty(name.toLatin1(), _modulationBaseValues.take(name));
+      _modulatedValues.remove(name);
+    }
+  }
+
+  if (getModulation() != previous)
+    _emitPropertyChanged("modulation");
+  return true;
+}
+
+bool Element::applyModulation()
+{
+  bool changed = false;
+  foreach (const ModulationBinding& binding, _modulationBindings)
+  {
+    qreal value;
+    if (Modulation::getSourceValue(binding.source, &value))
+    {
+      QByteArray name = binding.property.toLatin1();
+      QVariant current = property(name);
+
+      // Property was set since last modulated (or never was): this is its base value.
+      if (!_modulatedValues.contains(binding.property) || _modulatedValues[binding.property] != current)
+        _modulationBaseValues[binding.property] = current;
+
+      // Modulated values change every frame: do not flood listeners (eg. the GUI).
+      bool blocked = blockSignals(true);
+      setProperty(name, binding.minimum + (binding.maximum - binding.minimum) * value);
+      blockSignals(blocked);
+
+      _modulatedValues[binding.property] = property(name);
+      changed = changed || (_modulatedValues[binding.property] != current);
+    }
+  }
+  return changed;
+}
+
 void Element::setLocked(bool locked)
 {
   if (locked != _isLocked)
@@ -79,10 +146,36 @@ void Element::read(const QDomElement& obj)
 void Element::write(QDomElement& obj)
 {
   Serializable::write(obj);
+
+  // Save base values rather than transient modulated ones.
+  QList<QString> attributeNames = _propertiesAttributes();
+  foreach (const QString& name, _modulationBaseValues.keys())
+  {
+    QString value = _modulationBaseValues[name].toString();
+    if (attributeNames.contains(name))
+      obj.setAttribute(name, value);
+    else
+    {
+      QDomElement node = obj.firstChildElement(name);
+      if (!node.isNull())
+      {
+        while (node.hasChildNodes())
+          node.removeChild(node.firstChild());
+        node.appendChild(obj.ownerDocument().createTextNode(value));
+      }
+    }
+  }
+
   // Set id.
   obj.setAttribute("id", getId());
 }
 
+bool Element::_isNumericType(int type)
+{
+  return (type == QMetaType::Int || type == QMetaType::UInt ||
+          type == QMetaType::Float || type == QMetaType::Double);
+}
+
 void Element::_emitPropertyChanged(const QString& propertyName)
 {
   emit propertyChanged(getId(), propertyName, property(propertyName.toAscii()));
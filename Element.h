@@ -23,9 +23,12 @@
 #include <QtGlobal>
 #include <QObject>
 #include <QIcon>
+#include <QMap>
+#include <QVariant>
 
 #include "Serializable.h"
 #include "UidAllocator.h"
+#include "Modulation.h"
 
 #include <QEvent>
 Q_DECLARE_METATYPE(uid)
@@ -41,6 +44,7 @@ class Element : public Serializable
   Q_PROPERTY(bool    locked  READ isLocked   WRITE setLocked)
   Q_PROPERTY(float   opacity READ getOpacity WRITE setOpacity NOTIFY propertyChanged)
   Q_PROPERTY(QIcon   icon    READ getIcon)
+  Q_PROPERTY(QString modulation READ getModulation WRITE _writeModulation)
 
 public:
   typedef QSharedPointer<Element> ptr;
@@ -64,6 +68,18 @@ public:
 
   virtual QIcon getIcon() const { return QIcon(); }
 
+  /// Binds numeric properties to modulation sources (see Modulation for syntax). Returns false if invalid.
+  virtual bool setModulation(const QString& modulation);
+  QString getModulation() const { return Modulation::toString(_modulationBindings); }
+
+  bool hasModulation() const { return !_modulationBindings.isEmpty(); }
+
+  /**
+   * Sets modulated properties to the current value of their source (changes are not notified).
+   * Returns true iff one of them changed.
+   */
+  bool applyModulation();
+
   virtual void read(const QDomElement& obj);
   virtual void write(QDomElement& obj);
 
@@ -77,10 +93,23 @@ protected:
   void _emitPropertyChanged(const QString& propertyName);
 
 private:
+  // Setter of the modulation property (which must return void).
+  void _writeModulation(const QString& modulation) { setModulation(modulation); }
+
+  // Returns true iff properties of given type can be modulated.
+  static bool _isNumericType(int type);
+
   uid _id;
   QString _name;
   bool _isLocked;
   float _opacity;
+  QList<ModulationBinding> _modulationBindings;
+
+  // Values modulated properties had before modulation (or were later set to) and values last
+  // set by modulation, by property name.
+  QMap<QString, QVariant> _modulationBaseValues;
+  QMap<QString, QVariant> _modulatedValues;
+
   UidAllocator* _allocator;
 };
 
@@ -132,6 +132,12 @@ public:
   // Override the parent, checking to make sure the vertices are displaced correctly.
   virtual void setVertex(int i, const QPointF& v);
 
+  /// Bounding box of the square circumscribing the ellipse.
+  virtual QRectF getBoundingRect() const
+  {
+    return fromUnitCircle().mapRect(QRectF(-1, -1, 2, 2));
+  }
+
 protected:
   /// Returns a new MShape (using default constructor).
   virtual MShape* _create() const { return new Ellipse(); }
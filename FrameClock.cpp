@@ -0,0 +1,228 @@
+/*
+ * FrameClock.cpp
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FrameClock.h"
+
+#include <qmath.h>
+#include <algorithm>
+
+#include "SyncClock.h"
+
+namespace mmp {
+
+// Time after which the clock ticks anyway if no frame was presented while swap driven and the
+// tick rate is unknown (in ms).
+static const int SWAP_TIMEOUT = 100;
+
+FrameClock::FrameClock(QObject* parent)
+  : QObject(parent),
+    _framesPerSecond(0),
+    _refreshRate(0),
+    _swapInterval(1),
+    _active(false),
+    _swapDriven(false),
+    _origin(0),
+    _nTicks(0),
+    _nextFrameTime(0),
+    _lastTimestamp(-1),
+    _missedFrames(0),
+    _tickPending(false)
+{
+  _timer.setSingleShot(true);
+  _timer.setTimerType(Qt::PreciseTimer);
+  connect(&_timer, SIGNAL(timeout()), this, SLOT(_timerTick()));
+  _elapsed.start();
+}
+
+void FrameClock::start()
+{
+  _active = true;
+  resetFrameTimes();
+
+  // First tick is due one period from now.
+  _origin = _elapsed.nsecsElapsed();
+  _nTicks = 1;
+  _scheduleTimer();
+}
+
+void FrameClock::stop()
+{
+  _active = false;
+  _timer.stop();
+}
+
+void FrameClock::setFramesPerSecond(qreal fps)
+{
+  _framesPerSecond = qMax(fps, 0.0);
+
+  // Restart the timeline at the new rate.
+  _origin = _elapsed.nsecsElapsed();
+  _nTicks = 1;
+  if (_active)
+    _scheduleTimer();
+}
+
+void FrameClock::setSwapDriven(bool swapDriven)
+{
+  if (swapDriven == _swapDriven)
+    return;
+
+  // Frame times do not compare between presentations and timer ticks.
+  _swapDriven = swapDriven;
+  resetFrameTimes();
+
+  _origin = _elapsed.nsecsElapsed();
+  _nTicks = 1;
+  if (_active)
+    _scheduleTimer();
+}
+
+qreal FrameClock::getTickRate() const
+{
+  if (_swapDriven && _refreshRate > 0 && _swapInterval > 0)
+    return _refreshRate / _swapInterval;
+  else
+    return _framesPerSecond;
+}
+
+void FrameClock::presented()
+{
+  if (!_swapDriven)
+    return;
+
+  // Frames due every swap interval vertical blanks (unless the timer ticked in between).
+  qint64 timestamp = _elapsed.nsecsElapsed();
+  if (_lastTimestamp >= 0)
+  {
+    _addFrameTime(timestamp - _lastTimestamp);
+    if (_refreshRate > 0 && _swapInterval > 0)
+    {
+      int vblanks = qRound((timestamp - _lastTimestamp) * _refreshRate / 1e9);
+      if (vblanks > _swapInterval)
+        _missedFrames += (vblanks - _swapInterval) / _swapInterval;
+    }
+  }
+  _lastTimestamp = timestamp;
+
+  // Tick once the output is painted (a single tick for frames presented meanwhile).
+  if (!_tickPending)
+  {
+    _tickPending = true;
+    QMetaObject::invokeMethod(this, "_presentedTick", Qt::QueuedConnection);
+  }
+}
+
+qreal FrameClock::getFrameTimePercentile(qreal fraction) const
+{
+  if (_frameTimes.isEmpty())
+    return 0;
+
+  QVector<qreal> sorted = _frameTimes;
+  std::sort(sorted.begin(), sorted.end());
+  return sorted[qBound(0, qCeil(fraction * sorted.size()) - 1, sorted.size() - 1)];
+}
+
+void FrameClock::resetFrameTimes()
+{
+  _frameTimes.clear();
+  _nextFrameTime = 0;
+  _lastTimestamp = -1;
+}
+
+void FrameClock::_timerTick()
+{
+  if (!_active)
+    return;
+
+  // No new frame presented since last tick was processed (eg. nothing changed): tick from the
+  // timer meanwhile (the time until the next presentation is not a frame time).
+  if (_swapDriven)
+  {
+    _lastTimestamp = -1;
+    emit tick();
+    _scheduleTimer();
+    return;
+  }
+
+  qint64 now = _elapsed.nsecsElapsed();
+  qint64 period = (_framesPerSecond > 0 ? qint64(1e9 / _framesPerSecond) : 0);
+  if (_lastTimestamp >= 0)
+    _addFrameTime(now - _lastTimestamp);
+  _lastTimestamp = now;
+
+  // Skip the ticks it is too late for.
+  if (SyncClock::isActive() || period == 0)
+    _nTicks++;
+  else
+  {
+    qint64 lateness = now - (_origin + _nTicks * period);
+    qint64 missed = (lateness > 0 ? lateness / period : 0);
+    _missedFrames += missed;
+    _nTicks += 1 + missed;
+  }
+
+  // Schedule next tick before processing this one (so that processing does not delay it).
+  _scheduleTimer();
+  emit tick();
+}
+
+void FrameClock::_presentedTick()
+{
+  // Watchdog starts once the tick is processed (the frame it renders is presented afterwards).
+  if (_active && _swapDriven)
+  {
+    emit tick();
+    _scheduleTimer();
+  }
+
+  // Frame of the tick is now rendered (presentations meanwhile only queue up a single tick).
+  _tickPending = false;
+}
+
+void FrameClock::_scheduleTimer()
+{
+  // Watchdog in case no new frame gets presented: a bit more than a tick period.
+  if (_swapDriven)
+  {
+    qreal rate = getTickRate();
+    _timer.start(rate > 0 ? qCeil(1500 / rate) : SWAP_TIMEOUT);
+    return;
+  }
+
+  // Align ticks on the timeline shared with other instances.
+  if (SyncClock::isActive())
+  {
+    _timer.start(SyncClock::msecsToNextTick(_framesPerSecond));
+    return;
+  }
+
+  qint64 period = (_framesPerSecond > 0 ? qint64(1e9 / _framesPerSecond) : 0);
+  qint64 remaining = _origin + _nTicks * period - _elapsed.nsecsElapsed();
+  _timer.start(int((qMax(remaining, qint64(0)) + 500000) / 1000000));
+}
+
+void FrameClock::_addFrameTime(qint64 nsecs)
+{
+  qreal msecs = nsecs / 1e6;
+  if (_frameTimes.size() < N_FRAME_TIMES)
+    _frameTimes.append(msecs);
+  else
+    _frameTimes[_nextFrameTime] = msecs;
+  _nextFrameTime = (_nextFrameTime + 1) % N_FRAME_TIMES;
+}
+
+}
@@ -0,0 +1,127 @@
+/*
+ * FrameClock.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_CLOCK_H_
+#define FRAME_CLOCK_H_
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
+
+namespace mmp {
+
+/**
+ * Clock of the render loop: emits tick() once per output frame.
+ *
+ * While swap driven (ie. while the output window is shown with vertical sync), ticks follow the
+ * buffer swaps of the output window (see presented()), that is one tick every swap interval
+ * vertical blanks of its display, and from a timer at about that rate while no new frame gets
+ * presented (eg. nothing changed). Otherwise ticks come from a timer at the
+ * requested frame rate, scheduled on deadlines computed in nanoseconds from a fixed origin so
+ * that they neither get truncated nor drift (or on the timeline shared with other instances,
+ * see SyncClock).
+ *
+ * Keeps the last frame times and counts missed frames: frames presented one or more swap
+ * intervals after their due time (as estimated from the refresh rate), or timer ticks one or
+ * more periods late.
+ */
+class FrameClock : public QObject
+{
+  Q_OBJECT
+
+public:
+  FrameClock(QObject* parent = 0);
+
+  void start();
+  void stop();
+  bool isActive() const { return _active; }
+
+  /// Rate of the timer ticks.
+  void setFramesPerSecond(qreal fps);
+  qreal getFramesPerSecond() const { return _framesPerSecond; }
+
+  /// Number of vertical blanks between two buffer swaps (0 for no vertical sync).
+  void setSwapInterval(int interval) { _swapInterval = qMax(interval, 0); }
+  int getSwapInterval() const { return _swapInterval; }
+
+  /// Ticks on presented frames (see presented()) rather than on the timer.
+  void setSwapDriven(bool swapDriven);
+  bool isSwapDriven() const { return _swapDriven; }
+
+  /// Refresh rate of the display frames are presented on (in Hz, 0 if unknown).
+  void setRefreshRate(qreal rate) { _refreshRate = qMax(rate, 0.0); }
+
+  /// Actual rate of the ticks: refresh rate over swap interval while swap driven, frame rate otherwise.
+  qreal getTickRate() const;
+
+
+  /// Frame time (in ms) that given fraction (eg. 0.95) of the last frames did not exceed.
+  qreal getFrameTimePercentile(qreal fraction) const;
+
+  /// Number of frames missed since the clock was created.
+  quint64 getMissedFrames() const { return _missedFrames; }
+
+  /// Forgets the last frame times (eg. when changing the source of ticks).
+  void resetFrameTimes();
+
+  /// Number of frames whose times are kept.
+  static const int N_FRAME_TIMES = 256;
+
+signals:
+  void tick();
+
+public slots:
+  /// Reports a frame presented by the output window (ie. once its buffers were swapped).
+  void presented();
+
+private slots:
+  void _timerTick();
+  void _presentedTick();
+
+private:
+  // Schedules the timer for the next tick.
+  void _scheduleTimer();
+
+  // Adds a frame time.
+  void _addFrameTime(qint64 nsecs);
+
+  QTimer _timer;
+  QElapsedTimer _elapsed;
+  qreal _framesPerSecond;
+  qreal _refreshRate;
+  int _swapInterval;
+  bool _active;
+  bool _swapDriven;
+
+  // Timer ticks are due at _origin + n * period (in ns on _elapsed).
+  qint64 _origin;
+  qint64 _nTicks;
+
+  // Statistics.
+  QVector<qreal> _frameTimes; // in ms (circular)
+  int _nextFrameTime;
+  qint64 _lastTimestamp;      // -1 if none
+  quint64 _missedFrames;
+
+  // True while a presented frame waits for its tick to be processed (presentations are not queued up).
+  bool _tickPending;
+};
+
+}
+
+#endif /* FRAME_CLOCK_H_ */
@@ -0,0 +1,239 @@
+/*
+ * FrameProvider.cpp
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FrameProvider.h"
+#include <QDebug>
+
+namespace mmp {
+
+FrameProvider::FrameProvider() :
+  _provider(NULL),
+  _instance(NULL),
+  _width(0),
+  _height(0),
+  _framesPerSecond(0),
+  _front(0),
+  _backReady(false),
+  _stop(0),
+  _playing(false),
+  _timeOffset(0)
+{
+}
+
+FrameProvider::~FrameProvider()
+{
+  unload();
+}
+
+bool FrameProvider::load(const QString& libraryFile, const QString& config)
+{
+  unload();
+
+  // Load library and find entry point.
+  _library.setFileName(libraryFile);
+  if (!_library.load())
+  {
+    qWarning() << "Cannot load plugin " << libraryFile << ": " << _library.errorString() << endl;
+    return false;
+  }
+
+  mmp_get_frame_provider_func entryPoint =
+      (mmp_get_frame_provider_func) _library.resolve(MMP_FRAME_PROVIDER_ENTRY_POINT);
+  const mmp_frame_provider* provider = (entryPoint ? entryPoint() : NULL);
+  if (!provider)
+  {
+    qWarning() << "Plugin " << libraryFile << " is not a frame provider." << endl;
+    _library.unload();
+    return false;
+  }
+
+  if (provider->api_version != MMP_FRAME_PROVIDER_API_VERSION ||
+      !provider->create || !provider->destroy || !provider->width || !provider->height ||
+      !provider->pixel_format || !provider->produce_frame)
+  {
+    qWarning() << "Plugin " << libraryFile << " uses an unsupported interface (version "
+               << provider->api_version << ")." << endl;
+    _library.unload();
+    return false;
+  }
+
+  // Create instance.
+  QByteArray configData = config.toUtf8();
+  void* instance = provider->create(configData.constData());
+  if (!instance)
+  {
+    qWarning() << "Plugin " << libraryFile << " could not be initialized." << endl;
+    _library.unload();
+    return false;
+  }
+
+  int width  = provider->width(instance);
+  int height = provider->height(instance);
+  if (width <= 0 || height <= 0 || provider->pixel_format(instance) != MMP_PIXEL_FORMAT_RGBA8)
+  {
+    qWarning() << "Plugin " << libraryFile << " has an unsupported frame format." << endl;
+    provider->destroy(instance);
+    _library.unload();
+    return false;
+  }
+
+  _provider = provider;
+  _instance = instance;
+  _name     = QString::fromUtf8(provider->name ? provider->name : "");
+  _width    = width;
+  _height   = height;
+  _framesPerSecond = (provider->frames_per_second ? provider->frames_per_second(instance) : 0);
+
+  // Frames are uploaded as is: allocate both buffers (black) at the exact size.
+  for (int i=0; i<2; i++)
+    _buffers[i].fill(0, _width * _height * 4);
+  _front = 0;
+  _backReady = false;
+
+  // Start producing frames.
+  _stop = 0;
+  start();
+
+  return true;
+}
+
+void FrameProvider::unload()
+{
+  if (!_instance)
+    return;
+
+  // Stop worker.
+  _mutex.lock();
+  _stop = 1;
+  _frameConsumed.wakeAll();
+  _mutex.unlock();
+  wait();
+
+  _provider->destroy(_instance);
+  _instance = NULL;
+  _provider = NULL;
+  _library.unload();
+
+  _width = _height = 0;
+  for (int i=0; i<2; i++)
+    _buffers[i].clear();
+}
+
+void FrameProvider::setPlaying(bool playing)
+{
+  QMutexLocker locker(&_mutex);
+  if (playing == _playing)
+    return;
+
+  if (playing)
+    _clock.start();
+  else
+    _timeOffset += _clock.elapsed();
+  _playing = playing;
+
+  _frameConsumed.wakeAll();
+}
+
+void FrameProvider::rewind()
+{
+  QMutexLocker locker(&_mutex);
+  _timeOffset = 0;
+  if (_playing)
+    _clock.start();
+}
+
+const uchar* FrameProvider::getBits()
+{
+  // Swap buffers if a new frame is ready.
+  if (_backReady)
+  {
+    _front = 1 - _front;
+    _backReady = false;
+    _frameConsumed.wakeAll();
+  }
+
+  return (_buffers[_front].isEmpty() ? NULL : _buffers[_front].constData());
+}
+
+double FrameProvider::_time() const
+{
+  return (_timeOffset + (_playing ? _clock.elapsed() : 0)) / 1000.0;
+}
+
+void FrameProvider::run()
+{
+  qint64 nextFrameTime = 0; // in ms of playback time
+  int stride = _width * 4;
+
+  while (!_stop.load())
+  {
+    // Claim back buffer (a pending frame is dropped: it will be replaced by a more recent one).
+    _mutex.lock();
+    bool playing = _playing;
+    double time  = _time();
+    _backReady   = false;
+    uchar* back  = _buffers[1 - _front].data();
+    _mutex.unlock();
+
+    if (!playing)
+    {
+      msleep(IDLE_INTERVAL);
+      continue;
+    }
+
+    // Render directly into back buffer (outside of lock: the front buffer may be uploading).
+    int result = _provider->produce_frame(_instance, time, back, stride);
+    if (result < 0)
+    {
+      qWarning() << "Plugin " << _name << " failed to produce a frame: stopped." << endl;
+      break;
+    }
+
+    _mutex.lock();
+    if (result == MMP_FRAME_NEW)
+      _backReady = true;
+
+    // Fixed rate: wait until next frame is due.
+    if (_framesPerSecond > 0)
+    {
+      // Keep a regular pace, but resynchronize after a rewind or if we are late.
+      qint64 period = qMax(qRound64(1000 / _framesPerSecond), qint64(1));
+      qint64 now    = qint64(time * 1000);
+      nextFrameTime += period;
+      if (nextFrameTime < now || nextFrameTime > now + period)
+        nextFrameTime = now + period;
+
+      qint64 delay;
+      while (!_stop.load() && _playing && (delay = nextFrameTime - qint64(_time() * 1000)) > 0)
+        _frameConsumed.wait(&_mutex, (unsigned long) delay);
+    }
+
+    // One frame per rendered frame: wait until this frame was displayed.
+    else if (_backReady)
+    {
+      while (_backReady && _playing && !_stop.load())
+        _frameConsumed.wait(&_mutex, IDLE_INTERVAL * 10);
+    }
+
+    // Nothing new: do not spin.
+    else
+      _frameConsumed.wait(&_mutex, IDLE_INTERVAL);
+    _mutex.unlock();
+  }
+}
+
+}
@@ -0,0 +1,113 @@
+/*
+ * FrameProvider.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_PROVIDER_H_
+#define FRAME_PROVIDER_H_
+
+#include <QThread>
+#include <QLibrary>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QAtomicInt>
+
+#include "MM.h"
+#include "FrameProviderPlugin.h"
+
+namespace mmp {
+
+/**
+ * Host side of a frame provider plugin (see FrameProviderPlugin.h).
+ *
+ * Loads the shared library, creates an instance of the provider and calls it from a
+ * worker thread. Frames are double-buffered: the provider renders into the back buffer
+ * while the front buffer is being uploaded, and buffers are swapped by getBits().
+ */
+class FrameProvider : public QThread
+{
+  Q_OBJECT
+
+public:
+  FrameProvider();
+  virtual ~FrameProvider();
+
+  /// Loads plugin from given library file and starts the worker. Returns false on error.
+  bool load(const QString& libraryFile, const QString& config);
+
+  /// Stops the worker and unloads the plugin.
+  void unload();
+
+  bool isLoaded() const { return _instance != NULL; }
+
+  /// Name of the provider (as reported by the plugin).
+  QString getName() const { return _name; }
+
+  int getWidth() const  { return _width; }
+  int getHeight() const { return _height; }
+
+  /// Starts/pauses frame production (time does not advance while paused).
+  void setPlaying(bool playing);
+
+  /// Restarts time at zero.
+  void rewind();
+
+  /// Locks the frame buffers (must be held while calling bitsHaveChanged() and getBits() and using the bits).
+  void lockMutex()   { _mutex.lock(); }
+  void unlockMutex() { _mutex.unlock(); }
+
+  /// Returns true iff a new frame is available.
+  bool bitsHaveChanged() const { return _backReady; }
+
+  /// Makes the latest frame current and returns its bits (RGBA, width*height pixels).
+  const uchar* getBits();
+
+  /// Time between two polls of the plugin when it has nothing to do (in ms).
+  static const int IDLE_INTERVAL = 10;
+
+protected:
+  virtual void run();
+
+private:
+  // Current playback time (in seconds, mutex must be locked).
+  double _time() const;
+
+  QLibrary _library;
+  const mmp_frame_provider* _provider;
+  void* _instance;
+
+  QString _name;
+  int _width;
+  int _height;
+  double _framesPerSecond;
+
+  QVector<uchar> _buffers[2];
+  int  _front;      // index of the front buffer (the back buffer is the other one)
+  bool _backReady;  // true iff back buffer contains a frame that was not displayed yet
+
+  QMutex _mutex;
+  QWaitCondition _frameConsumed;
+  QAtomicInt _stop;
+
+  bool _playing;
+  QElapsedTimer _clock;
+  qint64 _timeOffset; // playing time accumulated before last play (in ms)
+};
+
+}
+
+#endif /* FRAME_PROVIDER_H_ */
@@ -0,0 +1,94 @@
+/*
+ * FrameProviderPlugin.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * C interface of frame provider plugins.
+ *
+ * A frame provider is a shared library that generates images which MapMap uses as a
+ * paint (see PluginSource). The library must export the entry point:
+ *
+ *   const mmp_frame_provider* mmp_get_frame_provider(void);
+ *
+ * which returns a pointer to a static description of the provider. MapMap creates one
+ * instance per paint and calls produce_frame() from a worker thread, directly into the
+ * buffer that will be uploaded to the GPU (no copies, no serialization).
+ *
+ * This header only depends on the C standard library: it is meant to be copied into
+ * plugin projects.
+ */
+
+#ifndef FRAME_PROVIDER_PLUGIN_H_
+#define FRAME_PROVIDER_PLUGIN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Version of this interface (providers built for another version are refused). */
+#define MMP_FRAME_PROVIDER_API_VERSION 1
+
+/* Name of the function exported by plugins. */
+#define MMP_FRAME_PROVIDER_ENTRY_POINT "mmp_get_frame_provider"
+
+/* Pixel formats. */
+typedef enum
+{
+  MMP_PIXEL_FORMAT_RGBA8 = 0  /* 4 bytes per pixel: R, G, B, A */
+} mmp_pixel_format;
+
+/* Return values of produce_frame(). */
+#define MMP_FRAME_NEW        1  /* buffer contains a new frame */
+#define MMP_FRAME_UNCHANGED  0  /* nothing to update (buffer content is undefined) */
+#define MMP_FRAME_ERROR     -1  /* fatal error: provider is stopped */
+
+typedef struct mmp_frame_provider
+{
+  /* Must be MMP_FRAME_PROVIDER_API_VERSION. */
+  int api_version;
+
+  /* Human-readable name. */
+  const char* name;
+
+  /* Creates an instance. config is a free-form string set by the user (never NULL).
+     Returns NULL on failure. */
+  void* (*create)(const char* config);
+
+  /* Destroys an instance. */
+  void (*destroy)(void* instance);
+
+  /* Size and pixel format of frames (must stay the same for the lifetime of an instance). */
+  int (*width)(void* instance);
+  int (*height)(void* instance);
+  int (*pixel_format)(void* instance);
+
+  /* Rate at which frames should be produced (<= 0: once per rendered frame). */
+  double (*frames_per_second)(void* instance);
+
+  /* Renders the frame for given time (in seconds since playback started) into buffer,
+     which holds height rows of stride bytes. Called from a worker thread (never concurrently
+     for the same instance). Returns one of the MMP_FRAME_* values. */
+  int (*produce_frame)(void* instance, double time, unsigned char* buffer, int stride);
+} mmp_frame_provider;
+
+/* Type of the entry point. */
+typedef const mmp_frame_provider* (*mmp_get_frame_provider_func)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRAME_PROVIDER_PLUGIN_H_ */
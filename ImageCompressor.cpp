@@ -0,0 +1,323 @@
+/*
+ * ImageCompressor.cpp
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ImageCompressor.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QDebug>
+
+#include <cstring>
+#include <climits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace mmp {
+
+// Magic number of cache files ("MMBC").
+static const quint32 CACHE_MAGIC = 0x4D4D4243;
+
+// Endpoints are moved inwards by 1/16th of the range, which reduces the error on most blocks.
+static const int INSET_SHIFT = 4;
+
+// Copies a 4x4 block of RGBA pixels (pixels outside of the image are clamped to the edges).
+static void _fetchBlock(const QImage& image, int blockX, int blockY, uchar block[64])
+{
+  for (int y=0; y<4; y++)
+  {
+    const uchar* line = image.constScanLine(qMin(blockY*4 + y, image.height() - 1));
+    for (int x=0; x<4; x++)
+      memcpy(&block[(y*4 + x)*4], &line[qMin(blockX*4 + x, image.width() - 1)*4], 4);
+  }
+}
+
+// Computes the per-channel minimum and maximum of a block.
+static void _blockBounds(const uchar block[64], uchar minColor[4], uchar maxColor[4])
+{
+#if defined(__SSE2__)
+  // One row of 4 pixels per register.
+  __m128i row0 = _mm_loadu_si128((const __m128i*) &block[0]);
+  __m128i row1 = _mm_loadu_si128((const __m128i*) &block[16]);
+  __m128i row2 = _mm_loadu_si128((const __m128i*) &block[32]);
+  __m128i row3 = _mm_loadu_si128((const __m128i*) &block[48]);
+  __m128i lo = _mm_min_epu8(_mm_min_epu8(row0, row1), _mm_min_epu8(row2, row3));
+  __m128i hi = _mm_max_epu8(_mm_max_epu8(row0, row1), _mm_max_epu8(row2, row3));
+
+  // Reduce the 4 pixels of each register to one.
+  lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+  lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+  hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+  hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+
+  int minPixel = _mm_cvtsi128_si32(lo);
+  int maxPixel = _mm_cvtsi128_si32(hi);
+  memcpy(minColor, &minPixel, 4);
+  memcpy(maxColor, &maxPixel, 4);
+#else
+  for (int c=0; c<4; c++)
+  {
+    minColor[c] = maxColor[c] = block[c];
+    for (int i=1; i<16; i++)
+    {
+      minColor[c] = qMin(minColor[c], block[i*4 + c]);
+      maxColor[c] = qMax(maxColor[c], block[i*4 + c]);
+    }
+  }
+#endif
+}
+
+static inline quint16 _to565(const uchar color[4])
+{
+  return ((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3);
+}
+
+static inline void _from565(quint16 c, int color[3])
+{
+  int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+  color[0] = (r << 3) | (r >> 2);
+  color[1] = (g << 2) | (g >> 4);
+  color[2] = (b << 3) | (b >> 2);
+}
+
+static inline void _writeLE(uchar* out, quint64 value, int nBytes)
+{
+  for (int i=0; i<nBytes; i++)
+    out[i] = (uchar) (value >> (8*i));
+}
+
+// Encodes the color part of a block (8 bytes, 4-color mode).
+static void _encodeColorBlock(const uchar block[64], const uchar minColor[4], const uchar maxColor[4], uchar* out)
+{
+  // Inset bounding box.
+  uchar lo[4], hi[4];
+  for (int c=0; c<3; c++)
+  {
+    int inset = (maxColor[c] - minColor[c]) >> INSET_SHIFT;
+    lo[c] = minColor[c] + inset;
+    hi[c] = maxColor[c] - inset;
+  }
+
+  quint16 c0 = _to565(hi);
+  quint16 c1 = _to565(lo);
+  if (c0 < c1)
+    qSwap(c0, c1);
+
+  quint32 indices = 0;
+  if (c0 != c1)
+  {
+    // Palette.
+    int palette[4][3];
+    _from565(c0, palette[0]);
+    _from565(c1, palette[1]);
+    for (int c=0; c<3; c++)
+    {
+      palette[2][c] = (2*palette[0][c] +   palette[1][c]) / 3;
+      palette[3][c] = (  palette[0][c] + 2*palette[1][c]) / 3;
+    }
+
+    // Pick closest palette entry for each pixel.
+    for (int i=0; i<16; i++)
+    {
+      const uchar* pixel = &block[i*4];
+      int best = 0, bestDistance = INT_MAX;
+      for (int j=0; j<4; j++)
+      {
+        int dr = pixel[0] - palette[j][0], dg = pixel[1] - palette[j][1], db = pixel[2] - palette[j][2];
+        int distance = dr*dr + dg*dg + db*db;
+        if (distance < bestDistance)
+        {
+          bestDistance = distance;
+          best = j;
+        }
+      }
+      indices |= (quint32) best << (2*i);
+    }
+  }
+
+  _writeLE(&out[0], c0, 2);
+  _writeLE(&out[2], c1, 2);
+  _writeLE(&out[4], indices, 4);
+}
+
+// Encodes the alpha part of a block (8 bytes, 8-alpha mode).
+static void _encodeAlphaBlock(const uchar block[64], uchar minAlpha, uchar maxAlpha, uchar* out)
+{
+  quint64 indices = 0;
+  if (maxAlpha != minAlpha)
+  {
+    int palette[8];
+    palette[0] = maxAlpha;
+    palette[1] = minAlpha;
+    for (int j=1; j<7; j++)
+      palette[j+1] = ((7 - j)*maxAlpha + j*minAlpha) / 7;
+
+    for (int i=0; i<16; i++)
+    {
+      int alpha = block[i*4 + 3];
+      int best = 0, bestDistance = INT_MAX;
+      for (int j=0; j<8; j++)
+      {
+        int distance = qAbs(alpha - palette[j]);
+        if (distance < bestDistance)
+        {
+          bestDistance = distance;
+          best = j;
+        }
+      }
+      indices |= (quint64) best << (3*i);
+    }
+  }
+
+  out[0] = maxAlpha;
+  out[1] = minAlpha;
+  _writeLE(&out[2], indices, 6);
+}
+
+CompressedImage ImageCompressor::compress(const QImage& image)
+{
+  CompressedImage compressed;
+  if (image.isNull() || image.depth() != 32)
+    return compressed;
+
+  // Use BC1 (twice smaller) if there is no transparency.
+  bool opaque = true;
+  for (int y=0; y<image.height() && opaque; y++)
+  {
+    const uchar* line = image.constScanLine(y);
+    for (int x=0; x<image.width(); x++)
+      if (line[x*4 + 3] != 255)
+      {
+        opaque = false;
+        break;
+      }
+  }
+
+  int blockSize = (opaque ? 8 : 16);
+  int nBlocksX = (image.width()  + 3) / 4;
+  int nBlocksY = (image.height() + 3) / 4;
+
+  compressed.format = (opaque ? CompressedImage::BC1 : CompressedImage::BC3);
+  compressed.width  = image.width();
+  compressed.height = image.height();
+  compressed.data.resize(nBlocksX * nBlocksY * blockSize);
+
+  uchar* out = (uchar*) compressed.data.data();
+  uchar block[64], minColor[4], maxColor[4];
+  for (int by=0; by<nBlocksY; by++)
+    for (int bx=0; bx<nBlocksX; bx++)
+    {
+      _fetchBlock(image, bx, by, block);
+      _blockBounds(block, minColor, maxColor);
+      if (!opaque)
+      {
+        _encodeAlphaBlock(block, minColor[3], maxColor[3], out);
+        out += 8;
+      }
+      _encodeColorBlock(block, minColor, maxColor, out);
+      out += 8;
+    }
+
+  return compressed;
+}
+
+CompressedImage ImageCompressor::compressCached(const QString& sourceFile, const QImage& image)
+{
+  CompressedImage compressed;
+  QString cacheFile = cacheFileName(sourceFile);
+  if (!cacheFile.isEmpty() && _readCache(cacheFile, image, &compressed))
+    return compressed;
+
+  compressed = compress(image);
+  if (!compressed.isNull() && !cacheFile.isEmpty())
+    _writeCache(cacheFile, compressed);
+  return compressed;
+}
+
+QString ImageCompressor::cacheFileName(const QString& sourceFile)
+{
+  QFileInfo info(sourceFile);
+  if (!info.exists())
+    return QString();
+
+  // Entry depends on the file and its version.
+  QString key = QString("%1|%2|%3|%4").arg(info.absoluteFilePath()).arg(info.size())
+                                      .arg(info.lastModified().toMSecsSinceEpoch()).arg(ENCODER_VERSION);
+  QString hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+
+  QDir cache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/compressed-images");
+  if (!cache.mkpath("."))
+    return QString();
+
+  return cache.filePath(hash + ".mmbc");
+}
+
+bool ImageCompressor::_readCache(const QString& cacheFile, const QImage& image, CompressedImage* compressed)
+{
+  QFile file(cacheFile);
+  if (!file.open(QIODevice::ReadOnly))
+    return false;
+
+  QDataStream in(&file);
+  quint32 magic;
+  qint32 version, format, width, height;
+  in >> magic >> version >> format >> width >> height >> compressed->data;
+
+  // Verify that the entry is valid and matches the image.
+  if (in.status() != QDataStream::Ok || magic != CACHE_MAGIC || version != ENCODER_VERSION ||
+      (format != CompressedImage::BC1 && format != CompressedImage::BC3) ||
+      width != image.width() || height != image.height() ||
+      compressed->data.size() != ((width + 3)/4) * ((height + 3)/4) * (format == CompressedImage::BC1 ? 8 : 16))
+  {
+    qWarning() << "Invalid compressed image cache entry " << cacheFile << ": ignored." << endl;
+    *compressed = CompressedImage();
+    return false;
+  }
+
+  compressed->format = (CompressedImage::Format) format;
+  compressed->width  = width;
+  compressed->height = height;
+  return true;
+}
+
+bool ImageCompressor::_writeCache(const QString& cacheFile, const CompressedImage& compressed)
+{
+  // Write atomically (other instances might read the cache at the same time).
+  QSaveFile file(cacheFile);
+  if (!file.open(QIODevice::WriteOnly))
+    return false;
+
+  QDataStream out(&file);
+  out << CACHE_MAGIC << (qint32) ENCODER_VERSION << (qint32) compressed.format
+      << (qint32) compressed.width << (qint32) compressed.height << compressed.data;
+
+  if (!file.commit())
+  {
+    qWarning() << "Cannot write compressed image cache entry " << cacheFile << "." << endl;
+    return false;
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,82 @@
+/*
+ * ImageCompressor.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMAGE_COMPRESSOR_H_
+#define IMAGE_COMPRESSOR_H_
+
+#include <QImage>
+#include <QByteArray>
+#include <QString>
+
+#include "MM.h"
+
+namespace mmp {
+
+/**
+ * Image block-compressed in a S3TC format (4x4 pixel blocks, in the same row order as
+ * the source image).
+ */
+struct CompressedImage
+{
+  enum Format
+  {
+    NONE,
+    BC1, // DXT1: RGB, 8 bytes per block (opaque images)
+    BC3  // DXT5: RGBA, 16 bytes per block
+  };
+
+  CompressedImage() : format(NONE), width(0), height(0) {}
+
+  bool isNull() const { return format == NONE || data.isEmpty(); }
+
+  Format format;
+  int width;
+  int height;
+  QByteArray data;
+};
+
+/**
+ * Compresses images to BC1/BC3 so that they take 4 to 8 times less memory (and upload
+ * bandwidth) on the GPU. Compression is fast but not free: results are cached on disk.
+ * All functions are thread-safe (meant to be run on worker threads).
+ */
+class ImageCompressor
+{
+public:
+  /// Compresses an image in GL format (RGBA bytes). BC1 is used if the image is fully opaque, BC3 otherwise.
+  static CompressedImage compress(const QImage& image);
+
+  /**
+   * Same as compress() but uses the disk cache: sourceFile is the file the image was read
+   * from (the cache entry is invalidated if it changes).
+   */
+  static CompressedImage compressCached(const QString& sourceFile, const QImage& image);
+
+  /// Name of the cache file for given source file.
+  static QString cacheFileName(const QString& sourceFile);
+
+  /// Version of the encoder (cache entries of other versions are ignored).
+  static const int ENCODER_VERSION = 1;
+
+private:
+  static bool _readCache(const QString& cacheFile, const QImage& image, CompressedImage* compressed);
+  static bool _writeCache(const QString& cacheFile, const CompressedImage& compressed);
+};
+
+}
+
+#endif /* IMAGE_COMPRESSOR_H_ */
@@ -69,5 +69,6 @@ const qreal MM::ZOOM_MAX    = 5.0f;
 
 // Default values
 const QString MM::DEFAULT_LANGUAGE = "en";
+const QString MM::DEFAULT_CPU_SET = "auto";
 
 }
@@ -72,6 +72,9 @@ public:
   // OSC
   static const int DEFAULT_OSC_PORT = 12345;
 
+  // Synchronization of instances
+  static const int DEFAULT_SYNC_PORT = 12346;
+
   // Default values
   static const bool DISPLAY_TEST_SIGNAL = false;
   static const bool DISPLAY_OUTPUT_WINDOW = false;
@@ -84,6 +87,12 @@ public:
   static const int DEFAULT_TEST_CARD = 0;
   static const bool SHOW_OUTPUT_RESOLUTION = true;
   static const QString DEFAULT_LANGUAGE;
+  static const int DEFAULT_DECODER_THREADS = 0;   // 0 = let decoders decide
+  static const int DEFAULT_CONVERTER_THREADS = 0; // 0 = automatic
+  static const int DEFAULT_THREAD_PRIORITY = 0;
+  static const QString DEFAULT_CPU_SET;           // spread media over blocks of CPUs
+  static const bool DEFAULT_COMPRESS_IMAGES = false;
+  static const int DEFAULT_SWAP_INTERVAL = 1;     // 0 = no vertical sync
 
   // Style.
   static const QColor WHITE;
@@ -124,7 +133,10 @@ public:
   static const int MESH_SUBDIVISION_MIN_AREA = 400;
   static const int MESH_SUBDIVISION_MAX_DEPTH_EDITING = 4;
   static const int MESH_SUBDIVISION_MAX_DEPTH         = (-1);
-  static const int ELLIPSE_N_TRIANGLES = 100; // n triangles used to draw an ellipse
+  static const int MESH_TESSELLATION_PARALLEL_MIN_CELLS = 64; // meshes with that many cells are subdivided in parallel
+  static const int ELLIPSE_TRIANGLE_EDGE   = 4;    // on-screen length (in pixels) of the outer edge of triangles used to draw an ellipse
+  static const int ELLIPSE_MIN_TRIANGLES   = 24;   // min n triangles used to draw an ellipse
+  static const int ELLIPSE_MAX_TRIANGLES   = 2048; // max n triangles used to draw an ellipse
 
   // Enumerations
   enum ItemColumn {
@@ -27,6 +27,7 @@
 #include "ProjectReader.h"
 #include <sstream>
 #include <string>
+#include <QtMath>
 
 namespace mmp {
 
@@ -51,13 +52,19 @@ MainWindow::MainWindow()
   _hasCurrentPaint = false;
   _hasCurrentMapping = false;
   currentSelectedItem = NULL;
+  outputRenderer = NULL;
 
   // Frames per second.
   _framesPerSecond = (-1);
+  _videoMaxFramesPerSecond = (-1);
+  frameClock = new FrameClock(this);
 
   // Play state.
   _isPlaying = false;
 
+  // Render state.
+  _canvasesChanged = true;
+
   // Editing toggles.
   _displayControls = true;
   _displayPaintControls = true;
@@ -89,22 +96,31 @@ MainWindow::MainWindow()
   setWindowIcon(QIcon(":/mapmap-logo"));
   setCurrentFile("");
 
-  // Create and start timer.
-  videoTimer = new QTimer(this);
-  connect(videoTimer, SIGNAL(timeout()), this, SLOT(processFrame()));
+  // Start frame clock.
+  connect(frameClock, SIGNAL(tick()), this, SLOT(processFrame()));
   setFramesPerSecond(MM::DEFAULT_FRAMES_PER_SECOND);
-  videoTimer->start();
+  frameClock->start();
 
   // Create elapsed timer.
   systemTimer = new QElapsedTimer;
   systemTimer->start();
 
+  // Media preflight.
+  _preflightWatcher = NULL;
+
+  // Transcoding.
+  _transcodeQueue = new TranscodeQueue(this);
+  connect(_transcodeQueue, SIGNAL(jobProgress(int,int,qreal)), this, SLOT(transcodeProgress(int,int,qreal)));
+  connect(_transcodeQueue, SIGNAL(jobFinished(int,int,QString,QString)), this, SLOT(transcodeFinished(int,int,QString,QString)));
+  connect(_transcodeQueue, SIGNAL(jobFailed(int,int,QString,QString)), this, SLOT(transcodeFailed(int,int,QString,QString)));
+
   // Start playing by default.
   play();
 }
 
 MainWindow::~MainWindow()
 {
+  delete outputRenderer;
   delete mappingManager;
   //  delete _facade;
 #ifdef HAVE_OSC
@@ -220,7 +236,11 @@ void MainWindow::handlePaintChanged(Paint::ptr paint)
   {
     QSharedPointer<Video> media = qSharedPointerCast<Video>(paint);
     Q_CHECK_PTR(media);
-    updatePaintItem(paintId, media->getIcon(), strippedName(media->getUri()));
+    QSharedPointer<TestSource> source = qSharedPointerDynamicCast<TestSource>(paint);
+    if (source)
+      updatePaintItem(paintId, media->getIcon(), tr("Test source (%1)").arg(source->getDescription()));
+    else
+      updatePaintItem(paintId, media->getIcon(), strippedName(media->getUri()));
     //    QString fileName = QFileDialog::getOpenFileName(this,
     //        tr("Import media source file"), ".");
     //    // Restart video playback. XXX Hack
@@ -238,6 +258,12 @@ void MainWindow::handlePaintChanged(Paint::ptr paint)
     //    if (!fileName.isEmpty())
     //      importMediaFile(fileName, paint, true);
   }
+  else if (paint->getType() == "plugin")
+  {
+    QSharedPointer<PluginSource> source = qSharedPointerCast<PluginSource>(paint);
+    Q_CHECK_PTR(source);
+    updatePaintItem(paintId, source->getIcon(), source->getName());
+  }
   else if (paint->getType() == "color")
   {
     // Pop-up color-choosing dialog to choose color paint.
@@ -574,6 +600,65 @@ void MainWindow::addColor()
   play(false);
 }
 
+void MainWindow::addTestSource()
+{
+  // Pick a pattern; other settings can be changed from the paint properties.
+  bool ok;
+  QString pattern = QInputDialog::getItem(this, tr("Add Test Source"), tr("Pattern"),
+                                          TestSource::patterns(), 0, false, &ok);
+  if (!ok)
+    return;
+
+  QApplication::setOverrideCursor(Qt::WaitCursor);
+
+  // Default to a typical decoding load (1080p30 H.264) if the encoder is available.
+  QString encoder = "h264";
+  uid id = createTestSourcePaint(NULL_UID, pattern, 1920, 1080, 30, encoder);
+  if (id == NULL_UID)
+    id = createTestSourcePaint(NULL_UID, pattern, 1920, 1080, 30, encoder = "");
+
+  QApplication::restoreOverrideCursor();
+
+  if (id == NULL_UID)
+  {
+    QMessageBox::warning(this, tr("Test source"), tr("Test source could not be created."));
+    return;
+  }
+
+  statusBar()->showMessage(tr("Test source added"), 2000);
+}
+
+void MainWindow::addPluginSource()
+{
+  QString fileName = QFileDialog::getOpenFileName(this,
+                                                  tr("Add frame provider plugin"),
+                                                  settings.value("defaultPluginDir").toString(),
+                                                  tr("Plugins (%1);;All files (*)")
+                                                  .arg(PluginSource::PLUGIN_FILES_FILTER));
+  if (fileName.isEmpty())
+    return;
+
+  // Optional configuration string (interpreted by the plugin).
+  bool ok;
+  QString config = QInputDialog::getText(this, tr("Add frame provider plugin"), tr("Configuration (optional)"),
+                                         QLineEdit::Normal, "", &ok);
+  if (!ok)
+    return;
+
+  QApplication::setOverrideCursor(Qt::WaitCursor);
+  uid id = createPluginSourcePaint(NULL_UID, fileName, config);
+  QApplication::restoreOverrideCursor();
+
+  if (id == NULL_UID)
+  {
+    QMessageBox::warning(this, tr("Frame provider plugin"), tr("Cannot load plugin %1.").arg(fileName));
+    return;
+  }
+
+  settings.setValue("defaultPluginDir", QFileInfo(fileName).absolutePath());
+  statusBar()->showMessage(tr("Plugin source added"), 2000);
+}
+
 void MainWindow::addMesh()
 {
   // A paint must be selected to add a mapping.
@@ -865,6 +950,90 @@ void MainWindow::renamePaintItem()
   contentTab->setCurrentWidget(paintSplitter);
 }
 
+void MainWindow::transcodePaintItem()
+{
+  Paint::ptr paint = getCurrentPaint();
+  if (paint.isNull() || paint->getType() != "media" || qSharedPointerDynamicCast<TestSource>(paint))
+    return;
+
+  QSharedPointer<Video> video = qSharedPointerCast<Video>(paint);
+  QSize size = neededVideoSize(video);
+  if (size.isEmpty())
+  {
+    qWarning() << "Cannot transcode media " << video->getUri() << ": unknown size." << endl;
+    return;
+  }
+
+  QString destination = TranscodeQueue::intermediateFileName(video->getUri(), size);
+  _transcodeQueue->enqueue(video->getUri(), destination, size, paint->getId());
+  statusBar()->showMessage(tr("Optimizing %1 for mapping (%2x%3)...")
+                           .arg(strippedName(video->getUri())).arg(size.width()).arg(size.height()), 2000);
+}
+
+void MainWindow::transcodeProgress(int jobId, int paintId, qreal progress)
+{
+  Q_UNUSED(jobId);
+  Paint::ptr paint = mappingManager->getPaintById(paintId);
+  if (!paint.isNull())
+    statusBar()->showMessage(tr("Optimizing %1: %2%").arg(paint->getName()).arg(int(progress * 100)), 1000);
+}
+
+void MainWindow::transcodeFinished(int jobId, int paintId, const QString& sourceUri, const QString& destinationFile)
+{
+  Q_UNUSED(jobId);
+
+  // Make sure the paint still exists and still uses the source media.
+  Paint::ptr paint = mappingManager->getPaintById(paintId);
+  if (paint.isNull() || paint->getType() != "media")
+    return;
+  QSharedPointer<Video> video = qSharedPointerCast<Video>(paint);
+  if (video->getUri() != sourceUri)
+    return;
+
+  // Input shapes are in pixels: rescale them to the new resolution.
+  int oldWidth  = video->getWidth();
+  int oldHeight = video->getHeight();
+  if (!video->setUri(destinationFile))
+  {
+    qWarning() << "Cannot use optimized media " << destinationFile << "." << endl;
+    return;
+  }
+
+  if (oldWidth > 0 && oldHeight > 0)
+  {
+    QPointF origin(video->getX(), video->getY());
+    qreal scaleX = qreal(video->getWidth())  / oldWidth;
+    qreal scaleY = qreal(video->getHeight()) / oldHeight;
+    QMap<uid, Mapping::ptr> mappings = mappingManager->getPaintMappings(paint);
+    for (QMap<uid, Mapping::ptr>::const_iterator it = mappings.constBegin(); it != mappings.constEnd(); ++it)
+    {
+      if (!it.value()->hasInputShape())
+        continue;
+
+      MShape::ptr shape = it.value()->getInputShape();
+      QVector<QPointF> vertices = shape->getVertices();
+      for (int i=0; i<vertices.size(); i++)
+      {
+        QPointF v = vertices[i] - origin;
+        vertices[i] = origin + QPointF(v.x() * scaleX, v.y() * scaleY);
+      }
+      shape->setVertices(vertices);
+    }
+  }
+
+  updatePaintItem(paintId, video->getIcon(), strippedName(destinationFile));
+  updateCanvases();
+  windowModified();
+  statusBar()->showMessage(tr("%1 optimized for mapping").arg(paint->getName()), 2000);
+}
+
+void MainWindow::transcodeFailed(int jobId, int paintId, const QString& sourceUri, const QString& error)
+{
+  Q_UNUSED(jobId);
+  Q_UNUSED(paintId);
+  qWarning() << "Could not optimize media " << sourceUri << ": " << error << endl;
+}
+
 void MainWindow::renamePaint(uid paintId, const QString &name)
 {
   Paint::ptr paint = mappingManager->getPaintById(paintId);
@@ -1022,6 +1191,56 @@ uid MainWindow::createColorPaint(uid paintId, QColor color)
   }
 }
 
+uid MainWindow::createTestSourcePaint(uid paintId, const QString& pattern, int width, int height, int framesPerSecond, const QString& encoder)
+{
+  // Cannot create paint with already existing id.
+  if (Paint::getUidAllocator().exists(paintId))
+    return NULL_UID;
+
+  else
+  {
+    TestSource* source = new TestSource(pattern, width, height, framesPerSecond, encoder, paintId);
+    Paint::ptr paint(source);
+    if (source->getUri().isEmpty())
+      return NULL_UID;
+
+    paint->setName(tr("Test source (%1)").arg(source->getDescription()));
+
+    // Add paint to model and return its uid.
+    uid id = mappingManager->addPaint(paint);
+
+    // Add paint widget item.
+    undoStack->push(new AddPaintCommand(this, id, paint->getIcon(), paint->getName()));
+
+    return id;
+  }
+}
+
+uid MainWindow::createPluginSourcePaint(uid paintId, const QString& uri, const QString& config)
+{
+  // Cannot create paint with already existing id.
+  if (Paint::getUidAllocator().exists(paintId))
+    return NULL_UID;
+
+  else
+  {
+    PluginSource* source = new PluginSource(uri, config, paintId);
+    Paint::ptr paint(source);
+    if (source->getUri().isEmpty())
+      return NULL_UID;
+
+    paint->setName(source->getProviderName().isEmpty() ? strippedName(uri) : source->getProviderName());
+
+    // Add paint to model and return its uid.
+    uid id = mappingManager->addPaint(paint);
+
+    // Add paint widget item.
+    undoStack->push(new AddPaintCommand(this, id, paint->getIcon(), paint->getName()));
+
+    return id;
+  }
+}
+
 uid MainWindow::createMeshTextureMapping(uid mappingId,
                                          uid paintId,
                                          int nColumns, int nRows,
@@ -1409,6 +1628,13 @@ void MainWindow::createLayout()
   outputWindow = new OutputGLWindow(this, destinationCanvas);
   outputWindow->installEventFilter(destinationCanvas);
 
+  // Output is rendered once for both the destination canvas and the output window.
+  outputRenderer = new OutputRenderer(destinationCanvas->scene(), (QGLWidget*)destinationCanvas->viewport());
+
+  // Buffer swaps of the output window drive the frame clock (with vertical sync).
+  connect(outputWindow->getCanvas(), SIGNAL(swapped()),
+          frameClock,                SLOT(presented()));
+
   // Source scene changed -> change destination.
   connect(sourceCanvas->scene(), SIGNAL(changed(const QList<QRectF>&)),
           destinationCanvas,     SLOT(update()));
@@ -1571,6 +1797,22 @@ void MainWindow::createActions()
   addAction(addColorAction);
   connect(addColorAction, SIGNAL(triggered()), this, SLOT(addColor()));
 
+  // Add test source.
+  addTestSourceAction = new QAction(tr("Add &Test Source..."), this);
+  addTestSourceAction->setToolTip(tr("Add a synthetic video source (for benchmarking)..."));
+  addTestSourceAction->setIconVisibleInMenu(false);
+  addTestSourceAction->setShortcutContext(Qt::ApplicationShortcut);
+  addAction(addTestSourceAction);
+  connect(addTestSourceAction, SIGNAL(triggered()), this, SLOT(addTestSource()));
+
+  // Add frame provider plugin.
+  addPluginSourceAction = new QAction(tr("Add &Plugin Source..."), this);
+  addPluginSourceAction->setToolTip(tr("Add a paint generated by a frame provider plugin..."));
+  addPluginSourceAction->setIconVisibleInMenu(false);
+  addPluginSourceAction->setShortcutContext(Qt::ApplicationShortcut);
+  addAction(addPluginSourceAction);
+  connect(addPluginSourceAction, SIGNAL(triggered()), this, SLOT(addPluginSource()));
+
   // Exit/quit.
   exitAction = new QAction(tr("E&xit"), this);
   exitAction->setShortcut(QKeySequence::Quit);
@@ -1677,6 +1919,13 @@ void MainWindow::createActions()
   addAction(renamePaintAction);
   connect(renamePaintAction, SIGNAL(triggered()), this, SLOT(renamePaintItem()));
 
+  // Transcode paint.
+  transcodePaintAction = new QAction(tr("Optimize for mapping"), this);
+  transcodePaintAction->setToolTip(tr("Convert media to an intra-frame file at the resolution needed by its mappings"));
+  transcodePaintAction->setIconVisibleInMenu(false);
+  addAction(transcodePaintAction);
+  connect(transcodePaintAction, SIGNAL(triggered()), this, SLOT(transcodePaintItem()));
+
   // Preferences...
   preferencesAction = new QAction(tr("&Preferences..."), this);
   //preferencesAction->setIcon(QIcon(":/preferences"));
@@ -1943,6 +2192,8 @@ void MainWindow::createMenus()
   fileMenu->addAction(importMediaAction);
   fileMenu->addAction(openCameraAction);
   fileMenu->addAction(addColorAction);
+  fileMenu->addAction(addTestSourceAction);
+  fileMenu->addAction(addPluginSourceAction);
 
   // Recent file separator
   separatorAction = fileMenu->addSeparator();
@@ -2072,6 +2323,7 @@ void MainWindow::createPaintContextMenu()
   // Add Actions
   paintContextMenu->addAction(deletePaintAction);
   paintContextMenu->addAction(renamePaintAction);
+  paintContextMenu->addAction(transcodePaintAction);
 
   // Define Context policy
   paintList->setContextMenuPolicy(Qt::CustomContextMenu);
@@ -2145,10 +2397,10 @@ void MainWindow::createStatusBar()
   mousePosLabel = new QLabel(statusBar());
   mousePosLabel->setFrameStyle(QFrame::Panel | QFrame::Sunken);
   mousePosLabel->setContentsMargins(2, 0, 0, 0);
-  // FPS.
-  trueFramesPerSecondsLabel = new QLabel(statusBar());
-  trueFramesPerSecondsLabel->setFrameStyle(QFrame::Panel | QFrame::Sunken);
-  trueFramesPerSecondsLabel->setContentsMargins(2, 0, 0, 0);
+  // Frame times.
+  frameTimeLabel = new QLabel(statusBar());
+  frameTimeLabel->setFrameStyle(QFrame::Panel | QFrame::Sunken);
+  frameTimeLabel->setContentsMargins(2, 0, 0, 0);
 
   // Add permanently into the statut bar
   statusBar()->addPermanentWidget(currentMessageLabel, 5);
@@ -2156,7 +2408,7 @@ void MainWindow::createStatusBar()
   statusBar()->addPermanentWidget(mousePosLabel, 3);
   statusBar()->addPermanentWidget(sourceZoomLabel, 1);
   statusBar()->addPermanentWidget(destinationZoomLabel, 1);
-  statusBar()->addPermanentWidget(trueFramesPerSecondsLabel, 1);
+  statusBar()->addPermanentWidget(frameTimeLabel, 1);
 
   // Update the status bar
   updateStatusBar();
@@ -2200,6 +2452,16 @@ void MainWindow::readSettings()
    // Set toolbar icon size
    int toolBarIconSize = settings.value("toolbarIconSize", MM::TOOLBAR_ICON_SIZE).toInt();
    mainToolBar->setIconSize(QSize(toolBarIconSize, toolBarIconSize));
+
+  // New in 0.5.1
+  Video::setDefaultThreading(settings.value("decoderThreads", MM::DEFAULT_DECODER_THREADS).toInt(),
+                             settings.value("converterThreads", MM::DEFAULT_CONVERTER_THREADS).toInt(),
+                             settings.value("threadPriority", MM::DEFAULT_THREAD_PRIORITY).toInt(),
+                             settings.value("cpuSet", MM::DEFAULT_CPU_SET).toString());
+  Image::setDefaultCompressed(settings.value("compressImages", MM::DEFAULT_COMPRESS_IMAGES).toBool());
+  int swapInterval = settings.value("swapInterval", MM::DEFAULT_SWAP_INTERVAL).toInt();
+  frameClock->setSwapInterval(swapInterval);
+  outputWindow->setSwapInterval(swapInterval);
 }
 
 void MainWindow::writeSettings()
@@ -2520,10 +2782,14 @@ void MainWindow::addPaintItem(uid paintId, const QIcon& icon, const QString& nam
   // Create paint gui.
   PaintGui::ptr paintGui;
   QString paintType = paint->getType();
-  if (paintType == "media")
+  if (paintType == "media" && qSharedPointerDynamicCast<TestSource>(paint))
+    paintGui = PaintGui::ptr(new TestSourceGui(paint));
+  else if (paintType == "media")
     paintGui = PaintGui::ptr(new VideoGui(paint));
   else if (paintType == "image")
     paintGui = PaintGui::ptr(new ImageGui(paint));
+  else if (paintType == "plugin")
+    paintGui = PaintGui::ptr(new PluginSourceGui(paint));
   else if (paintType == "color")
     paintGui = PaintGui::ptr(new ColorGui(paint));
   else
@@ -2597,7 +2863,7 @@ void MainWindow::addMappingItem(uid mappingId)
   // Add mapper.
   // XXX hardcoded for textures
   QSharedPointer<TextureMapping> textureMapping;
-  if (paintType == "media" || paintType == "image")
+  if (paintType == "media" || paintType == "image" || paintType == "plugin")
   {
     textureMapping = qSharedPointerCast<TextureMapping>(mapping);
     Q_CHECK_PTR(textureMapping);
@@ -2847,6 +3113,30 @@ MainWindow* MainWindow::window() {
 
 void MainWindow::updateCanvases()
 {
+  // Changes are rendered together at next frame.
+  _canvasesChanged = true;
+}
+
+void MainWindow::renderCanvases()
+{
+  _canvasesChanged = false;
+  _renderedShapesRevisions = shapesRevisions();
+
+  // Render the output once for all its views (only worth it while the output window is shown).
+  if (outputWindow->isVisible())
+  {
+    MapperGLCanvas* outputCanvas = outputWindow->getCanvas();
+    outputRenderer->render(outputCanvas->mapToScene(outputCanvas->viewport()->rect()).boundingRect(),
+                           outputCanvas->viewport()->size());
+  }
+  else
+    outputRenderer->clear();
+
+  // Buffer swaps of the output window then drive the frame clock (with vertical sync).
+  QScreen* screen = (outputWindow->windowHandle() ? outputWindow->windowHandle()->screen() : NULL);
+  frameClock->setRefreshRate(screen ? screen->refreshRate() : 0);
+  frameClock->setSwapDriven(outputWindow->isVisible() && frameClock->getSwapInterval() > 0);
+
   // Update scenes.
   sourceCanvas->scene()->update();
   destinationCanvas->scene()->update();
@@ -2862,23 +3152,298 @@ void MainWindow::updateCanvases()
 
 void MainWindow::processFrame()
 {
-  // Number of frames processed (restarted every second).
-  static unsigned int nFrames = 0;
+  // Video frame statistics at last update of frame times.
+  static quint64 lastRepeated = 0;
+  static quint64 lastSkipped  = 0;
+  static quint64 lastMissed   = 0;
 
-  // Update canvases.
-  updateCanvases();
+  // Frames are rendered at the refresh rate of the output while it drives the clock.
+  if (frameClock->getTickRate() != _videoMaxFramesPerSecond)
+    updateVideoMaxFramesPerSecond();
 
-  // Update true FPS.
-  nFrames++;
-  if (nFrames > framesPerSecond())
+  // Restrict decoding to the regions actually used.
+  updateVideoInputShapesRegions();
+
+  // Choose the video frames that match the time at which this image will be shown.
+  selectVideoFrames();
+
+  // Set modulated properties (after video frames, which also select their audio measures).
+  bool modulated = applyModulations();
+
+  // Render canvases only if something changed.
+  bool newFrames = updatePaints();
+  if (newFrames || modulated || canvasesNeedRendering())
+    renderCanvases();
+
+  // Statistics of the shared clock.
+  if (SyncClock::isActive())
+    SyncClock::update();
+
+  // Update frame times (every second).
+  if (systemTimer->elapsed() >= 1000)
+  {
+    systemTimer->restart();
+
+    // Video frames repeated and skipped since last update.
+    quint64 repeated, skipped;
+    getVideoFrameStatistics(&repeated, &skipped);
+    quint64 missed = frameClock->getMissedFrames();
+
+    frameTimeLabel->setText(
+        tr("Frame time: %1 / %2 / %3 ms (median / 95% / 99%), missed: %4")
+          .arg(frameClock->getFrameTimePercentile(0.5), 0, 'f', 1)
+          .arg(frameClock->getFrameTimePercentile(0.95), 0, 'f', 1)
+          .arg(frameClock->getFrameTimePercentile(0.99), 0, 'f', 1)
+          .arg(missed - lastMissed) +
+        (frameClock->isSwapDriven() ? tr(" (vsync)") : QString()) +
+        // Counters restart when movies are reloaded.
+        (repeated >= lastRepeated && skipped >= lastSkipped ?
+           tr(" (repeated: %1, skipped: %2)").arg(repeated - lastRepeated).arg(skipped - lastSkipped) : QString()) +
+        // Skew to the other instances: lateness of videos plus error of the shared clock.
+        (SyncClock::isActive() ?
+           tr(" sync: %1 ms (clock: %2 ms%3)")
+             .arg(getMaxVideoLateness() * 1000, 0, 'f', 1)
+             .arg(qAbs(SyncClock::getClockOffset()) * 1000, 0, 'f', 1)
+             .arg(SyncClock::isSynchronized() ? "" : tr(", not synchronized")) : QString()));
+    lastRepeated = repeated;
+    lastSkipped  = skipped;
+    lastMissed   = missed;
+  }
+}
+
+void MainWindow::updateVideoInputShapesRegions()
+{
+  for (int i=0; i<mappingManager->nPaints(); i++)
+  {
+    Paint::ptr paint = mappingManager->getPaint(i);
+    if (paint->getType() != "media")
+      continue;
+
+    QSharedPointer<Video> video = qSharedPointerCast<Video>(paint);
+    if (!video->isCropToInputShapes())
+      continue;
+
+    // Compute union of all input shapes (in texture coordinates).
+    QRectF region;
+    QMap<uid, Mapping::ptr> mappings = mappingManager->getPaintMappings(paint);
+    for (QMap<uid, Mapping::ptr>::const_iterator it = mappings.constBegin(); it != mappings.constEnd(); ++it)
+    {
+      if (it.value()->hasInputShape())
+        region |= it.value()->getInputShape()->getBoundingRect();
+    }
+
+    // Add a margin of one pixel to prevent artifacts caused by texture filtering at borders.
+    if (!region.isEmpty())
+      region = region.translated(-video->getX(), -video->getY()).adjusted(-1, -1, 1, 1);
+    video->setInputShapesRegion(region);
+  }
+}
+
+void MainWindow::startMediaPreflight(const QStringList& uris)
+{
+  // Results of a previous analysis are not relevant anymore (without waiting for it to stop:
+  // its watcher is deleted when it finishes).
+  if (_preflightWatcher)
+  {
+    _preflightWatcher->cancel();
+    _preflightWatcher = NULL;
+  }
+
+  if (uris.isEmpty())
+    return;
+
+  qDebug() << "Analyzing " << uris.size() << " media file(s)..." << endl;
+  _preflightWatcher = new QFutureWatcher<MediaPreflightReport>(this);
+  connect(_preflightWatcher, SIGNAL(finished()), this, SLOT(mediaPreflightFinished()));
+  _preflightWatcher->setFuture(MediaPreflight::start(uris));
+}
+
+void MainWindow::mediaPreflightFinished()
+{
+  QFutureWatcher<MediaPreflightReport>* watcher = static_cast<QFutureWatcher<MediaPreflightReport>*>(sender());
+  watcher->deleteLater();
+
+  // Ignore stale results (another analysis was started since).
+  if (watcher != _preflightWatcher || watcher->isCanceled())
+    return;
+  _preflightWatcher = NULL;
+
+  QList<MediaPreflightReport> reports = watcher->future().results();
+  MediaPreflight::assess(reports);
+
+  int nProblems = 0;
+  foreach (const MediaPreflightReport& report, reports)
+  {
+    if (report.likelyToDropFrames)
+    {
+      qWarning() << report.toString() << endl;
+      nProblems++;
+    }
+    else
+      qDebug() << report.toString() << endl;
+  }
+
+  if (nProblems > 0)
+    statusBar()->showMessage(tr("%1 media file(s) may cause frame drops: see console for details").arg(nProblems), 10000);
+}
+
+void MainWindow::selectVideoFrames()
+{
+  // The image being rendered will be displayed (roughly) at the next frame tick.
+  qreal tickRate = frameClock->getTickRate();
+  qreal displayDelay = (tickRate > 0 ? 1.0 / tickRate : 0);
+  for (int i=0; i<mappingManager->nPaints(); i++)
+  {
+    Paint::ptr paint = mappingManager->getPaint(i);
+    if (paint->getType() == "media")
+      qSharedPointerCast<Video>(paint)->selectFrame(displayDelay);
+  }
+}
+
+bool MainWindow::applyModulations()
+{
+  AudioInput::update();
+
+  // Modulated properties are set silently: report changes here.
+  bool changed = false;
+  for (int i=0; i<mappingManager->nPaints(); i++)
+  {
+    Paint::ptr paint = mappingManager->getPaint(i);
+    if (paint->hasModulation())
+      changed = paint->applyModulation() || changed;
+  }
+
+  for (int i=0; i<mappingManager->nMappings(); i++)
   {
-    // This is the real time needed to process one second.
-    qreal trueFramesPerSecond = nFrames / systemTimer->restart() * 1000.0;
-    trueFramesPerSecondsLabel->setText(
-        "FPS: " + QString::number(trueFramesPerSecond, 'f', 2) + " / " +
-        QString::number(framesPerSecond()  , 'f', 2));
-    nFrames = 0;
+    Mapping::ptr mapping = mappingManager->getMapping(i);
+    if (mapping->hasModulation())
+      changed = mapping->applyModulation() || changed;
   }
+  return changed;
+}
+
+bool MainWindow::updatePaints()
+{
+  // Paints create their texture in the (shared) context of the canvases.
+  ((QGLWidget*)destinationCanvas->viewport())->makeCurrent();
+
+  bool newFrames = false;
+  QVector<Paint::ptr> visiblePaints = mappingManager->getVisiblePaints();
+  for (int i=0; i<visiblePaints.size(); i++)
+  {
+    Paint::ptr paint = visiblePaints[i];
+    paint->update();
+
+    // New video frame selected, image animated or compressed, etc.
+    QSharedPointer<Texture> texture = qSharedPointerDynamicCast<Texture>(paint);
+    if (texture)
+    {
+      texture->lockMutex();
+      newFrames = newFrames || texture->bitsHaveChanged();
+      texture->unlockMutex();
+    }
+  }
+  return newFrames;
+}
+
+bool MainWindow::canvasesNeedRendering() const
+{
+  // Something was changed (see updateCanvases()).
+  if (_canvasesChanged || shapesRevisions() != _renderedShapesRevisions)
+    return true;
+
+  // Crossfades animate the output.
+  QVector<Mapping::ptr> visibleMappings = mappingManager->getVisibleMappings();
+  for (int i=0; i<visibleMappings.size(); i++)
+  {
+    QSharedPointer<TextureMapping> textureMapping = qSharedPointerDynamicCast<TextureMapping>(visibleMappings[i]);
+    if (textureMapping && textureMapping->isInTransition())
+      return true;
+  }
+
+  // Output window was shown, hidden or resized.
+  if (outputWindow->isVisible() != outputRenderer->isActive())
+    return true;
+  if (outputRenderer->isActive())
+  {
+    MapperGLCanvas* outputCanvas = outputWindow->getCanvas();
+    if (outputCanvas->mapToScene(outputCanvas->viewport()->rect()).boundingRect() != outputRenderer->getSceneRect())
+      return true;
+  }
+
+  return false;
+}
+
+QMap<uid, quint64> MainWindow::shapesRevisions() const
+{
+  QMap<uid, quint64> revisions;
+  for (int i=0; i<mappingManager->nMappings(); i++)
+  {
+    Mapping::ptr mapping = mappingManager->getMapping(i);
+    quint64 revision = mapping->getShape()->getRevision();
+    if (mapping->getInputShape())
+      revision += mapping->getInputShape()->getRevision();
+    revisions[mapping->getId()] = revision;
+  }
+  return revisions;
+}
+
+QSize MainWindow::neededVideoSize(QSharedPointer<Video> video) const
+{
+  int width  = video->getWidth();
+  int height = video->getHeight();
+  if (width <= 0 || height <= 0)
+    return QSize();
+
+  // Find largest magnification from input to output among mappings.
+  qreal scale = 0;
+  QMap<uid, Mapping::ptr> mappings = mappingManager->getPaintMappings(video);
+  for (QMap<uid, Mapping::ptr>::const_iterator it = mappings.constBegin(); it != mappings.constEnd(); ++it)
+  {
+    if (!it.value()->hasInputShape())
+      continue;
+
+    QRectF input  = it.value()->getInputShape()->getBoundingRect();
+    QRectF output = it.value()->getShape()->getBoundingRect();
+    if (input.width() > 0 && input.height() > 0)
+      scale = qMax(scale, qMax(output.width() / input.width(), output.height() / input.height()));
+  }
+
+  // Never upscale (and keep full resolution if there is nothing to go by).
+  if (scale <= 0 || scale > 1)
+    scale = 1;
+
+  // Width is a multiple of 16 (friendly to codecs); height keeps aspect ratio and is even.
+  int newWidth  = qMin(qCeil(width * scale / 16.0) * 16, width);
+  int newHeight = qMin(qRound(height * newWidth / (2.0 * width)) * 2, height);
+  return QSize(newWidth, qMax(newHeight, 2));
+}
+
+void MainWindow::getVideoFrameStatistics(quint64* repeated, quint64* skipped) const
+{
+  *repeated = *skipped = 0;
+  for (int i=0; i<mappingManager->nPaints(); i++)
+  {
+    Paint::ptr paint = mappingManager->getPaint(i);
+    if (paint->getType() == "media")
+    {
+      QSharedPointer<Video> video = qSharedPointerCast<Video>(paint);
+      *repeated += video->getRepeatedFrames();
+      *skipped  += video->getSkippedFrames();
+    }
+  }
+}
+
+qreal MainWindow::getMaxVideoLateness() const
+{
+  qreal lateness = 0;
+  for (int i=0; i<mappingManager->nPaints(); i++)
+  {
+    Paint::ptr paint = mappingManager->getPaint(i);
+    if (paint->getType() == "media")
+      lateness = qMax(lateness, qSharedPointerCast<Video>(paint)->getLateness());
+  }
+  return lateness;
 }
 
 void MainWindow::updatePlayingState()
@@ -2928,7 +3493,33 @@ void MainWindow::enableDisplayControls(bool display)
 void MainWindow::setFramesPerSecond(qreal fps)
 {
   _framesPerSecond = qMax(fps, 0.0);
-  videoTimer->setInterval( int( 1000 / _framesPerSecond ) );
+  frameClock->setFramesPerSecond(_framesPerSecond);
+  updateVideoMaxFramesPerSecond();
+}
+
+void MainWindow::updateVideoMaxFramesPerSecond()
+{
+  _videoMaxFramesPerSecond = frameClock->getTickRate();
+
+  // Make sure videos do not convert more frames than we can render.
+  Video::setDefaultMaxFramesPerSecond(_videoMaxFramesPerSecond);
+  for (int i=0; i<mappingManager->nPaints(); i++)
+  {
+    Paint::ptr paint = mappingManager->getPaint(i);
+    if (paint->getType() == "media")
+      qSharedPointerCast<Video>(paint)->setMaxFramesPerSecond(_videoMaxFramesPerSecond);
+  }
+}
+
+void MainWindow::setSwapInterval(int interval)
+{
+  if (interval == frameClock->getSwapInterval())
+    return;
+
+  // Ticks follow the swaps again at next frame.
+  frameClock->setSwapDriven(false);
+  frameClock->setSwapInterval(interval);
+  outputWindow->setSwapInterval(interval);
 }
 
 void MainWindow::enableDisplayPaintControls(bool display)
@@ -2980,7 +3571,13 @@ void MainWindow::showPaintContextMenu(const QPoint &point)
   QWidget *objectSender = dynamic_cast<QWidget*>(sender());
 
   if (objectSender != NULL && paintList->count() > 0)
+  {
+    // Only media files can be transcoded.
+    Paint::ptr paint = getCurrentPaint();
+    transcodePaintAction->setEnabled(!paint.isNull() && paint->getType() == "media" &&
+                                     !qSharedPointerDynamicCast<TestSource>(paint));
     paintContextMenu->exec(objectSender->mapToGlobal(point));
+  }
 }
 
 void MainWindow::play(bool updatePlayPauseActions)
@@ -29,6 +29,7 @@
 #endif
 #include <QTimer>
 #include <QElapsedTimer>
+#include <QFutureWatcher>
 #include <QVariant>
 #include <QMap>
 #include <QMessageLogger>
@@ -42,6 +43,8 @@
 #endif
 
 #include "OutputGLWindow.h"
+#include "OutputRenderer.h"
+#include "FrameClock.h"
 #include "ConsoleWindow.h"
 
 #include "MappingManager.h"
@@ -54,6 +57,10 @@
 #include "qtgroupboxpropertybrowser.h"
 
 #include "PaintGui.h"
+#include "MediaPreflight.h"
+#include "TranscodeQueue.h"
+#include "SyncClock.h"
+#include "AudioAnalysis.h"
 
 namespace mmp {
 
@@ -95,6 +102,8 @@ private slots:
   void importMedia();
   void openCameraDevice();
   void addColor();
+  void addTestSource();
+  void addPluginSource();
   void about();
   void updateStatusBar();
   void showMenuBar(bool shown);
@@ -114,6 +123,7 @@ private slots:
   // Context menu for paints
   void deletePaintItem();
   void renamePaintItem();
+  void transcodePaintItem();
   void paintListEditEnd(QWidget* editor);
   // Output menu
   void setupOutputScreen();
@@ -139,6 +149,10 @@ private slots:
   void windowModified();
   void pollOscInterface();
   void exitFullScreen();
+  void mediaPreflightFinished();
+  void transcodeProgress(int jobId, int paintId, qreal progress);
+  void transcodeFinished(int jobId, int paintId, const QString& sourceUri, const QString& destinationFile);
+  void transcodeFailed(int jobId, int paintId, const QString& sourceUri, const QString& error);
 
   // Some help links
   void documentation() { QDesktopServices::openUrl(
@@ -165,6 +179,12 @@ public slots:
   /// Create or replace a color paint.
   uid createColorPaint(uid paintId, QColor color);
 
+  /// Create or replace a test source paint (see TestSource).
+  uid createTestSourcePaint(uid paintId, const QString& pattern, int width, int height, int framesPerSecond, const QString& encoder);
+
+  /// Create or replace a frame provider plugin paint (see PluginSource).
+  uid createPluginSourcePaint(uid paintId, const QString& uri, const QString& config);
+
   // TODO: Remove all these unsed fonctions below
 
   /*======= Start of Unsed fonctions =======*/
@@ -219,11 +239,11 @@ public slots:
   /// Deletes/removes a paint and all associated mappigns.
   void deletePaint(uid paintId, bool replace = false);
 
-  /// Updates all canvases.
+  /// Updates all canvases (at next frame).
   void updateCanvases();
 
   /**
-   * This function is triggered framesPerSeconds() times per second. It makes sure
+   * This function is triggered at every tick of the frame clock. It makes sure
    * the image is refreshed (updateCanvases()) and performs other necessary operations.
    */
   void processFrame();
@@ -236,6 +256,7 @@ public slots:
 
   // Editing toggles.
   void setFramesPerSecond(qreal fps);
+  void setSwapInterval(int interval);
   void enableDisplayControls(bool display);
   void enableDisplayPaintControls(bool display);
   void enableStickyVertices(bool display);
@@ -280,12 +301,49 @@ private:
   // Actions-related.
   bool okToContinue();
 
+  // Sends to each video the region used by its input shapes (for cropping at decoding time).
+  void updateVideoInputShapesRegions();
+
+  // Picks the frame of each video to display in the next rendered image.
+  void selectVideoFrames();
+
+  // Makes sure videos do not convert more frames than we render (see FrameClock::getTickRate()).
+  void updateVideoMaxFramesPerSecond();
+
+  // Sets the properties of paints and mappings bound to modulation sources. Returns true iff
+  // one of them changed.
+  bool applyModulations();
+
+  // Updates visible paints. Returns true iff one of them has a new frame to display.
+  bool updatePaints();
+
+  // Returns true iff the canvases need to be rendered again, for other reasons than new frames
+  // of the paints (eg. a mapping was changed or is in transition).
+  bool canvasesNeedRendering() const;
+
+  // Renders all canvases.
+  void renderCanvases();
+
+  // Revisions of the shapes of each mapping, by mapping id (changes whenever a shape does).
+  QMap<uid, quint64> shapesRevisions() const;
+
+  // Smallest size of video that does not lose resolution on the output (given current mappings).
+  QSize neededVideoSize(QSharedPointer<Video> video) const;
+
+  // Total number of repeated and skipped video frames (over all videos).
+  void getVideoFrameStatistics(quint64* repeated, quint64* skipped) const;
+
+  // Largest lateness of the frames shown (over all videos, in seconds).
+  qreal getMaxVideoLateness() const;
+
 public:
   bool loadFile(const QString &fileName);
   bool saveFile(const QString &fileName);
   void setCurrentFile(const QString &fileName);
   void setCurrentVideo(const QString &filename);
   bool importMediaFile(const QString &fileName, bool isImage);
+  // Analyzes given media in the background and reports problems in the console.
+  void startMediaPreflight(const QStringList& uris);
   bool addColorPaint(const QColor& color);
   void addMappingItem(uid mappingId);
   void removeMappingItem(uid mappingId);
@@ -357,6 +415,8 @@ private:
   QAction *importMediaAction;
   QAction *openCameraAction;
   QAction *addColorAction;
+  QAction *addTestSourceAction;
+  QAction *addPluginSourceAction;
   QAction *saveAction;
   QAction *saveAsAction;
   QAction *exitAction;
@@ -372,6 +432,7 @@ private:
   // Paints context menu action
   QAction *deletePaintAction;
   QAction *renamePaintAction;
+  QAction *transcodePaintAction;
   QAction *preferencesAction;
   QAction *aboutAction;
   QAction *clearRecentFileActions;
@@ -437,6 +498,7 @@ private:
   QWidget* destinationPanel;
 
   OutputGLWindow* outputWindow;
+  OutputRenderer* outputRenderer;
   ConsoleWindow* consoleWindow;
 
   QSplitter* mainSplitter;
@@ -484,9 +546,18 @@ private:
   // Number of frames per second.
   qreal _framesPerSecond;
 
+  // Rate videos are currently limited to (see updateVideoMaxFramesPerSecond()).
+  qreal _videoMaxFramesPerSecond;
+
   // True iff the play button is currently pressed.
   bool _isPlaying;
 
+  // True iff canvases have to be rendered at next frame (see updateCanvases()).
+  bool _canvasesChanged;
+
+  // Revisions of the shapes when canvases were last rendered (see shapesRevisions()).
+  QMap<uid, quint64> _renderedShapesRevisions;
+
   // True iff we are displaying the controls.
   bool _displayControls;
 
@@ -504,8 +575,12 @@ private:
   // Keeps track of the current selected item, wether it's a paint or mapping.
   QListWidgetItem* currentSelectedItem;
   QModelIndex currentSelectedIndex;
-  QTimer *videoTimer;
+  FrameClock *frameClock;
   QElapsedTimer *systemTimer;
+  // Media preflight analysis running in the background (NULL if none).
+  QFutureWatcher<MediaPreflightReport> *_preflightWatcher;
+  // Conversion of media to mapping-optimized intermediates.
+  TranscodeQueue *_transcodeQueue;
   // Preference dialog
   PreferenceDialog* _preferenceDialog;
   // About dialog
@@ -520,7 +595,7 @@ private:
   QLabel *lastActionLabel;
   QLabel *currentMessageLabel;
   QLabel *mousePosLabel;
-  QLabel *trueFramesPerSecondsLabel;
+  QLabel *frameTimeLabel;
 
 public:
   // Accessor/mutators for the view. ///////////////////////////////////////////////////////////////////
@@ -543,6 +618,7 @@ public:
   void removeCurrentMapping();
 
   OutputGLWindow* getOutputWindow() const { return outputWindow; }
+  OutputRenderer* getOutputRenderer() const { return outputRenderer; }
   MapperGLCanvas* getSourceCanvas() const { return sourceCanvas; }
   MapperGLCanvas* getDestinationCanvas() const { return destinationCanvas; }
   int getPreferredScreen() const { return outputWindow->getPreferredScreen(); }
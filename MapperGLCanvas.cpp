@@ -104,6 +104,16 @@ QSharedPointer<ShapeGraphicsItem> MapperGLCanvas::getCurrentShapeGraphicsItem()
   return getShapeGraphicsItemFromMapping(_mainWindow->getCurrentMapping());
 }
 
+void MapperGLCanvas::drawBackground(QPainter *painter, const QRectF &rect)
+{
+  QGraphicsView::drawBackground(painter, rect);
+
+  // Mappings are drawn by the output renderer.
+  OutputRenderer* renderer = _mainWindow->getOutputRenderer();
+  if (isOutput() && renderer && renderer->isActive())
+    renderer->draw(painter);
+}
+
 // Draws foreground (displays crosshair if needed).
 void MapperGLCanvas::drawForeground(QPainter *painter , const QRectF &rect)
 {
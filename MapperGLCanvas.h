@@ -66,6 +66,9 @@ public:
 //  QSize sizeHint() const;
 //  QSize minimumSizeHint() const;
 
+  // Draws background (with the composition of the output if there is one).
+  void drawBackground(QPainter *painter, const QRectF &rect);
+
   // Draws foreground (displays crosshair if needed).
   void drawForeground(QPainter *painter , const QRectF &rect);
 
@@ -22,6 +22,8 @@
 #include "Mapping.h"
 #include "MainWindow.h"
 
+#include <QtMath>
+
 namespace mmp {
 
 UidAllocator Mapping::allocator;
@@ -168,4 +170,136 @@ void Mapping::_writeShape(QDomElement& obj, bool isOutput)
   obj.appendChild(shapeObj);
 }
 
+TextureMapping::TextureMapping(int id)
+  : Mapping(id)
+{
+  _init();
+}
+
+TextureMapping::TextureMapping(Paint::ptr paint,
+                               MShape::ptr shape,
+                               MShape::ptr inputShape, uid id)
+  : Mapping(paint, shape, inputShape, id)
+{
+  // Only supports shape of the same type (for now).
+  Q_ASSERT(shape->getType() == inputShape->getType());
+  _init();
+}
+
+void TextureMapping::_init()
+{
+  _transitionDuration = 0;
+  setTransitionCurve(transitionCurves().first());
+  _projection = projections().first();
+
+  _transitionTimer.setSingleShot(true);
+  connect(&_transitionTimer, SIGNAL(timeout()), this, SLOT(_endTransition()));
+}
+
+void TextureMapping::setPaint(Paint::ptr p)
+{
+  if (p == _paint)
+    return;
+
+  // Crossfade from the current paint (if any).
+  Paint::ptr previous = _paint;
+  Mapping::setPaint(p);
+  if (!previous.isNull() && _transitionDuration > 0)
+  {
+    _previousPaint = previous;
+    _transitionElapsed.start();
+    _transitionTimer.start(qCeil(_transitionDuration * 1000));
+  }
+  else
+  {
+    _transitionTimer.stop();
+    _previousPaint.clear();
+  }
+
+  _emitPropertyChanged("paintId");
+}
+
+void TextureMapping::setPaintById(int paintId)
+{
+  Paint::ptr paint = MainWindow::window()->getMappingManager().getPaintById(paintId);
+  if (paint.isNull() || qSharedPointerDynamicCast<Texture>(paint).isNull())
+  {
+    qWarning() << "Mapping " << getId() << " cannot use paint " << paintId << " (not a texture paint)." << endl;
+    return;
+  }
+  setPaint(paint);
+}
+
+void TextureMapping::setTransitionDuration(qreal duration)
+{
+  duration = qMax(duration, qreal(0));
+  if (duration != _transitionDuration)
+  {
+    _transitionDuration = duration;
+    _emitPropertyChanged("transitionDuration");
+  }
+}
+
+void TextureMapping::setTransitionCurve(const QString& curve)
+{
+  static const QEasingCurve::Type types[] = {
+    QEasingCurve::Linear, QEasingCurve::InOutSine, QEasingCurve::InQuad, QEasingCurve::OutQuad
+  };
+
+  int index = transitionCurves().indexOf(curve.trimmed().toLower());
+  if (index < 0)
+  {
+    qWarning() << "Unknown transition curve '" << curve << "'." << endl;
+    return;
+  }
+
+  if (transitionCurves().at(index) != _transitionCurve)
+  {
+    _transitionCurve = transitionCurves().at(index);
+    _easingCurve = QEasingCurve(types[index]);
+    _emitPropertyChanged("transitionCurve");
+  }
+}
+
+qreal TextureMapping::getTransitionProgress() const
+{
+  if (!isInTransition())
+    return 1;
+
+  qreal t = qBound(qreal(0), _transitionElapsed.elapsed() / (_transitionDuration * 1000), qreal(1));
+  return _easingCurve.valueForProgress(t);
+}
+
+QStringList TextureMapping::transitionCurves()
+{
+  return QStringList() << "linear" << "smooth" << "ease-in" << "ease-out";
+}
+
+void TextureMapping::setProjection(const QString& projection)
+{
+  QString name = projection.trimmed().toLower();
+  if (!projections().contains(name))
+  {
+    qWarning() << "Unknown projection '" << projection << "'." << endl;
+    return;
+  }
+
+  if (name != _projection)
+  {
+    _projection = name;
+    _emitPropertyChanged("projection");
+  }
+}
+
+QStringList TextureMapping::projections()
+{
+  return QStringList() << "subdivision" << "homography";
+}
+
+void TextureMapping::_endTransition()
+{
+  _previousPaint.clear();
+  _emitPropertyChanged("inTransition");
+}
+
 }
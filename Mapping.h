@@ -23,6 +23,10 @@
 #define MAPPING_H_
 
 #include <QtGlobal>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QEasingCurve>
+#include <QStringList>
 
 #include "Shape.h"
 #include "Paint.h"
@@ -176,22 +180,29 @@ public:
 /**
  * Object whose paint is an image texture. In the case of a texture mapping we require
  * an additional input shape to specify the area on the image where we pick the pixels.
+ *
+ * Changing the paint of a texture mapping (eg. over OSC through the paintId property)
+ * crossfades from the previous paint to the new one over the transition duration.
+ *
+ * Cells of meshes are drawn with projective (perspective-correct) mapping, either approximated
+ * by recursive subdivision or exact through one homography per cell (see projections()).
  */
 class TextureMapping : public Mapping
 {
   Q_OBJECT
+
+  Q_PROPERTY(qreal   transitionDuration READ getTransitionDuration WRITE setTransitionDuration)
+  Q_PROPERTY(QString transitionCurve    READ getTransitionCurve    WRITE setTransitionCurve)
+  Q_PROPERTY(int     paintId            READ getPaintId            WRITE setPaintById STORED false)
+  Q_PROPERTY(bool    inTransition       READ isInTransition        STORED false)
+  Q_PROPERTY(QString projection         READ getProjection         WRITE setProjection)
+
 public:
-  Q_INVOKABLE TextureMapping(int id=NULL_UID)
-    : Mapping(id) {}
+  Q_INVOKABLE TextureMapping(int id=NULL_UID);
 
   TextureMapping(Paint::ptr paint,
                  MShape::ptr shape,
-                 MShape::ptr inputShape, uid id=NULL_UID)
-    : Mapping(paint, shape, inputShape, id)
-  {
-    // Only supports shape of the same type (for now).
-    Q_ASSERT(shape->getType() == inputShape->getType());
-  }
+                 MShape::ptr inputShape, uid id=NULL_UID);
 
   /// Returns true iff the mapping possesses an input (source) shape.
   virtual bool hasInputShape() const { return true; }
@@ -199,6 +210,56 @@ public:
   virtual QString getType() const {
     return getShape()->getType() + "_texture";
   }
+
+  /// Sets the paint, crossfading from the current one if a transition duration is set.
+  virtual void setPaint(Paint::ptr p);
+
+  /// Sets the paint from its id (only texture paints are accepted).
+  void setPaintById(int paintId);
+  int getPaintId() const { return _paint.isNull() ? NULL_UID : _paint->getId(); }
+
+  /// Duration of crossfades between paints (in seconds; 0 means an immediate switch).
+  void setTransitionDuration(qreal duration);
+  qreal getTransitionDuration() const { return _transitionDuration; }
+
+  /// Shape of the crossfade (one of transitionCurves()).
+  void setTransitionCurve(const QString& curve);
+  QString getTransitionCurve() const { return _transitionCurve; }
+
+  /// Returns true while crossfading from the previous paint.
+  bool isInTransition() const { return !_previousPaint.isNull(); }
+
+  /// Paint being faded out (null if not in transition).
+  Paint::ptr getPreviousPaint() const { return _previousPaint; }
+
+  /// Weight of the current paint in the crossfade, in [0, 1] (1 when not in transition).
+  qreal getTransitionProgress() const;
+
+  static QStringList transitionCurves();
+
+  /// Technique used to map mesh cells (one of projections()).
+  void setProjection(const QString& projection);
+  QString getProjection() const { return _projection; }
+
+  /// Returns true iff mesh cells are mapped through homographies (rather than subdivided).
+  bool hasHomographyProjection() const { return _projection == "homography"; }
+
+  static QStringList projections();
+
+private slots:
+  void _endTransition();
+
+private:
+  void _init();
+
+  qreal _transitionDuration;
+  QString _transitionCurve;
+  QEasingCurve _easingCurve;
+  QString _projection;
+
+  Paint::ptr _previousPaint;
+  QElapsedTimer _transitionElapsed;
+  QTimer _transitionTimer;
 };
 
 }
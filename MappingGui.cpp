@@ -50,6 +50,11 @@ MappingGui::MappingGui(Mapping::ptr mapping)
   _opacityItem->setValue(_mapping->getOpacity()*100.0);
   _topItem->addSubProperty(_opacityItem);
 
+  _modulationItem = _variantManager->addProperty(QVariant::String, QObject::tr("Modulation"));
+  _modulationItem->setToolTip(QObject::tr("eg. opacity: input.band0 0.2 1"));
+  _modulationItem->setValue(_mapping->getModulation());
+  _topItem->addSubProperty(_modulationItem);
+
   // Output shape.
   _outputItem = _variantManager->addProperty(QtVariantPropertyManager::groupTypeId(),
                                              QObject::tr("Output shape"));
@@ -77,6 +82,13 @@ void MappingGui::setValue(QtProperty* property, const QVariant& value)
       emit valueChanged();
     }
   }
+  else if (property == _modulationItem)
+  {
+    // Show modulation as understood (or previous one if invalid).
+    _mapping->setModulation(value.toString());
+    _modulationItem->setValue(_mapping->getModulation());
+    emit valueChanged();
+  }
   else
   {
     std::map<QtProperty*, std::pair<MShape*, int> >::iterator it = _propertyToVertex.find(property);
@@ -98,6 +110,8 @@ void MappingGui::setValue(QString propertyName, QVariant value)
 {
   if (propertyName == "opacity")
     _opacityItem->setValue(value.toDouble() * 100);
+  else if (propertyName == "modulation")
+    _modulationItem->setValue(value);
 }
 
 void MappingGui::updateShape(MShape* shape)
@@ -261,6 +275,55 @@ TextureMappingGui::TextureMappingGui(QSharedPointer<TextureMapping> mapping)
 
   // Collapse input shape.
   _propertyBrowser->setExpanded(_propertyBrowser->items(_inputItem).at(0), false);
+
+  // Transition between paints.
+  _transitionDurationItem = _variantManager->addProperty(QVariant::Double,
+                                                         QObject::tr("Transition (s)"));
+  _transitionDurationItem->setAttribute("minimum", 0.0);
+  _transitionDurationItem->setAttribute("decimals", 2);
+  _transitionDurationItem->setAttribute("singleStep", 0.1);
+  _transitionDurationItem->setValue(mapping->getTransitionDuration());
+  _topItem->addSubProperty(_transitionDurationItem);
+
+  _transitionCurveItem = _variantManager->addProperty(QtVariantPropertyManager::enumTypeId(),
+                                                      QObject::tr("Transition curve"));
+  _transitionCurveItem->setAttribute("enumNames", TextureMapping::transitionCurves());
+  _transitionCurveItem->setValue(TextureMapping::transitionCurves().indexOf(mapping->getTransitionCurve()));
+  _topItem->addSubProperty(_transitionCurveItem);
+}
+
+void TextureMappingGui::setValue(QtProperty* property, const QVariant& value)
+{
+  QSharedPointer<TextureMapping> mapping = textureMapping.toStrongRef();
+  if (property == _transitionDurationItem)
+  {
+    if (value.toDouble() != mapping->getTransitionDuration())
+    {
+      mapping->setTransitionDuration(value.toDouble());
+      emit valueChanged();
+    }
+  }
+  else if (property == _transitionCurveItem)
+  {
+    QString curve = TextureMapping::transitionCurves().value(value.toInt());
+    if (curve != mapping->getTransitionCurve())
+    {
+      mapping->setTransitionCurve(curve);
+      emit valueChanged();
+    }
+  }
+  else
+    MappingGui::setValue(property, value);
+}
+
+void TextureMappingGui::setValue(QString propertyName, QVariant value)
+{
+  if (propertyName == "transitionDuration")
+    _transitionDurationItem->setValue(value);
+  else if (propertyName == "transitionCurve")
+    _transitionCurveItem->setValue(TextureMapping::transitionCurves().indexOf(value.toString()));
+  else
+    MappingGui::setValue(propertyName, value);
 }
 //
 //void TextureMappingGui::drawInput(QPainter* painter)
@@ -394,6 +457,13 @@ MeshTextureMappingGui::MeshTextureMappingGui(QSharedPointer<TextureMapping> mapp
   _meshItem->setValue(QSize(mesh->nColumns(), mesh->nRows()));
   _meshItem->setAttribute("minimum", QSize(2,2));
   _topItem->insertSubProperty(_meshItem, _opacityItem); // insert at the beginning
+
+  // Projection of the cells.
+  _projectionItem = _variantManager->addProperty(QtVariantPropertyManager::enumTypeId(),
+                                                 QObject::tr("Projection"));
+  _projectionItem->setAttribute("enumNames", TextureMapping::projections());
+  _projectionItem->setValue(TextureMapping::projections().indexOf(mapping->getProjection()));
+  _topItem->insertSubProperty(_projectionItem, _meshItem);
 }
 
 void MeshTextureMappingGui::setValue(QtProperty* property, const QVariant& value)
@@ -417,10 +487,28 @@ void MeshTextureMappingGui::setValue(QtProperty* property, const QVariant& value
       emit valueChanged();
     }
   }
+  else if (property == _projectionItem)
+  {
+    QSharedPointer<TextureMapping> mapping = textureMapping.toStrongRef();
+    QString projection = TextureMapping::projections().value(value.toInt());
+    if (projection != mapping->getProjection())
+    {
+      mapping->setProjection(projection);
+      emit valueChanged();
+    }
+  }
   else
     TextureMappingGui::setValue(property, value);
 }
 
+void MeshTextureMappingGui::setValue(QString propertyName, QVariant value)
+{
+  if (propertyName == "projection")
+    _projectionItem->setValue(TextureMapping::projections().indexOf(value.toString()));
+  else
+    TextureMappingGui::setValue(propertyName, value);
+}
+
 EllipseTextureMappingGui::EllipseTextureMappingGui(QSharedPointer<TextureMapping> mapping)
 : PolygonTextureMappingGui(mapping)
 {
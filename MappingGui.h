@@ -100,6 +100,7 @@ protected:
 
   QtProperty* _topItem;
   QtVariantProperty* _opacityItem;
+  QtVariantProperty* _modulationItem;
   QtProperty* _outputItem;
 
   std::map<QtProperty*, std::pair<MShape*, int> > _propertyToVertex;
@@ -170,11 +171,15 @@ public:
   virtual ~TextureMappingGui() {}
 
 public slots:
+  virtual void setValue(QtProperty* property, const QVariant& value);
+  virtual void setValue(QString propertyName, QVariant value);
   virtual void updateShape(MShape* shape);
 
 protected:
   QtProperty* _inputItem;
   QtVariantProperty* _meshItem;
+  QtVariantProperty* _transitionDurationItem;
+  QtVariantProperty* _transitionCurveItem;
 
   // FIXME: use typedefs, member of the class for type names that are too long to type:
   QWeakPointer<TextureMapping> textureMapping;
@@ -210,9 +215,11 @@ public:
 
 public slots:
   virtual void setValue(QtProperty* property, const QVariant& value);
+  virtual void setValue(QString propertyName, QVariant value);
 
 private:
   QtVariantProperty* _meshItem;
+  QtVariantProperty* _projectionItem;
 };
 
 class EllipseTextureMappingGui : public PolygonTextureMappingGui {
@@ -228,6 +228,12 @@ QVector<Paint::ptr> MappingManager::getVisiblePaints() const
     Paint::ptr paint((*it)->getPaint());
     if (!visiblePaints.contains(paint))
       visiblePaints.push_back(paint);
+
+    // Paints being faded out are still visible.
+    QSharedPointer<TextureMapping> textureMapping = qSharedPointerDynamicCast<TextureMapping>(*it);
+    if (textureMapping && textureMapping->isInTransition() &&
+        !visiblePaints.contains(textureMapping->getPreviousPaint()))
+      visiblePaints.push_back(textureMapping->getPreviousPaint());
   }
   return visiblePaints;
 }
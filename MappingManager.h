@@ -79,7 +79,7 @@ public:
   Paint::ptr getPaint(int i) { return paintVector[i]; }
 
   /// Returns paint with given uid.
-  Paint::ptr getPaintById(uid id) { return paintMap[id]; }
+  Paint::ptr getPaintById(uid id) const { return paintMap.value(id); }
 
   /// Returns mapping with given name (first match).
   Paint::ptr getPaintByName(QString name);
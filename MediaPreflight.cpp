@@ -0,0 +1,447 @@
+/*
+ * MediaPreflight.cpp
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MediaPreflight.h"
+
+#include <QtConcurrent>
+#include <QAtomicInt>
+#include <QDomDocument>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QDebug>
+
+// GStreamer includes.
+#include <gst/gst.h>
+#include <gst/pbutils/pbutils.h>
+
+#include "Paint.h"
+#include "ProjectLabels.h"
+#include "Serializable.h"
+
+namespace mmp {
+
+// Reference for decoding costs: one 1080p30 stream.
+static const qreal REFERENCE_PIXELS_PER_SECOND = 1920.0 * 1080.0 * 30.0;
+
+// Number of 1080p30 H.264 streams one CPU is expected to decode in real time (conservative).
+static const qreal STREAMS_PER_CPU = 0.5;
+
+// Relative decoding cost of codecs (H.264 = 1).
+static qreal _codecCostFactor(const GstCaps* caps)
+{
+  if (!caps || gst_caps_is_empty(caps))
+    return 1.0;
+
+  const GstStructure* structure = gst_caps_get_structure(caps, 0);
+  QString name = gst_structure_get_name(structure);
+  if (name == "video/x-h265")   return 1.6;
+  if (name == "video/x-vp9")    return 1.5;
+  if (name == "video/x-av1")    return 2.5;
+  if (name == "video/x-vp8")    return 1.0;
+  if (name == "video/x-prores") return 0.8;
+  if (name == "video/x-dnxhd")  return 0.8;
+  if (name == "image/jpeg")     return 0.8;
+  if (name == "video/x-raw")    return 0.3;
+  if (name == "video/mpeg")
+  {
+    gint version = 0;
+    gst_structure_get_int(structure, "mpegversion", &version);
+    return (version == 4 ? 0.7 : 0.5);
+  }
+  return 1.0;
+}
+
+// Converts a file name to a URI if needed (the result must be freed with g_free()).
+static gchar* _toUri(const QString& path)
+{
+  QByteArray utf8 = path.toUtf8();
+  if (gst_uri_is_valid(utf8.constData()))
+    return g_strdup(utf8.constData());
+
+  GError* error = NULL;
+  gchar* uri = gst_filename_to_uri(utf8.constData(), &error);
+  if (error)
+    g_clear_error(&error);
+  return uri;
+}
+
+MediaPreflightReport::MediaPreflightReport() :
+  ok(false),
+  width(0),
+  height(0),
+  framesPerSecond(0),
+  duration(0),
+  gopLength(-1),
+  gopIsLowerBound(false),
+  hasAudio(false),
+  decodeCost(0),
+  likelyToDropFrames(false)
+{}
+
+QString MediaPreflightReport::toString() const
+{
+  QString str = QFileInfo(uri).fileName() + ": ";
+  if (!ok)
+    str += QObject::tr("ERROR (%1)").arg(error);
+  else
+  {
+    str += QString("%1 %2x%3").arg(videoCodec).arg(width).arg(height);
+    str += (framesPerSecond > 0 ? QString(" @ %1 fps").arg(framesPerSecond, 0, 'f', 2) : QString(" @ ? fps"));
+    str += QObject::tr(", GOP %1").arg(gopLength < 0 ? QString("?") : (gopIsLowerBound ? ">=" : "") + QString::number(gopLength));
+    str += (hasAudio ? QObject::tr(", audio (%1)").arg(audioCodec) : QObject::tr(", no audio"));
+    str += QObject::tr(", decode cost %1").arg(decodeCost, 0, 'f', 2);
+  }
+
+  foreach (const QString& warning, warnings)
+    str += "\n    " + QObject::tr("Warning: ") + warning;
+
+  return str;
+}
+
+QStringList MediaPreflight::mediaUris(const QDomElement& project)
+{
+  QStringList uris;
+  QString videoClassName = Video::staticMetaObject.className();
+
+  QDomElement paints = project.firstChildElement(ProjectLabels::PAINTS);
+  for (QDomElement paint = paints.firstChildElement(); !paint.isNull(); paint = paint.nextSiblingElement())
+  {
+    if (Serializable::classNameCleanToReal(paint.attribute(ProjectLabels::CLASS_NAME)) != videoClassName)
+      continue;
+
+    QString uri = paint.firstChildElement("uri").text();
+    if (!uri.isEmpty() && !uris.contains(uri))
+      uris.append(uri);
+  }
+
+  return uris;
+}
+
+bool MediaPreflight::mediaUrisFromFile(const QString& fileName, QStringList* uris)
+{
+  QFile file(fileName);
+  if (!file.open(QFile::ReadOnly | QFile::Text))
+  {
+    qWarning() << "Cannot read file " << fileName << ": " << file.errorString() << endl;
+    return false;
+  }
+
+  QDomDocument doc;
+  QString errorStr;
+  int errorLine, errorColumn;
+  if (!doc.setContent(&file, false, &errorStr, &errorLine, &errorColumn))
+  {
+    qWarning() << "Parse error at line " << errorLine << ", column " << errorColumn << ": " << errorStr << endl;
+    return false;
+  }
+
+  *uris = mediaUris(doc.documentElement());
+  return true;
+}
+
+// Shared state of the GOP analysis pipeline.
+struct GopAnalysis
+{
+  GstElement* pipeline;
+  QAtomicInt  nFrames;
+  QAtomicInt  nKeyFrames;
+};
+
+static GstPadProbeReturn _gopBufferProbe(GstPad*, GstPadProbeInfo* info, GopAnalysis* analysis)
+{
+  GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+  if (buffer)
+  {
+    analysis->nFrames.ref();
+    if (!GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT))
+      analysis->nKeyFrames.ref();
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+static void _gopSourcePadAdded(GstElement*, GstPad* newPad, GstElement* parser)
+{
+  GstPad* sinkPad = gst_element_get_static_pad(parser, "sink");
+  if (!gst_pad_is_linked(sinkPad))
+    gst_pad_link(newPad, sinkPad);
+  gst_object_unref(sinkPad);
+}
+
+static void _gopParserPadAdded(GstElement*, GstPad* newPad, GopAnalysis* analysis)
+{
+  // Every stream goes to its own sink (unlinked pads would stop the pipeline).
+  GstElement* sink = gst_element_factory_make("fakesink", NULL);
+  g_object_set(sink, "sync", FALSE, NULL);
+  gst_bin_add(GST_BIN(analysis->pipeline), sink);
+  gst_element_sync_state_with_parent(sink);
+
+  GstPad* sinkPad = gst_element_get_static_pad(sink, "sink");
+  gst_pad_link(newPad, sinkPad);
+  gst_object_unref(sinkPad);
+
+  // Count (compressed) video frames and keyframes.
+  GstCaps* caps = gst_pad_query_caps(newPad, NULL);
+  if (caps && !gst_caps_is_empty(caps) &&
+      g_str_has_prefix(gst_structure_get_name(gst_caps_get_structure(caps, 0)), "video/"))
+    gst_pad_add_probe(newPad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback) _gopBufferProbe, analysis, NULL);
+  if (caps)
+    gst_caps_unref(caps);
+}
+
+// Measures GOP length by counting keyframes in the compressed video stream.
+static void _analyzeGop(const gchar* uri, MediaPreflightReport* report)
+{
+  GopAnalysis analysis;
+  analysis.pipeline = gst_pipeline_new(NULL);
+  GstElement* source = gst_element_factory_make("urisourcebin", NULL);
+  GstElement* parser = gst_element_factory_make("parsebin", NULL);
+  if (!analysis.pipeline || !source || !parser)
+  {
+    report->warnings.append(QObject::tr("cannot measure GOP length (missing urisourcebin/parsebin)"));
+    if (analysis.pipeline) gst_object_unref(analysis.pipeline);
+    if (source) gst_object_unref(source);
+    if (parser) gst_object_unref(parser);
+    return;
+  }
+
+  g_object_set(source, "uri", uri, NULL);
+  gst_bin_add_many(GST_BIN(analysis.pipeline), source, parser, NULL);
+  g_signal_connect(source, "pad-added", G_CALLBACK(_gopSourcePadAdded), parser);
+  g_signal_connect(parser, "pad-added", G_CALLBACK(_gopParserPadAdded), &analysis);
+
+  gst_element_set_state(analysis.pipeline, GST_STATE_PLAYING);
+
+  // Run until we have seen enough frames, reached the end, or timed out.
+  GstBus* bus = gst_element_get_bus(analysis.pipeline);
+  QElapsedTimer timer;
+  timer.start();
+  while (analysis.nFrames.load() < MediaPreflight::GOP_ANALYSIS_FRAMES &&
+         timer.elapsed() < MediaPreflight::ANALYSIS_TIMEOUT)
+  {
+    GstMessage* msg = gst_bus_timed_pop_filtered(bus, 10 * GST_MSECOND,
+                                                 GstMessageType(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    if (msg)
+    {
+      gst_message_unref(msg);
+      break;
+    }
+  }
+
+  gst_element_set_state(analysis.pipeline, GST_STATE_NULL);
+  gst_object_unref(bus);
+  gst_object_unref(analysis.pipeline);
+
+  int nFrames    = analysis.nFrames.load();
+  int nKeyFrames = analysis.nKeyFrames.load();
+  if (nFrames > 0 && nKeyFrames > 0)
+  {
+    // Only one keyframe: GOP is at least as long as what we have seen.
+    report->gopIsLowerBound = (nKeyFrames == 1);
+    report->gopLength = qMax(nFrames / nKeyFrames, 1);
+  }
+}
+
+MediaPreflightReport MediaPreflight::analyze(const QString& uri)
+{
+  MediaPreflightReport report;
+  report.uri = uri;
+
+  // Check local files first: discoverer errors are not very informative.
+  gchar* gstUri = _toUri(uri);
+  if (!gstUri)
+  {
+    report.error = QObject::tr("invalid URI");
+    return report;
+  }
+  gchar* fileName = g_filename_from_uri(gstUri, NULL, NULL);
+  if (fileName)
+  {
+    bool exists = QFileInfo(QString::fromUtf8(fileName)).exists();
+    g_free(fileName);
+    if (!exists)
+    {
+      report.error = QObject::tr("file not found");
+      g_free(gstUri);
+      return report;
+    }
+  }
+
+  // Discover stream information.
+  GError* error = NULL;
+  GstDiscoverer* discoverer = gst_discoverer_new(ANALYSIS_TIMEOUT * GST_MSECOND, &error);
+  if (!discoverer)
+  {
+    report.error = QObject::tr("cannot create discoverer: %1").arg(error ? error->message : "");
+    g_clear_error(&error);
+    g_free(gstUri);
+    return report;
+  }
+
+  GstDiscovererInfo* info = gst_discoverer_discover_uri(discoverer, gstUri, &error);
+  GstDiscovererResult result = (info ? gst_discoverer_info_get_result(info) : GST_DISCOVERER_ERROR);
+  switch (result)
+  {
+    case GST_DISCOVERER_OK:
+      break;
+    case GST_DISCOVERER_URI_INVALID:
+      report.error = QObject::tr("invalid URI");
+      break;
+    case GST_DISCOVERER_TIMEOUT:
+      report.error = QObject::tr("timeout");
+      break;
+    case GST_DISCOVERER_MISSING_PLUGINS:
+      report.error = QObject::tr("missing plugins");
+      break;
+    default:
+      report.error = (error ? QString(error->message) : QObject::tr("cannot be played"));
+      break;
+  }
+  g_clear_error(&error);
+
+  if (result == GST_DISCOVERER_OK)
+  {
+    GList* videoStreams = gst_discoverer_info_get_video_streams(info);
+    GList* audioStreams = gst_discoverer_info_get_audio_streams(info);
+
+    if (!videoStreams)
+      report.error = QObject::tr("no video stream");
+    else
+    {
+      GstDiscovererVideoInfo* videoInfo = (GstDiscovererVideoInfo*) videoStreams->data;
+      report.ok = true;
+      report.width  = gst_discoverer_video_info_get_width(videoInfo);
+      report.height = gst_discoverer_video_info_get_height(videoInfo);
+      guint num = gst_discoverer_video_info_get_framerate_num(videoInfo);
+      guint denom = gst_discoverer_video_info_get_framerate_denom(videoInfo);
+      report.framesPerSecond = (denom > 0 ? qreal(num) / denom : 0);
+      report.duration = gst_discoverer_info_get_duration(info) / qreal(GST_SECOND);
+
+      GstCaps* caps = gst_discoverer_stream_info_get_caps((GstDiscovererStreamInfo*) videoInfo);
+      if (caps)
+      {
+        gchar* description = gst_pb_utils_get_codec_description(caps);
+        report.videoCodec = (description ? description : "?");
+        g_free(description);
+      }
+
+      // Estimate decoding cost (unknown framerates are considered to be 30 fps).
+      qreal fps = (report.framesPerSecond > 0 ? report.framesPerSecond : 30.0);
+      report.decodeCost = report.width * report.height * fps / REFERENCE_PIXELS_PER_SECOND * _codecCostFactor(caps);
+      if (caps)
+        gst_caps_unref(caps);
+
+      if (audioStreams)
+      {
+        report.hasAudio = true;
+        GstCaps* audioCaps = gst_discoverer_stream_info_get_caps((GstDiscovererStreamInfo*) audioStreams->data);
+        if (audioCaps)
+        {
+          gchar* description = gst_pb_utils_get_codec_description(audioCaps);
+          report.audioCodec = (description ? description : "?");
+          g_free(description);
+          gst_caps_unref(audioCaps);
+        }
+      }
+
+      if (!gst_discoverer_info_get_seekable(info))
+        report.warnings.append(QObject::tr("not seekable: looping requires reloading the file"));
+    }
+
+    gst_discoverer_stream_info_list_free(videoStreams);
+    gst_discoverer_stream_info_list_free(audioStreams);
+  }
+
+  if (info)
+    gst_discoverer_info_unref(info);
+  g_object_unref(discoverer);
+
+  // Measure GOP length.
+  if (report.ok)
+  {
+    _analyzeGop(gstUri, &report);
+    if (report.gopLength > 0 && report.framesPerSecond > 0 &&
+        report.gopLength / report.framesPerSecond > LONG_GOP_SECONDS)
+      report.warnings.append(QObject::tr("long GOP (%1 s): seeking and looping may stall playback")
+                             .arg(report.gopLength / report.framesPerSecond, 0, 'f', 1));
+  }
+
+  g_free(gstUri);
+  return report;
+}
+
+QFuture<MediaPreflightReport> MediaPreflight::start(const QStringList& uris)
+{
+  return QtConcurrent::mapped(uris, &MediaPreflight::analyze);
+}
+
+QList<MediaPreflightReport> MediaPreflight::run(const QStringList& uris)
+{
+  QList<MediaPreflightReport> reports = QtConcurrent::blockingMapped<QList<MediaPreflightReport> >(uris, &MediaPreflight::analyze);
+  assess(reports);
+  return reports;
+}
+
+qreal MediaPreflight::decodeCapacity()
+{
+  return qMax(QThread::idealThreadCount(), 1) * STREAMS_PER_CPU;
+}
+
+void MediaPreflight::assess(QList<MediaPreflightReport>& reports)
+{
+  qreal capacity = decodeCapacity();
+
+  // Media that cannot be decoded in real time on their own.
+  qreal totalCost = 0;
+  for (int i=0; i<reports.size(); i++)
+  {
+    MediaPreflightReport& report = reports[i];
+    if (!report.ok)
+    {
+      report.likelyToDropFrames = true;
+      continue;
+    }
+
+    if (report.decodeCost > capacity)
+    {
+      report.likelyToDropFrames = true;
+      report.warnings.append(QObject::tr("decode cost exceeds the capacity of this machine (%1)").arg(capacity, 0, 'f', 2));
+    }
+    else
+      totalCost += report.decodeCost;
+  }
+
+  // All media decoded at the same time: flag the most expensive ones until the rest fits.
+  while (totalCost > capacity)
+  {
+    int mostExpensive = -1;
+    for (int i=0; i<reports.size(); i++)
+      if (reports[i].ok && !reports[i].likelyToDropFrames &&
+          (mostExpensive < 0 || reports[i].decodeCost > reports[mostExpensive].decodeCost))
+        mostExpensive = i;
+
+    if (mostExpensive < 0)
+      break;
+
+    reports[mostExpensive].likelyToDropFrames = true;
+    reports[mostExpensive].warnings.append(QObject::tr("all media together exceed the decoding capacity of this machine"));
+    totalCost -= reports[mostExpensive].decodeCost;
+  }
+}
+
+}
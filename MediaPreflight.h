@@ -0,0 +1,106 @@
+/*
+ * MediaPreflight.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEDIA_PREFLIGHT_H_
+#define MEDIA_PREFLIGHT_H_
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QDomElement>
+#include <QFuture>
+
+#include "MM.h"
+
+namespace mmp {
+
+/**
+ * Information gathered about a media file before it gets played.
+ */
+struct MediaPreflightReport
+{
+  MediaPreflightReport();
+
+  QString uri;
+  bool    ok;               // false if the media could not be analyzed (see error)
+  QString error;
+
+  QString videoCodec;
+  int     width;
+  int     height;
+  qreal   framesPerSecond;  // 0 if unknown or variable
+  qreal   duration;         // in seconds
+  int     gopLength;        // average number of frames between keyframes (-1 if unknown)
+  bool    gopIsLowerBound;  // true if no second keyframe was found while analyzing
+  bool    hasAudio;
+  QString audioCodec;
+
+  /// Estimated decoding cost, in number of 1080p30 H.264 streams.
+  qreal   decodeCost;
+
+  /// True iff this media is likely to cause frame drops on this machine.
+  bool    likelyToDropFrames;
+  QStringList warnings;
+
+  /// One-line (plus warnings) human-readable summary.
+  QString toString() const;
+};
+
+/**
+ * Analyzes media referenced by a project (in parallel) so that problematic files
+ * are found when the project is loaded rather than at show time.
+ */
+class MediaPreflight
+{
+public:
+  /// Returns the URIs of all video media referenced by a project (<project> element).
+  static QStringList mediaUris(const QDomElement& project);
+
+  /// Reads a project file and returns the URIs of its video media. Returns false on error.
+  static bool mediaUrisFromFile(const QString& fileName, QStringList* uris);
+
+  /// Analyzes a single media (blocking).
+  static MediaPreflightReport analyze(const QString& uri);
+
+  /// Starts analyzing media in parallel (non-blocking). Call assess() on the results.
+  static QFuture<MediaPreflightReport> start(const QStringList& uris);
+
+  /// Analyzes all media in parallel and assesses them (blocking).
+  static QList<MediaPreflightReport> run(const QStringList& uris);
+
+  /**
+   * Flags media likely to cause frame drops on this machine, considering that all
+   * of them are decoded at the same time.
+   */
+  static void assess(QList<MediaPreflightReport>& reports);
+
+  /// Estimated decoding capacity of this machine (in number of 1080p30 H.264 streams).
+  static qreal decodeCapacity();
+
+  /// Timeout for the analysis of one media (in ms).
+  static const int ANALYSIS_TIMEOUT = 5000;
+
+  /// Number of video frames inspected to measure GOP length.
+  static const int GOP_ANALYSIS_FRAMES = 300;
+
+  /// Duration (in seconds) above which a GOP is considered long.
+  static const int LONG_GOP_SECONDS = 4;
+};
+
+}
+
+#endif /* MEDIA_PREFLIGHT_H_ */
@@ -488,6 +488,7 @@ void Mesh::_reorderVertices()
 
   // Copy.
   vertices = newVertices;
+  _verticesChanged();
 }
 
 }
@@ -64,14 +64,19 @@ public:
     return vertices[_vertices2d[i][j]];
   }
 
+  quint64 getVertexRevision2d(int i, int j) const
+  {
+    return getVertexRevision(_vertices2d[i][j]);
+  }
+
   void setVertex2d(int i, int j, const QPointF& v)
   {
-    vertices[_vertices2d[i][j]] = v; // copy
+    _rawSetVertex(_vertices2d[i][j], v);
   }
 
   void setVertex2d(int i, int j, double x, double y)
   {
-    vertices[_vertices2d[i][j]] = QPointF(x, y);
+    _rawSetVertex(_vertices2d[i][j], QPointF(x, y));
   }
 
   void resizeVertices2d(IndexVector2d& vertices2d, int nColumns, int nRows);
@@ -0,0 +1,123 @@
+/*
+ * Modulation.cpp
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Modulation.h"
+
+#include <QRegExp>
+#include <QStringList>
+#include <QDebug>
+
+#include "AudioAnalysis.h"
+#include "MainWindow.h"
+
+namespace mmp {
+
+const QChar Modulation::BINDING_SEPARATOR  = ';';
+const QChar Modulation::PROPERTY_SEPARATOR = ':';
+
+// Source names: "<id or input>.level" or "<id or input>.band<n>".
+static QRegExp _sourcePattern()
+{
+  return QRegExp("(input|\\d+)\\.(level|band(\\d+))");
+}
+
+bool Modulation::parse(const QString& text, QList<ModulationBinding>* bindings)
+{
+  QList<ModulationBinding> parsed;
+  foreach (const QString& entry, text.split(BINDING_SEPARATOR, QString::SkipEmptyParts))
+  {
+    if (entry.trimmed().isEmpty())
+      continue;
+
+    // Property name then source and optional range.
+    int separator = entry.indexOf(PROPERTY_SEPARATOR);
+    QStringList fields = entry.mid(separator + 1).split(' ', QString::SkipEmptyParts);
+    ModulationBinding binding;
+    binding.property = entry.left(qMax(separator, 0)).trimmed();
+    binding.source = fields.value(0).toLower();
+
+    bool ok = (separator > 0 && !binding.property.isEmpty() && isValidSource(binding.source) &&
+               (fields.size() == 1 || fields.size() == 3));
+    if (ok && fields.size() == 3)
+    {
+      bool okMinimum, okMaximum;
+      binding.minimum = fields[1].toDouble(&okMinimum);
+      binding.maximum = fields[2].toDouble(&okMaximum);
+      ok = okMinimum && okMaximum;
+    }
+
+    if (!ok)
+    {
+      qWarning() << "Invalid modulation '" << entry.trimmed() << "' (expected eg. opacity: input.band0 0.2 1)." << endl;
+      return false;
+    }
+
+    parsed.append(binding);
+  }
+
+  *bindings = parsed;
+  return true;
+}
+
+QString Modulation::toString(const QList<ModulationBinding>& bindings)
+{
+  QStringList entries;
+  foreach (const ModulationBinding& binding, bindings)
+  {
+    QString entry = QString("%1%2 %3").arg(binding.property).arg(PROPERTY_SEPARATOR).arg(binding.source);
+    if (binding.minimum != 0 || binding.maximum != 1)
+      entry += QString(" %1 %2").arg(binding.minimum).arg(binding.maximum);
+    entries.append(entry);
+  }
+  return entries.join(QString(BINDING_SEPARATOR) + " ");
+}
+
+bool Modulation::isValidSource(const QString& source)
+{
+  QRegExp pattern = _sourcePattern();
+  return (pattern.exactMatch(source) &&
+          (pattern.cap(3).isEmpty() || pattern.cap(3).toInt() < AudioAnalysis::N_BANDS));
+}
+
+bool Modulation::getSourceValue(const QString& source, qreal* value)
+{
+  QRegExp pattern = _sourcePattern();
+  if (!pattern.exactMatch(source))
+    return false;
+
+  // Find the analysis of the source.
+  const AudioAnalysis* analysis = NULL;
+  if (pattern.cap(1) == "input")
+  {
+    if (AudioInput::isActive())
+      analysis = &AudioInput::analysis();
+  }
+  else
+  {
+    Paint::ptr paint = MainWindow::window()->getMappingManager().getPaintById(pattern.cap(1).toInt());
+    if (paint && paint->getType() == "media")
+      analysis = qSharedPointerCast<Video>(paint)->getAudioAnalysis();
+  }
+
+  if (!analysis)
+    return false;
+
+  *value = (pattern.cap(2) == "level" ? analysis->getLevel() : analysis->getBand(pattern.cap(3).toInt()));
+  return true;
+}
+
+}
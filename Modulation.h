@@ -0,0 +1,71 @@
+/*
+ * Modulation.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MODULATION_H_
+#define MODULATION_H_
+
+#include <QString>
+#include <QList>
+
+namespace mmp {
+
+/**
+ * Binding of a property to a modulation source: the property is set to
+ * minimum + (maximum - minimum) * value of the source.
+ */
+struct ModulationBinding
+{
+  ModulationBinding() : minimum(0), maximum(1) {}
+
+  QString property;
+  QString source;
+  qreal   minimum;
+  qreal   maximum;
+};
+
+/**
+ * Modulation sources are audio measures, all in [0, 1]:
+ *   <id>.level, <id>.band<n>     audio of the media paint with given id (with audio analysis on)
+ *   input.level, input.band<n>   audio input (see AudioInput)
+ * where bands go from 0 (lowest) to AudioAnalysis::N_BANDS-1.
+ *
+ * Bindings are written as a property name, a colon, a source and an optional range, several
+ * bindings being separated by semicolons, eg.:
+ *   opacity: input.band0 0.2 1; volume: 3.level
+ */
+class Modulation
+{
+public:
+  /// Parses bindings. Returns false if invalid.
+  static bool parse(const QString& text, QList<ModulationBinding>* bindings);
+
+  /// Returns bindings in the same form as the one accepted by parse().
+  static QString toString(const QList<ModulationBinding>& bindings);
+
+  /// Current value of a source. Returns false if the source does not exist or has no measures.
+  static bool getSourceValue(const QString& source, qreal* value);
+
+  /// Returns true iff source is a well-formed source name.
+  static bool isValidSource(const QString& source);
+
+  static const QChar BINDING_SEPARATOR;
+  static const QChar PROPERTY_SEPARATOR;
+};
+
+}
+
+#endif /* MODULATION_H_ */
@@ -27,7 +27,9 @@ namespace mmp {
 OutputGLCanvas::OutputGLCanvas(MainWindow* mainWindow, QWidget* parent, const QGLWidget* shareWidget, QGraphicsScene* scene)
 : MapperGLCanvas(mainWindow, true, parent, shareWidget, scene),
   _displayCrosshair(false),
-  _displayTestSignal(false)
+  _displayTestSignal(false),
+  _shareWidget(shareWidget),
+  _swapInterval(-1)
 {
   // Disable scrollbars.
   setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
@@ -231,11 +233,30 @@ void OutputGLCanvas::_drawResolutionText(QPainter *painter, const QRect &rect, i
   }
 }
 
+void OutputGLCanvas::setSwapInterval(int interval)
+{
+  if (interval == _swapInterval)
+    return;
+
+  // Swap interval is part of the format: the viewport has to be created again.
+  QGLFormat format(QGL::SampleBuffers);
+  format.setSwapInterval(interval);
+  setViewport(new QGLWidget(format, this, _shareWidget));
+  _swapInterval = interval;
+}
+
 void OutputGLCanvas::resizeGL(int width, int height)
 {
   setSceneRectToViewportGeometry();
 }
 
+void OutputGLCanvas::paintEvent(QPaintEvent* event)
+{
+  // Buffers are swapped once the painter of the viewport is done.
+  MapperGLCanvas::paintEvent(event);
+  emit swapped();
+}
+
 void OutputGLCanvas::wheelEvent(QWheelEvent *event)
 {
   event->ignore();
@@ -40,6 +40,13 @@ public:
   // Draws foreground (displays crosshair if needed).
   void drawForeground(QPainter *painter , const QRectF &rect);
 
+  /// Sets the number of vertical blanks between buffer swaps (0 for no vertical sync).
+  void setSwapInterval(int interval);
+
+signals:
+  /// Emitted once the viewport was painted and its buffers swapped.
+  void swapped();
+
 public:
   void setDisplayCrosshair(bool displayCrosshair) {
     _displayCrosshair = displayCrosshair;
@@ -63,10 +70,17 @@ private:
   QImage _palTestCard;
   QImage _ntscTestCard;
 
+  // Context the viewport shares and swap interval of its format (-1 for default).
+  const QGLWidget* _shareWidget;
+  int _swapInterval;
+
 protected:
   // overriden from QGlWidget:
   virtual void resizeGL(int width, int height);
 
+  // Reports buffer swaps (see swapped()).
+  virtual void paintEvent(QPaintEvent* event);
+
   void wheelEvent(QWheelEvent *event);
   void mouseMoveEvent(QMouseEvent *event);
 };
@@ -59,6 +59,9 @@ public:
   int getPreferredScreen() const { return _preferredScreen; }
   void setPreferredScreen(int screen);
 
+  /// Sets the vertical sync of the canvas (see OutputGLCanvas::setSwapInterval()).
+  void setSwapInterval(int interval) { canvas->setSwapInterval(interval); }
+
 private:
   OutputGLCanvas* canvas;
 
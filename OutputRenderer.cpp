@@ -0,0 +1,157 @@
+/*
+ * OutputRenderer.cpp
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "OutputRenderer.h"
+
+#include <QOpenGLPaintDevice>
+#include <QDebug>
+
+namespace mmp {
+
+// Number of samples per pixel of the composition (same antialiasing as the views).
+static const int N_SAMPLES = 4;
+
+OutputRenderer::OutputRenderer(QGraphicsScene* scene, QGLWidget* widget)
+  : _scene(scene),
+    _widget(widget),
+    _multisampleFramebuffer(NULL),
+    _framebuffer(NULL),
+    _active(false),
+    _rendering(false)
+{
+}
+
+OutputRenderer::~OutputRenderer()
+{
+  // Framebuffers belong to the context of the widget.
+  _widget->makeCurrent();
+  delete _multisampleFramebuffer;
+  delete _framebuffer;
+}
+
+bool OutputRenderer::render(const QRectF& sceneRect, const QSize& size)
+{
+  _active = false;
+  if (size.isEmpty())
+    return false;
+
+  _widget->makeCurrent();
+  if (!_createFramebuffers(size))
+    return false;
+
+  // Render the scene (with the mappings painting themselves).
+  QOpenGLFramebufferObject* target = (_multisampleFramebuffer ? _multisampleFramebuffer : _framebuffer);
+  target->bind();
+  {
+    QOpenGLPaintDevice device(size);
+    QPainter painter(&device);
+    painter.setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform);
+    _rendering = true;
+    _scene->render(&painter, QRectF(QPointF(0, 0), size), sceneRect, Qt::IgnoreAspectRatio);
+    _rendering = false;
+  }
+  target->release();
+
+  // Resolve samples.
+  if (_multisampleFramebuffer)
+    QOpenGLFramebufferObject::blitFramebuffer(_framebuffer, _multisampleFramebuffer);
+
+  // Make the texture up to date for the contexts of the views.
+  glFlush();
+
+  _sceneRect = sceneRect;
+  _active = true;
+  return true;
+}
+
+void OutputRenderer::draw(QPainter* painter)
+{
+  if (!_active)
+    return;
+
+  painter->beginNativePainting();
+
+  glDisable(GL_BLEND);
+  glEnable(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, _framebuffer->texture());
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+
+  // Framebuffer rows go upwards.
+  glBegin(GL_QUADS);
+  {
+    glTexCoord2f(0, 1);
+    glVertex2f(_sceneRect.left(), _sceneRect.top());
+
+    glTexCoord2f(1, 1);
+    glVertex2f(_sceneRect.right(), _sceneRect.top());
+
+    glTexCoord2f(1, 0);
+    glVertex2f(_sceneRect.right(), _sceneRect.bottom());
+
+    glTexCoord2f(0, 0);
+    glVertex2f(_sceneRect.left(), _sceneRect.bottom());
+  }
+  glEnd();
+
+  glDisable(GL_TEXTURE_2D);
+
+  painter->endNativePainting();
+}
+
+bool OutputRenderer::_createFramebuffers(const QSize& size)
+{
+  bool resized = (!_framebuffer || _framebuffer->size() != size);
+
+  // Without multisampling edges of mappings would not be antialiased (if unsupported, only try
+  // again at another size).
+  if (QOpenGLFramebufferObject::hasOpenGLFramebufferBlit() &&
+      (_multisampleFramebuffer ? _multisampleFramebuffer->size() != size : resized))
+  {
+    delete _multisampleFramebuffer;
+    QOpenGLFramebufferObjectFormat format;
+    format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+    format.setSamples(N_SAMPLES);
+    _multisampleFramebuffer = new QOpenGLFramebufferObject(size, format);
+    if (!_multisampleFramebuffer->isValid())
+    {
+      delete _multisampleFramebuffer;
+      _multisampleFramebuffer = NULL;
+    }
+  }
+
+  // The painter needs a stencil buffer (eg. to fill paths) if it renders into this framebuffer.
+  QOpenGLFramebufferObject::Attachment attachment = (_multisampleFramebuffer ?
+                                                     QOpenGLFramebufferObject::NoAttachment :
+                                                     QOpenGLFramebufferObject::CombinedDepthStencil);
+  if (resized || _framebuffer->attachment() != attachment)
+  {
+    delete _framebuffer;
+    _framebuffer = new QOpenGLFramebufferObject(size, attachment);
+    if (!_framebuffer->isValid())
+    {
+      qWarning() << "Cannot create output framebuffer: views will render the output themselves." << endl;
+      delete _framebuffer;
+      _framebuffer = NULL;
+      return false;
+    }
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,85 @@
+/*
+ * OutputRenderer.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OUTPUT_RENDERER_H_
+#define OUTPUT_RENDERER_H_
+
+#include <QGLWidget>
+#include <QGraphicsScene>
+#include <QOpenGLFramebufferObject>
+#include <QPainter>
+
+namespace mmp {
+
+/**
+ * Renders the output scene once per frame into an offscreen framebuffer (at output resolution),
+ * which is then drawn by every view of the output instead of their own rendering of the
+ * mappings: the output window shows it as is, the destination canvas scaled under its controls.
+ *
+ * While a composition is available (see isActive()), graphics items of the output only paint
+ * themselves when rendered into the framebuffer (see isRendering()).
+ */
+class OutputRenderer
+{
+public:
+  /// Renders scene in the OpenGL context of widget (which must share its context with the views).
+  OutputRenderer(QGraphicsScene* scene, QGLWidget* widget);
+  ~OutputRenderer();
+
+  /**
+   * Renders the sceneRect region of the scene into a framebuffer of given size (in pixels).
+   * Returns false on failure (in which case views render the scene themselves).
+   */
+  bool render(const QRectF& sceneRect, const QSize& size);
+
+  /// Drops the composition (views render the scene themselves until next render()).
+  void clear() { _active = false; }
+
+  /// Returns true iff views should draw the composition rather than the mappings.
+  bool isActive() const { return _active; }
+
+  /// Region of the scene covered by the composition.
+  const QRectF& getSceneRect() const { return _sceneRect; }
+
+  /// Returns true iff the scene is currently being rendered into the framebuffer.
+  bool isRendering() const { return _rendering; }
+
+  /// Draws the composition where it belongs in the scene (painter being in scene coordinates).
+  void draw(QPainter* painter);
+
+private:
+  // (Re)creates framebuffers for given size if needed. Returns false on failure.
+  bool _createFramebuffers(const QSize& size);
+
+  QGraphicsScene* _scene;
+  QGLWidget* _widget;
+
+  // Rendering happens in the multisample framebuffer (if supported) which is then resolved in
+  // the framebuffer whose texture is drawn.
+  QOpenGLFramebufferObject* _multisampleFramebuffer;
+  QOpenGLFramebufferObject* _framebuffer;
+
+  // Region of the scene covered by the composition.
+  QRectF _sceneRect;
+
+  bool _active;
+  bool _rendering;
+};
+
+}
+
+#endif /* OUTPUT_RENDERER_H_ */
@@ -23,12 +23,30 @@
 #include "VideoUriDecodeBinImpl.h"
 #include "VideoV4l2SrcImpl.h"
 #include "VideoShmSrcImpl.h"
+#include "VideoTestSrcImpl.h"
+#include "FrameProvider.h"
 #include <iostream>
+#include <QtMath>
+#include <QtConcurrent>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// S3TC formats (from GL_EXT_texture_compression_s3tc).
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
 
 namespace mmp {
 
 UidAllocator Paint::allocator;
 
+bool Image::_defaultCompressed = MM::DEFAULT_COMPRESS_IMAGES;
+
 void Texture::update()
 {
   if (textureId == 0)
@@ -57,6 +75,46 @@ void Texture::write(QDomElement& obj)
   _writeNode(obj, "y", QString::number(getY()));
 }
 
+void Texture::setBrightness(float brightness)
+{
+  brightness = qBound(-1.0f, brightness, 1.0f);
+  if (brightness != _brightness)
+  {
+    _brightness = brightness;
+    _emitPropertyChanged("brightness");
+  }
+}
+
+void Texture::setContrast(float contrast)
+{
+  contrast = qBound(0.0f, contrast, 2.0f);
+  if (contrast != _contrast)
+  {
+    _contrast = contrast;
+    _emitPropertyChanged("contrast");
+  }
+}
+
+void Texture::setSaturation(float saturation)
+{
+  saturation = qBound(0.0f, saturation, 2.0f);
+  if (saturation != _saturation)
+  {
+    _saturation = saturation;
+    _emitPropertyChanged("saturation");
+  }
+}
+
+void Texture::setHue(float hue)
+{
+  hue = qBound(-1.0f, hue, 1.0f);
+  if (hue != _hue)
+  {
+    _hue = hue;
+    _emitPropertyChanged("hue");
+  }
+}
+
 Paint::Paint(uid id)
   : Element(id, &allocator),
     _isPlaying(false)
@@ -71,6 +129,8 @@ Paint::~Paint()
 Image::Image(int id)
   : Texture(id),
     _rate(0),
+    _compressed(_defaultCompressed),
+    _compressionPending(false),
     _currentFrame(0),
     _currentFrameReal(0.0),
     _prevTime(0),
@@ -82,6 +142,8 @@ Image::Image(int id)
 Image::Image(const QString uri_, uid id)
   : Texture(id),
     _rate(0),
+    _compressed(_defaultCompressed),
+    _compressionPending(false),
     _currentFrame(-1),
     _currentFrameReal(0.0),
     _prevTime(0),
@@ -102,23 +164,120 @@ bool Image::setUri(const QString &uri)
   return !_images.isEmpty();
 }
 
+/**
+ * Converts an image to RGBA bytes (the format expected by glTexImage2D() with GL_RGBA) in a
+ * single pass. Orientation is kept as is: this is equivalent to (but much faster than)
+ * QGLWidget::convertToGLFormat() followed by a horizontal mirror and a 180 degrees rotation,
+ * since the flips cancel each other.
+ */
+static QImage _convertToGLFormat(const QImage& image)
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+  // Common case: 0xAARRGGBB pixels, ie. B, G, R, A bytes. Swap red and blue channels.
+  if (image.format() == QImage::Format_ARGB32 || image.format() == QImage::Format_RGB32)
+  {
+    QImage converted(image.width(), image.height(), QImage::Format_RGBA8888);
+    if (converted.isNull())
+      return converted;
+
+    bool opaque = (image.format() == QImage::Format_RGB32);
+    for (int y=0; y<image.height(); y++)
+    {
+      const quint32* src = (const quint32*) image.constScanLine(y);
+      quint32* dst = (quint32*) converted.scanLine(y);
+      int x = 0;
+#if defined(__SSE2__)
+      const __m128i greenAlphaMask = _mm_set1_epi32(0xFF00FF00);
+      const __m128i alphaMask      = _mm_set1_epi32(opaque ? 0xFF000000 : 0);
+      const __m128i blueMask       = _mm_set1_epi32(0x000000FF);
+      for (; x + 4 <= image.width(); x += 4)
+      {
+        __m128i pixels = _mm_loadu_si128((const __m128i*) &src[x]);
+        __m128i result = _mm_or_si128(_mm_and_si128(pixels, greenAlphaMask), alphaMask);
+        result = _mm_or_si128(result, _mm_and_si128(_mm_srli_epi32(pixels, 16), blueMask));
+        result = _mm_or_si128(result, _mm_slli_epi32(_mm_and_si128(pixels, blueMask), 16));
+        _mm_storeu_si128((__m128i*) &dst[x], result);
+      }
+#endif
+      for (; x < image.width(); x++)
+      {
+        quint32 p = src[x];
+        dst[x] = (p & 0xFF00FF00) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16) | (opaque ? 0xFF000000 : 0);
+      }
+    }
+    return converted;
+  }
+#endif
+
+  // Other formats: let Qt convert directly.
+  return image.convertToFormat(QImage::Format_RGBA8888);
+}
+
 void Image::build()
 {
   // Read all images.
   QImageReader reader(_uri);
   _images.clear();
   for (int i=0; i<reader.imageCount(); i++)
-    _images.push_back(
-        QGLWidget::convertToGLFormat(reader.read())
-          .mirrored(true, false)
-          .transformed(QTransform().rotate(180))
-      );
+    _images.push_back(_convertToGLFormat(reader.read()));
 
   rewind();
+
+  // Previous compressed image is obsolete (as is any compression still running).
+  _compressedImage = CompressedImage();
+  _compressionPending = false;
+  _startCompression();
+}
+
+void Image::_startCompression()
+{
+  if (!_compressed || isAnimation() || _images.isEmpty() || !_compressedImage.isNull() || _compressionPending)
+    return;
+
+  // NOTE: QImage is implicitly shared: the worker gets its own reference to the pixels.
+  _compression = QtConcurrent::run(ImageCompressor::compressCached, _uri, _images[0]);
+  _compressionPending = true;
+}
+
+void Image::setCompressed(bool compressed)
+{
+  if (compressed != _compressed)
+  {
+    _compressed = compressed;
+    if (_compressed)
+      _startCompression();
+
+    // Upload again (compressed or not).
+    bitsChanged = true;
+    _emitPropertyChanged("compressed");
+  }
+}
+
+const uchar* Image::getCompressedBits(GLenum* internalFormat, int* size) const
+{
+  if (!_compressed || isAnimation() || _compressedImage.isNull())
+    return NULL;
+
+  *internalFormat = (_compressedImage.format == CompressedImage::BC1 ?
+                       GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+  *size = _compressedImage.data.size();
+  return (const uchar*) _compressedImage.data.constData();
 }
 
 void Image::update()
 {
+  // Switch to compressed image as soon as it is available.
+  if (_compressionPending && _compression.isFinished())
+  {
+    _compressionPending = false;
+    _compressedImage = _compression.result();
+    if (!_compressedImage.isNull() &&
+        _compressedImage.width == getWidth() && _compressedImage.height == getHeight())
+      bitsChanged = true;
+    else
+      _compressedImage = CompressedImage();
+  }
+
   if (isAnimation() && isPlaying())
   {
     // Compute the interval of time since last call to update().
@@ -158,6 +317,8 @@ void Image::rewind()
 }
 
 const uchar* Image::getBits() {
+  // Bits stay on the GPU until they change.
+  bitsChanged = false;
   return _bits;
 }
 
@@ -174,6 +335,15 @@ void Image::_doPlay()
 /* Implementation of the Video class */
 Video::Video(int id) : Texture(id),
     _uri(""),
+    _playlistIndex(-1),
+    _playlistItemStartLoop(0),
+    _playlistItemPlayed(0),
+    _nextImpl(NULL),
+    _nextIndex(-1),
+    _nextLoadingPending(false),
+    _nextScheduled(false),
+    _nextStartTime(0),
+    _cropToInputShapes(false),
     _impl(NULL)
 {
   _impl = new VideoUriDecodeBinImpl();
@@ -184,6 +354,15 @@ Video::Video(int id) : Texture(id),
 Video::Video(const QString uri_, VideoType type, double rate, uid id):
     Texture(id),
     _uri(""),
+    _playlistIndex(-1),
+    _playlistItemStartLoop(0),
+    _playlistItemPlayed(0),
+    _nextImpl(NULL),
+    _nextIndex(-1),
+    _nextLoadingPending(false),
+    _nextScheduled(false),
+    _nextStartTime(0),
+    _cropToInputShapes(false),
     _impl(NULL)
 {
   switch (type) {
@@ -196,6 +375,9 @@ Video::Video(const QString uri_, VideoType type, double rate, uid id):
     case VIDEO_SHMSRC:
       _impl = new VideoShmSrcImpl();
       break;
+    case VIDEO_TESTSRC:
+      _impl = new VideoTestSrcImpl();
+      break;
     default:
       fprintf (stderr, "Could not determine type for video source\n ");
       break;
@@ -206,10 +388,29 @@ Video::Video(const QString uri_, VideoType type, double rate, uid id):
   setUri(uri_);
 }
 
+Video::Video(VideoImpl* impl, uid id):
+    Texture(id),
+    _uri(""),
+    _playlistIndex(-1),
+    _playlistItemStartLoop(0),
+    _playlistItemPlayed(0),
+    _nextImpl(NULL),
+    _nextIndex(-1),
+    _nextLoadingPending(false),
+    _nextScheduled(false),
+    _nextStartTime(0),
+    _cropToInputShapes(false),
+    _impl(impl)
+{
+  setRate(1);
+  setVolume(1);
+}
+
 // vertigo
 
 Video::~Video()
 {
+  _discardNextPlaylistItem();
   delete _impl;
 }
 
@@ -256,11 +457,54 @@ bool Video::bitsHaveChanged() const
   return this->_impl->bitsHaveChanged();
 }
 
+QRect Video::getBitsRect() const
+{
+  return this->_impl->getBitsRect();
+}
+
+void Video::setCropToInputShapes(bool crop)
+{
+  if (crop != _cropToInputShapes)
+  {
+    _cropToInputShapes = crop;
+    _updateCrop();
+    _emitPropertyChanged("cropToInputShapes");
+  }
+}
+
+void Video::setInputShapesRegion(const QRectF& region)
+{
+  // Align region on grid (outwards) and clip it to the frame.
+  QRect aligned;
+  if (!region.isEmpty())
+  {
+    int left   = qFloor(region.left()   / CROP_ALIGNMENT) * CROP_ALIGNMENT;
+    int top    = qFloor(region.top()    / CROP_ALIGNMENT) * CROP_ALIGNMENT;
+    int right  = qCeil (region.right()  / CROP_ALIGNMENT) * CROP_ALIGNMENT;
+    int bottom = qCeil (region.bottom() / CROP_ALIGNMENT) * CROP_ALIGNMENT;
+    aligned = QRect(QPoint(left, top), QPoint(right - 1, bottom - 1)).intersected(QRect(0, 0, getWidth(), getHeight()));
+  }
+
+  // Only update if needed (this is called very often).
+  if (aligned != _inputShapesRegion)
+  {
+    _inputShapesRegion = aligned;
+    _updateCrop();
+  }
+}
+
+void Video::_updateCrop()
+{
+  _impl->setCropRect(_cropToInputShapes ? _inputShapesRegion : QRect());
+}
+
 void Video::setRate(double rate)
 {
   if (rate != _impl->getRate())
   {
     _impl->setRate(rate);
+    if (_nextImpl && !_nextLoadingPending)
+      _nextImpl->setRate(rate);
     _emitPropertyChanged("rate");
   }
 }
@@ -275,6 +519,8 @@ void Video::setVolume(double volume)
   if (volume != _impl->getVolume())
   {
     _impl->setVolume(volume);
+    if (_nextImpl && !_nextLoadingPending)
+      _nextImpl->setVolume(volume);
     _emitPropertyChanged("volume");
   }
 }
@@ -284,11 +530,157 @@ double Video::getVolume() const
   return _impl->getVolume();
 }
 
+void Video::setMaxFramesPerSecond(qreal fps)
+{
+  _impl->setMaxFramesPerSecond(fps);
+  if (_nextImpl && !_nextLoadingPending)
+    _nextImpl->setMaxFramesPerSecond(fps);
+}
+
+void Video::selectFrame(qreal displayDelay)
+{
+  if (_playlistIndex >= 0 && _playlist.size() > 1)
+    _updatePlaylist(displayDelay);
+  _impl->selectFrame(displayDelay);
+}
+
+quint64 Video::getRepeatedFrames() const
+{
+  return _impl->getRepeatedFrames();
+}
+
+quint64 Video::getSkippedFrames() const
+{
+  return _impl->getSkippedFrames();
+}
+
+qreal Video::getLateness() const
+{
+  return _impl->getLateness();
+}
+
 bool Video::hasVideoSupport()
 {
   return VideoImpl::hasVideoSupport();
 }
 
+void Video::setDefaultMaxFramesPerSecond(qreal fps)
+{
+  VideoImpl::setDefaultMaxFramesPerSecond(fps);
+}
+
+void Video::setDecoderThreads(int nThreads)
+{
+  if (nThreads != getDecoderThreads())
+  {
+    _impl->setDecoderThreads(nThreads);
+    _reloadMovie();
+    _emitPropertyChanged("decoderThreads");
+  }
+}
+
+int Video::getDecoderThreads() const
+{
+  return _impl->getDecoderThreads();
+}
+
+void Video::setConverterThreads(int nThreads)
+{
+  if (nThreads != getConverterThreads())
+  {
+    _impl->setConverterThreads(nThreads);
+    _reloadMovie();
+    _emitPropertyChanged("converterThreads");
+  }
+}
+
+int Video::getConverterThreads() const
+{
+  return _impl->getConverterThreads();
+}
+
+void Video::setThreadPriority(int priority)
+{
+  if (priority != getThreadPriority())
+  {
+    _impl->setThreadPriority(priority);
+    _reloadMovie();
+    _emitPropertyChanged("threadPriority");
+  }
+}
+
+int Video::getThreadPriority() const
+{
+  return _impl->getThreadPriority();
+}
+
+void Video::setCpuSet(const QString& cpuSet)
+{
+  if (cpuSet.trimmed() != getCpuSet())
+  {
+    _impl->setCpuSet(cpuSet);
+    _reloadMovie();
+    _emitPropertyChanged("cpuSet");
+  }
+}
+
+QString Video::getCpuSet() const
+{
+  return _impl->getCpuSet();
+}
+
+void Video::setAudioAnalysis(bool enabled)
+{
+  if (enabled != hasAudioAnalysis())
+  {
+    _impl->setAudioAnalysis(enabled);
+    _reloadMovie();
+    _emitPropertyChanged("audioAnalysis");
+  }
+}
+
+bool Video::hasAudioAnalysis() const
+{
+  return _impl->hasAudioAnalysis();
+}
+
+const AudioAnalysis* Video::getAudioAnalysis() const
+{
+  return _impl->getAudioAnalysis();
+}
+
+void Video::setDefaultThreading(int decoderThreads, int converterThreads, int threadPriority, const QString& cpuSet)
+{
+  VideoImpl::setDefaultDecoderThreads(decoderThreads);
+  VideoImpl::setDefaultConverterThreads(converterThreads);
+  VideoImpl::setDefaultThreadPriority(threadPriority);
+  VideoImpl::setDefaultCpuSet(cpuSet);
+}
+
+void Video::_reloadMovie()
+{
+  // Nothing to reload.
+  if (_uri.isEmpty())
+    return;
+
+  // Next playlist item will be prerolled again with new settings.
+  _discardNextPlaylistItem();
+
+  if (!_impl->loadMovie(_uri))
+  {
+    qDebug() << "Cannot reload movie " << _uri << "." << endl;
+    return;
+  }
+
+  // Restore play state (rate and volume are kept by the implementation).
+  _impl->setPlayState(isPlaying());
+
+  // Crop region will be recomputed.
+  _inputShapesRegion = QRect();
+
+  _startPlaylistItem();
+}
+
 bool Video::setUri(const QString &uri)
 {
   // Check if we're actually changing the uri.
@@ -304,6 +696,14 @@ bool Video::setUri(const QString &uri)
     // Set uri.
     _uri = uri;
 
+    // Crop region will be recomputed for new movie.
+    _inputShapesRegion = QRect();
+
+    // Continue playlist from that media (if it is part of it).
+    _discardNextPlaylistItem();
+    _playlistIndex = (_impl->isLive() ? -1 : _playlist.indexOf(uri));
+    _startPlaylistItem();
+
     // Try to get thumbnail.
     // Wait for the first samples to be available to make sure we are ready.
     if (!_impl->waitForNextBits(1000))
@@ -325,19 +725,234 @@ bool Video::setUri(const QString &uri)
 void Video::_doPlay()
 {
   _impl->setPlayState(true);
+  if (!_playlistItemTimer.isValid())
+    _playlistItemTimer.start();
 }
 
 void Video::_doPause()
 {
   _impl->setPlayState(false);
+
+  // Keep next item prerolled: it is scheduled again when playback resumes.
+  if (_nextScheduled)
+  {
+    _nextImpl->setPlayState(false);
+    _nextImpl->seekTo((guint64)0);
+    _nextScheduled = false;
+  }
+  if (_playlistItemTimer.isValid())
+    _playlistItemPlayed += _playlistItemTimer.nsecsElapsed();
+  _playlistItemTimer.invalidate();
 }
 
-bool Video::_generateThumbnail()
+bool Video::setPlaylist(const QString& playlist)
+{
+  Playlist newPlaylist;
+  if (!newPlaylist.parse(playlist))
+    return false;
+
+  if (newPlaylist.toString() != _playlist.toString())
+  {
+    _discardNextPlaylistItem();
+    _playlist = newPlaylist;
+
+    if (_playlist.isEmpty() || _impl->isLive())
+      _playlistIndex = -1;
+    else
+    {
+      // Keep playing current media if it is part of the playlist.
+      _playlistIndex = _playlist.indexOf(_uri);
+      if (_playlistIndex < 0 && !setUri(_playlist.item(0).uri))
+        qDebug() << "Cannot load first item of playlist." << endl;
+    }
+    _startPlaylistItem();
+
+    _emitPropertyChanged("playlist");
+  }
+
+  return true;
+}
+
+qint64 Video::_playlistItemElapsed() const
+{
+  return _playlistItemPlayed + (_playlistItemTimer.isValid() ? _playlistItemTimer.nsecsElapsed() : 0);
+}
+
+void Video::_startPlaylistItem()
+{
+  _playlistItemStartLoop = _impl->getLoopCount();
+  _playlistItemPlayed = 0;
+  if (isPlaying())
+    _playlistItemTimer.start();
+  else
+    _playlistItemTimer.invalidate();
+
+  // Items played once do not loop back (the next item starts when the last frame ends).
+  bool looping = true;
+  if (_playlistIndex >= 0 && _playlist.size() > 1)
+  {
+    const PlaylistItem& item = _playlist.item(_playlistIndex);
+    looping = (item.hasDuration() || item.loops > 1);
+  }
+  _impl->setLooping(looping);
+}
+
+void Video::_copySettings(VideoImpl* impl) const
+{
+  impl->setDecoderThreads(_impl->getDecoderThreads());
+  impl->setConverterThreads(_impl->getConverterThreads());
+  impl->setThreadPriority(_impl->getThreadPriority());
+  impl->setCpuSet(_impl->getCpuSet());
+  impl->setAudioAnalysis(_impl->hasAudioAnalysis());
+  impl->setMaxFramesPerSecond(_impl->getMaxFramesPerSecond());
+  impl->setRate(_impl->getRate());
+  impl->setVolume(_impl->getVolume());
+}
+
+// Loads a movie and pauses it right away so that it prerolls without playing.
+static bool _loadVideoImplPaused(VideoImpl* impl, QString uri)
+{
+  return impl->loadMovie(uri) && impl->setPlayState(false);
+}
+
+void Video::_updatePlaylist(qreal displayDelay)
+{
+  if (!isPlaying())
+    return;
+
+  const PlaylistItem& item = _playlist.item(_playlistIndex);
+
+  // Last loop of the item: play it through without looping back.
+  if (!item.hasDuration() && _impl->getLoopCount() - _playlistItemStartLoop >= item.loops - 1)
+    _impl->setLooping(false);
+
+  // Start prerolling the next item (loading runs in the background).
+  if (!_nextImpl)
+  {
+    if (_nextIndex < 0)
+      _nextIndex = _playlist.next(_playlistIndex);
+    _nextImpl = _impl->newInstance();
+    _copySettings(_nextImpl);
+    _nextLoading = QtConcurrent::run(_loadVideoImplPaused, _nextImpl, _playlist.item(_nextIndex).uri);
+    _nextLoadingPending = true;
+    return;
+  }
+
+  // Loading done.
+  if (_nextLoadingPending)
+  {
+    if (!_nextLoading.isFinished())
+      return;
+
+    _nextLoadingPending = false;
+    if (!_nextLoading.result())
+    {
+      qWarning() << "Cannot load playlist item " << _playlist.item(_nextIndex).uri << ": skipping it." << endl;
+      delete _nextImpl;
+      _nextImpl = NULL;
+
+      // Try following item (keep looping current media if there is none).
+      _nextIndex = _playlist.next(_nextIndex);
+      if (_nextIndex == _playlistIndex)
+      {
+        _playlistIndex = _nextIndex = -1;
+        _impl->setLooping(true);
+      }
+      return;
+    }
+    _copySettings(_nextImpl);
+  }
+
+  // Process messages of the next pipeline (eg. to know when it is prerolled).
+  _nextImpl->update();
+
+  // Schedule the next item to start exactly when the current one ends.
+  if (!_nextScheduled)
+  {
+    qint64 remaining = -1;
+    if (item.hasDuration())
+      remaining = qMax((qint64)(item.duration * 1e9) - _playlistItemElapsed(), (qint64)0);
+    else if (!_impl->isLooping())
+      remaining = _impl->getRemainingTime();
+
+    if (remaining >= 0 && remaining <= PLAYLIST_SCHEDULE_AHEAD * 1000000LL && _nextImpl->isReady())
+    {
+      if (_nextImpl->playIn(remaining))
+      {
+        _nextScheduled = true;
+        _nextStartTime = _playlistItemElapsed() + remaining;
+      }
+    }
+  }
+
+  // Switch when the image being rendered is displayed after the start of the next item.
+  if (_nextScheduled && _playlistItemElapsed() + (qint64)(displayDelay * 1e9) >= _nextStartTime)
+    _switchToNextPlaylistItem();
+}
+
+// Frees an implementation (stopping a pipeline can take a while).
+static void _deleteVideoImpl(VideoImpl* impl)
+{
+  delete impl;
+}
+
+// Frees an implementation once it is done loading.
+static void _deleteVideoImplWhenLoaded(VideoImpl* impl, QFuture<bool> loading)
+{
+  loading.waitForFinished();
+  delete impl;
+}
+
+void Video::_switchToNextPlaylistItem()
+{
+  VideoImpl* previous = _impl;
+
+  _impl = _nextImpl;
+  _playlistIndex = _nextIndex;
+  _uri = _playlist.item(_playlistIndex).uri;
+  _nextImpl = NULL;
+  _nextIndex = -1;
+  _nextScheduled = false;
+
+  // Crop region will be recomputed for new movie.
+  _inputShapesRegion = QRect();
+
+  _startPlaylistItem();
+
+  QtConcurrent::run(_deleteVideoImpl, previous);
+
+  // Thumbnail would require seeking the playing movie: use generic icon.
+  _setDefaultIcon();
+
+  _emitPropertyChanged("uri");
+}
+
+void Video::_discardNextPlaylistItem()
+{
+  // Freed in the background so as not to block on loading or stopping the pipeline.
+  if (_nextImpl)
+  {
+    if (_nextLoadingPending)
+      QtConcurrent::run(_deleteVideoImplWhenLoaded, _nextImpl, _nextLoading);
+    else
+      QtConcurrent::run(_deleteVideoImpl, _nextImpl);
+  }
+  _nextImpl = NULL;
+  _nextIndex = -1;
+  _nextLoadingPending = false;
+  _nextScheduled = false;
+}
+
+void Video::_setDefaultIcon()
 {
   static QFileIconProvider provider;
+  _icon = provider.icon(QFileInfo(_uri));
+}
 
+bool Video::_generateThumbnail()
+{
   // Default (in case seeking and loading don't work).
-  _icon = provider.icon(QFileInfo(_uri));
+  _setDefaultIcon();
 
   // Try seeking to the middle of the movie.
   if (!_impl->seekTo(0.5))
@@ -356,9 +971,10 @@ bool Video::_generateThumbnail()
   }
 
   // Copy bits into thumbnail QImage.
-  QImage thumbnail(getWidth(), getHeight(), QImage::Format_ARGB32);
-  for (int y=0; y<getHeight(); y++)
-    for (int x=0; x<getWidth(); x++)
+  QRect bitsRect = getBitsRect();
+  QImage thumbnail(bitsRect.width(), bitsRect.height(), QImage::Format_ARGB32);
+  for (int y=0; y<bitsRect.height(); y++)
+    for (int x=0; x<bitsRect.width(); x++)
     {
       // Transfer RGBA to ARGB.
       uint r = *bits++;
@@ -378,4 +994,256 @@ bool Video::_generateThumbnail()
   return true;
 }
 
+/* Implementation of the TestSource class */
+TestSource::TestSource(int id) : Video(new VideoTestSrcImpl(), id)
+{
+}
+
+TestSource::TestSource(const QString& pattern, int width, int height, int framesPerSecond, const QString& encoder, uid id) :
+  Video(new VideoTestSrcImpl(), id)
+{
+  setUri(VideoTestSrcImpl::makeUri(pattern, width, height, framesPerSecond, encoder));
+}
+
+void TestSource::_getSettings(QString* pattern, int* width, int* height, int* fps, QString* encoder) const
+{
+  // Defaults are used for an empty (or invalid) uri.
+  if (!VideoTestSrcImpl::parseUri(getUri(), pattern, width, height, fps, encoder))
+    VideoTestSrcImpl::parseUri(VideoTestSrcImpl::URI_SCHEME + "://", pattern, width, height, fps, encoder);
+}
+
+void TestSource::_setSettings(const QString& pattern, int width, int height, int fps, const QString& encoder,
+                              const char* changedProperty)
+{
+  QString uri = VideoTestSrcImpl::makeUri(pattern, width, height, fps, encoder);
+  if (uri != getUri() && setUri(uri))
+    _emitPropertyChanged(changedProperty);
+}
+
+QString TestSource::getPattern() const
+{
+  QString pattern, encoder;
+  int width, height, fps;
+  _getSettings(&pattern, &width, &height, &fps, &encoder);
+  return pattern;
+}
+
+void TestSource::setPattern(const QString& pattern)
+{
+  QString oldPattern, encoder;
+  int width, height, fps;
+  _getSettings(&oldPattern, &width, &height, &fps, &encoder);
+  _setSettings(pattern, width, height, fps, encoder, "pattern");
+}
+
+int TestSource::getSourceWidth() const
+{
+  QString pattern, encoder;
+  int width, height, fps;
+  _getSettings(&pattern, &width, &height, &fps, &encoder);
+  return width;
+}
+
+void TestSource::setSourceWidth(int width)
+{
+  QString pattern, encoder;
+  int oldWidth, height, fps;
+  _getSettings(&pattern, &oldWidth, &height, &fps, &encoder);
+  _setSettings(pattern, width, height, fps, encoder, "sourceWidth");
+}
+
+int TestSource::getSourceHeight() const
+{
+  QString pattern, encoder;
+  int width, height, fps;
+  _getSettings(&pattern, &width, &height, &fps, &encoder);
+  return height;
+}
+
+void TestSource::setSourceHeight(int height)
+{
+  QString pattern, encoder;
+  int width, oldHeight, fps;
+  _getSettings(&pattern, &width, &oldHeight, &fps, &encoder);
+  _setSettings(pattern, width, height, fps, encoder, "sourceHeight");
+}
+
+int TestSource::getFramesPerSecond() const
+{
+  QString pattern, encoder;
+  int width, height, fps;
+  _getSettings(&pattern, &width, &height, &fps, &encoder);
+  return fps;
+}
+
+void TestSource::setFramesPerSecond(int fps)
+{
+  QString pattern, encoder;
+  int width, height, oldFps;
+  _getSettings(&pattern, &width, &height, &oldFps, &encoder);
+  _setSettings(pattern, width, height, fps, encoder, "framesPerSecond");
+}
+
+QString TestSource::getEncoder() const
+{
+  QString pattern, encoder;
+  int width, height, fps;
+  _getSettings(&pattern, &width, &height, &fps, &encoder);
+  return encoder;
+}
+
+void TestSource::setEncoder(const QString& encoder)
+{
+  QString pattern, oldEncoder;
+  int width, height, fps;
+  _getSettings(&pattern, &width, &height, &fps, &oldEncoder);
+  _setSettings(pattern, width, height, fps, encoder, "encoder");
+}
+
+QString TestSource::getDescription() const
+{
+  QString pattern, encoder;
+  int width, height, fps;
+  _getSettings(&pattern, &width, &height, &fps, &encoder);
+  return QString("%1 %2x%3@%4 %5").arg(pattern).arg(width).arg(height).arg(fps)
+      .arg(encoder.isEmpty() ? QString("raw") : encoder);
+}
+
+QStringList TestSource::patterns()
+{
+  return VideoTestSrcImpl::patterns();
+}
+
+QStringList TestSource::encoders()
+{
+  return VideoTestSrcImpl::encoders();
+}
+
+/* Implementation of the PluginSource class */
+#if defined(Q_OS_WIN)
+const QString PluginSource::PLUGIN_FILES_FILTER = "*.dll";
+#elif defined(Q_OS_MAC)
+const QString PluginSource::PLUGIN_FILES_FILTER = "*.dylib *.so";
+#else
+const QString PluginSource::PLUGIN_FILES_FILTER = "*.so";
+#endif
+
+PluginSource::PluginSource(int id) : Texture(id),
+  _uri(""),
+  _config(""),
+  _provider(new FrameProvider())
+{
+}
+
+PluginSource::PluginSource(const QString& uri_, const QString& config, uid id) : Texture(id),
+  _uri(""),
+  _config(config),
+  _provider(new FrameProvider())
+{
+  setUri(uri_);
+}
+
+PluginSource::~PluginSource()
+{
+  delete _provider;
+}
+
+bool PluginSource::setUri(const QString& uri)
+{
+  if (uri != _uri)
+  {
+    if (!_load(uri, _config))
+      return false;
+
+    _uri = uri;
+    _emitPropertyChanged("uri");
+  }
+
+  return true;
+}
+
+bool PluginSource::setConfig(const QString& config)
+{
+  if (config != _config)
+  {
+    // Reload plugin with new configuration (keep previous one if it fails).
+    if (!_uri.isEmpty() && !_load(_uri, config))
+      return false;
+
+    _config = config;
+    _emitPropertyChanged("config");
+  }
+
+  return true;
+}
+
+bool PluginSource::_load(const QString& uri, const QString& config)
+{
+  // Load into a new provider so that the running plugin is kept if loading fails.
+  FrameProvider* provider = new FrameProvider();
+  if (!provider->load(uri, config))
+  {
+    delete provider;
+    return false;
+  }
+
+  provider->setPlaying(isPlaying());
+  delete _provider;
+  _provider = provider;
+  bitsChanged = true;
+  return true;
+}
+
+QString PluginSource::getProviderName() const
+{
+  return _provider->getName();
+}
+
+void PluginSource::rewind()
+{
+  _provider->rewind();
+}
+
+void PluginSource::lockMutex()
+{
+  _provider->lockMutex();
+}
+
+void PluginSource::unlockMutex()
+{
+  _provider->unlockMutex();
+}
+
+int PluginSource::getWidth() const
+{
+  return _provider->getWidth();
+}
+
+int PluginSource::getHeight() const
+{
+  return _provider->getHeight();
+}
+
+const uchar* PluginSource::getBits()
+{
+  bitsChanged = false;
+  return _provider->getBits();
+}
+
+bool PluginSource::bitsHaveChanged() const
+{
+  // First frame needs to be uploaded even if the plugin has not produced anything yet.
+  return bitsChanged || _provider->bitsHaveChanged();
+}
+
+void PluginSource::_doPlay()
+{
+  _provider->setPlaying(true);
+}
+
+void PluginSource::_doPause()
+{
+  _provider->setPlaying(false);
+}
+
 }
@@ -37,13 +37,19 @@
 
 #include "Element.h"
 #include "Maths.h"
+#include "ImageCompressor.h"
+#include "Playlist.h"
+
+#include <QFuture>
+#include <QElapsedTimer>
 
 namespace mmp {
 
 typedef enum {
   VIDEO_URI,
   VIDEO_WEBCAM,
-  VIDEO_SHMSRC
+  VIDEO_SHMSRC,
+  VIDEO_TESTSRC
 } VideoType;
 
 /**
@@ -146,17 +152,32 @@ class Texture : public Paint
   Q_PROPERTY(float x READ getX)
   Q_PROPERTY(float y READ getY)
 
+  // Color correction (same ranges and defaults as GStreamer's videobalance).
+  Q_PROPERTY(float brightness READ getBrightness WRITE setBrightness)
+  Q_PROPERTY(float contrast   READ getContrast   WRITE setContrast)
+  Q_PROPERTY(float saturation READ getSaturation WRITE setSaturation)
+  Q_PROPERTY(float hue        READ getHue        WRITE setHue)
+
 protected:
   GLuint textureId;
   GLfloat x;
   GLfloat y;
   mutable bool bitsChanged;
 
+  float _brightness;
+  float _contrast;
+  float _saturation;
+  float _hue;
+
   Texture(uid id=NULL_UID) :
     Paint(id),
     textureId(0),
     x(0),
-    y(0)
+    y(0),
+    _brightness(0),
+    _contrast(1),
+    _saturation(1),
+    _hue(0)
   {
   }
 
@@ -181,6 +202,23 @@ public:
   /// Returns true iff bits have changed since last call to getBits().
   virtual bool bitsHaveChanged() const = 0;
 
+  /**
+   * Returns the region of the texture (relative to its position) covered by the bits
+   * returned by the last call to getBits(). Default: the whole texture.
+   */
+  virtual QRect getBitsRect() const { return QRect(0, 0, getWidth(), getHeight()); }
+
+  /**
+   * Returns a block-compressed version of the bits returned by the last call to getBits(), along
+   * with its OpenGL internal format and its size (in bytes), or NULL if there is none (default).
+   */
+  virtual const uchar* getCompressedBits(GLenum* internalFormat, int* size) const
+  {
+    Q_UNUSED(internalFormat);
+    Q_UNUSED(size);
+    return NULL;
+  }
+
   virtual GLfloat getX() const { return x; }
   virtual GLfloat getY() const { return y; }
 
@@ -199,6 +237,29 @@ public:
 
   virtual QRectF getRect() const { return QRectF(getX(), getY(), getWidth(), getHeight()); }
 
+  /**
+   * Color correction, applied when the texture is drawn (in the fragment shader) so that
+   * changing it costs nothing per frame.
+   */
+  /// Brightness offset, from -1 to 1 (default 0).
+  void setBrightness(float brightness);
+  float getBrightness() const { return _brightness; }
+
+  /// Contrast, from 0 to 2 (default 1).
+  void setContrast(float contrast);
+  float getContrast() const { return _contrast; }
+
+  /// Saturation, from 0 to 2 (default 1).
+  void setSaturation(float saturation);
+  float getSaturation() const { return _saturation; }
+
+  /// Hue rotation, from -1 to 1 (ie. -180 to 180 degrees, default 0).
+  void setHue(float hue);
+  float getHue() const { return _hue; }
+
+  /// Returns true iff color correction changes the colors of the texture.
+  bool hasColorCorrection() const { return _brightness != 0 || _contrast != 1 || _saturation != 1 || _hue != 0; }
+
   virtual void read(const QDomElement& obj);
   virtual void write(QDomElement& obj);
 
@@ -214,6 +275,9 @@ class Image : public Texture
 {
   Q_OBJECT
 
+  // NOTE: Compression is declared before the uri so that it is known when the image is loaded.
+  Q_PROPERTY(bool compressed READ isCompressed WRITE setCompressed)
+
   Q_PROPERTY(QString uri READ getUri WRITE setUri)
 
   Q_PROPERTY(double rate READ getRate WRITE setRate)
@@ -223,6 +287,13 @@ protected:
   QVector<QImage> _images;
   double _rate;
 
+  bool _compressed;
+  CompressedImage _compressedImage;
+  QFuture<CompressedImage> _compression;
+  bool _compressionPending;
+
+  static bool _defaultCompressed;
+
   uint  _currentFrame;
   qreal _currentFrameReal;
   qreal _prevTime;
@@ -257,6 +328,19 @@ public:
 
   virtual bool bitsHaveChanged() const { return bitsChanged; }
 
+  virtual const uchar* getCompressedBits(GLenum* internalFormat, int* size) const;
+
+  /**
+   * Enables/disables block compression (BC1/BC3) of the image on the GPU. Compression happens
+   * in the background (the uncompressed image is used until it is done). Animations are never compressed.
+   */
+  void setCompressed(bool compressed);
+  bool isCompressed() const { return _compressed; }
+
+  /// Sets whether images created from now on are compressed.
+  static void setDefaultCompressed(bool compressed) { _defaultCompressed = compressed; }
+  static bool getDefaultCompressed() { return _defaultCompressed; }
+
   virtual QIcon getIcon() const
   {
     return QIcon(QPixmap::fromImage(_images[0]).scaled(MM::MAPPING_LIST_ICON_SIZE, MM::MAPPING_LIST_ICON_SIZE,
@@ -276,9 +360,14 @@ protected:
 
   /// Current elapsed time in seconds.
   qreal _elapsedTime() const { return _timer.elapsed() / 1000.0; }
+
+  /// Starts compressing the image in the background (if needed).
+  void _startCompression();
 };
 
 class VideoImpl; // forward declaration
+class FrameProvider; // forward declaration
+class AudioAnalysis; // forward declaration
 
 /**
  * Paint that is a Texture retrieved via a video file.
@@ -287,15 +376,30 @@ class Video : public Texture
 {
   Q_OBJECT
 
+  // NOTE: Threading properties are declared before the uri so that they are read before the movie is loaded.
+  Q_PROPERTY(int decoderThreads READ getDecoderThreads WRITE setDecoderThreads)
+  Q_PROPERTY(int converterThreads READ getConverterThreads WRITE setConverterThreads)
+  Q_PROPERTY(int threadPriority READ getThreadPriority WRITE setThreadPriority)
+  Q_PROPERTY(QString cpuSet READ getCpuSet WRITE setCpuSet)
+  Q_PROPERTY(bool audioAnalysis READ hasAudioAnalysis WRITE setAudioAnalysis)
+
   Q_PROPERTY(QString uri READ getUri WRITE setUri)
+  Q_PROPERTY(QString playlist READ getPlaylist WRITE setPlaylist)
 
   Q_PROPERTY(double volume READ getVolume WRITE setVolume)
   Q_PROPERTY(double rate READ getRate WRITE setRate)
+  Q_PROPERTY(bool cropToInputShapes READ isCropToInputShapes WRITE setCropToInputShapes)
 
 public:
   // Thumbnail generation timeout (in ms).
   static const int ICON_TIMEOUT = 1000;
 
+  // How long before the end of a playlist item the next one is scheduled (in ms).
+  static const int PLAYLIST_SCHEDULE_AHEAD = 500;
+
+  // Crop regions are aligned on a grid of that many pixels to limit renegotiations while editing.
+  static const int CROP_ALIGNMENT = 16;
+
 public:
   Q_INVOKABLE Video(int id=NULL_UID);
   Video(const QString uri_, VideoType type, double rate, uid id=NULL_UID);
@@ -304,6 +408,18 @@ public:
   const QString getUri() const { return _uri; }
   bool setUri(const QString &uri);
 
+  /**
+   * Sets the playlist (see Playlist for syntax). Media are played one after the other, the next
+   * one being prerolled while the current one plays so that it starts exactly when the current
+   * one ends. An empty playlist plays the uri in a loop. Setting an uri that is not part of the
+   * playlist stops it. Playlists are ignored by live sources.
+   */
+  bool setPlaylist(const QString& playlist);
+  QString getPlaylist() const { return _playlist.toString(); }
+
+  /// Index of the playlist item playing (-1 if not playing a playlist).
+  int getPlaylistIndex() const { return _playlistIndex; }
+
   virtual void build();
   virtual void update();
 
@@ -325,26 +441,84 @@ public:
 
   virtual bool bitsHaveChanged() const;
 
+  virtual QRect getBitsRect() const;
+
   /// Sets playback rate (in %). Negative values mean reverse playback.
   virtual void setRate(double rate);
 
   /// Returns playback rate.
   double getRate() const;
 
+  /// Enables/disables cropping of frames at decoding time to the region used by input shapes.
+  virtual void setCropToInputShapes(bool crop);
+
+  /// Returns true iff frames are cropped to the region used by input shapes.
+  bool isCropToInputShapes() const { return _cropToInputShapes; }
+
+  /**
+   * Sets the region of the video (in texture coordinates ie. relative to its position) that is
+   * used by input shapes. Only has effect if isCropToInputShapes() is true.
+   */
+  void setInputShapesRegion(const QRectF& region);
+
   /// Sets audio playback volume (in %).
   virtual void setVolume(double volume);
 
   /// Returns audio playback volume.
   double getVolume() const;
 
+  /// Sets the maximum number of frames per second decoded frames are converted at (should match render rate).
+  virtual void setMaxFramesPerSecond(qreal fps);
+
+  /// Picks the frame to show in the image that will be displayed in displayDelay seconds.
+  virtual void selectFrame(qreal displayDelay);
+
+  /// Number of rendered images that repeated the previous frame / of frames never displayed.
+  quint64 getRepeatedFrames() const;
+  quint64 getSkippedFrames() const;
+
+  /// How late (in seconds) the frame shown is (skew to the shared timeline when synchronized).
+  qreal getLateness() const;
+
+  /// Sets the number of decoding threads (0 = default). Reloads the movie.
+  virtual void setDecoderThreads(int nThreads);
+  int getDecoderThreads() const;
+
+  /// Sets the number of colorspace conversion threads (0 = default). Reloads the movie.
+  virtual void setConverterThreads(int nThreads);
+  int getConverterThreads() const;
+
+  /// Sets the priority of streaming threads (-2 to 2, 0 = default). Reloads the movie.
+  virtual void setThreadPriority(int priority);
+  int getThreadPriority() const;
+
+  /// Sets the CPUs streaming threads are pinned to (eg. "0-3", "auto", "none", empty = default). Reloads the movie.
+  virtual void setCpuSet(const QString& cpuSet);
+  QString getCpuSet() const;
+
+  /// Enables/disables the analysis of the audio, used as a modulation source (see Modulation). Reloads the movie.
+  virtual void setAudioAnalysis(bool enabled);
+  bool hasAudioAnalysis() const;
+
+  /// Analysis of the audio heard (NULL if not analyzed or if the movie has no audio).
+  const AudioAnalysis* getAudioAnalysis() const;
+
   /**
    * Checks whether or not video is supported on this platform.
    */
   static bool hasVideoSupport();
 
+  /// Sets the maximum number of frames per second for videos created from now on.
+  static void setDefaultMaxFramesPerSecond(qreal fps);
+
+  /// Sets the default threading settings for videos loaded from now on (see VideoImpl).
+  static void setDefaultThreading(int decoderThreads, int converterThreads, int threadPriority, const QString& cpuSet);
+
   virtual QIcon getIcon() const { return _icon; }
 
 protected:
+  // Constructor for subclasses that use a specific implementation (takes ownership of impl).
+  Video(VideoImpl* impl, uid id);
 
   /// Starts playback.
   virtual void _doPlay();
@@ -355,9 +529,54 @@ protected:
   // Try to generate a thumbnail from currently loaded movie.
   bool _generateThumbnail();
 
+  // Uses the generic icon of the file type.
+  void _setDefaultIcon();
+
+  // Sends appropriate crop region to implementation.
+  void _updateCrop();
+
+  // Reloads the current movie (eg. to apply new threading settings).
+  void _reloadMovie();
+
+  // Starts the current playlist item.
+  void _startPlaylistItem();
+
+  // Prerolls, schedules and switches to the next playlist item (called once per rendered frame).
+  void _updatePlaylist(qreal displayDelay);
+
+  // Makes the prerolled playlist item the current one.
+  void _switchToNextPlaylistItem();
+
+  // Frees the prerolled playlist item (if any) in the background.
+  void _discardNextPlaylistItem();
+
+  // Copies playback settings to another implementation.
+  void _copySettings(VideoImpl* impl) const;
+
+  // Time the current playlist item has been playing (in nanoseconds).
+  qint64 _playlistItemElapsed() const;
+
   QString _uri;
   QIcon _icon;
 
+  /// Playlist.
+  Playlist _playlist;
+  int _playlistIndex;
+  int _playlistItemStartLoop;   // loop count of implementation when current item started
+  qint64 _playlistItemPlayed;   // playing time of current item before last pause (in ns)
+  QElapsedTimer _playlistItemTimer;
+
+  /// Next playlist item (prerolled in a second pipeline).
+  VideoImpl* _nextImpl;
+  int _nextIndex;
+  QFuture<bool> _nextLoading;
+  bool _nextLoadingPending;
+  bool _nextScheduled;
+  qint64 _nextStartTime;        // time at which next item starts (same reference as _playlistItemElapsed())
+
+  bool _cropToInputShapes;
+  QRect _inputShapesRegion;
+
   /**
    * Private implementation, so that GStreamer headers don't need
    * to be included from every file in the project.
@@ -365,6 +584,121 @@ protected:
   VideoImpl *_impl;
 };
 
+/**
+ * Paint that generates synthetic video (test patterns) instead of reading a file.
+ * Frames can optionally go through an encoder and a decoder so that it generates a
+ * deterministic decoding load, which is useful to benchmark a setup without media files.
+ * All settings are stored in the uri (see VideoTestSrcImpl).
+ */
+class TestSource : public Video
+{
+  Q_OBJECT
+
+  Q_PROPERTY(QString pattern READ getPattern WRITE setPattern STORED false)
+  Q_PROPERTY(int sourceWidth READ getSourceWidth WRITE setSourceWidth STORED false)
+  Q_PROPERTY(int sourceHeight READ getSourceHeight WRITE setSourceHeight STORED false)
+  Q_PROPERTY(int framesPerSecond READ getFramesPerSecond WRITE setFramesPerSecond STORED false)
+  Q_PROPERTY(QString encoder READ getEncoder WRITE setEncoder STORED false)
+
+public:
+  Q_INVOKABLE TestSource(int id=NULL_UID);
+  TestSource(const QString& pattern, int width, int height, int framesPerSecond, const QString& encoder, uid id=NULL_UID);
+  virtual ~TestSource() {}
+
+  /// Test pattern (eg. "smpte", "snow", "ball").
+  QString getPattern() const;
+  void setPattern(const QString& pattern);
+
+  /// Size of generated frames.
+  int getSourceWidth() const;
+  void setSourceWidth(int width);
+  int getSourceHeight() const;
+  void setSourceHeight(int height);
+
+  /// Rate at which frames are generated.
+  int getFramesPerSecond() const;
+  void setFramesPerSecond(int fps);
+
+  /// Codec used for the encode/decode round-trip ("h264", "vp8", "mjpeg" or "" for raw frames).
+  QString getEncoder() const;
+  void setEncoder(const QString& encoder);
+
+  /// Short human-readable description of the settings (eg. "smpte 1920x1080@30 h264").
+  QString getDescription() const;
+
+  /// Names of available patterns and encoders.
+  static QStringList patterns();
+  static QStringList encoders();
+
+private:
+  // Parses current uri.
+  void _getSettings(QString* pattern, int* width, int* height, int* fps, QString* encoder) const;
+
+  // Changes settings (reloads the source if needed).
+  void _setSettings(const QString& pattern, int width, int height, int fps, const QString& encoder,
+                    const char* changedProperty);
+};
+
+/**
+ * Paint that is a Texture generated by a frame provider plugin (see FrameProviderPlugin.h).
+ * The plugin renders directly into the buffers that get uploaded, from a worker thread.
+ */
+class PluginSource : public Texture
+{
+  Q_OBJECT
+
+  // NOTE: Configuration is declared before the uri so that it is read before the plugin is loaded.
+  Q_PROPERTY(QString config READ getConfig WRITE setConfig)
+  Q_PROPERTY(QString uri READ getUri WRITE setUri)
+
+public:
+  Q_INVOKABLE PluginSource(int id=NULL_UID);
+  PluginSource(const QString& uri_, const QString& config, uid id=NULL_UID);
+  virtual ~PluginSource();
+
+  /// Path to the plugin (shared library).
+  const QString getUri() const { return _uri; }
+  bool setUri(const QString& uri);
+
+  /// Free-form configuration string passed to the plugin. Reloads the plugin.
+  const QString getConfig() const { return _config; }
+  bool setConfig(const QString& config);
+
+  /// Name reported by the plugin.
+  QString getProviderName() const;
+
+  virtual QString getType() const { return "plugin"; }
+
+  virtual void rewind();
+
+  virtual void lockMutex();
+  virtual void unlockMutex();
+
+  virtual int getWidth() const;
+  virtual int getHeight() const;
+
+  virtual const uchar* getBits();
+
+  virtual bool bitsHaveChanged() const;
+
+  virtual QIcon getIcon() const { return QIcon(":/add-video"); }
+
+  /// File filter for plugins (eg. "*.so").
+  static const QString PLUGIN_FILES_FILTER;
+
+protected:
+  virtual void _doPlay();
+  virtual void _doPause();
+
+  // (Re)loads the plugin: the current one is only replaced on success.
+  bool _load(const QString& uri, const QString& config);
+
+  QString _uri;
+  QString _config;
+
+  FrameProvider *_provider;
+};
+
 }
 
 #endif /* PAINT_H_ */
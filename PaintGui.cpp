@@ -46,6 +46,11 @@ PaintGui::PaintGui(Paint::ptr paint)
   _opacityItem->setAttribute("decimals", 1);
   _opacityItem->setValue(_paint->getOpacity()*100.0);
   _topItem->addSubProperty(_opacityItem);
+
+  _modulationItem = _variantManager->addProperty(QVariant::String, QObject::tr("Modulation"));
+  _modulationItem->setToolTip(QObject::tr("eg. opacity: input.band0 0.2 1"));
+  _modulationItem->setValue(_paint->getModulation());
+  _topItem->addSubProperty(_modulationItem);
 }
 
 PaintGui::~PaintGui()
@@ -69,12 +74,21 @@ void PaintGui::setValue(QtProperty* property, const QVariant& value)
       emit valueChanged(_paint);
     }
   }
+  else if (property == _modulationItem)
+  {
+    // Show modulation as understood (or previous one if invalid).
+    _paint->setModulation(value.toString());
+    _modulationItem->setValue(_paint->getModulation());
+    emit valueChanged(_paint);
+  }
 }
 
 void PaintGui::setValue(QString propertyName, QVariant value)
 {
   if (propertyName == "opacity")
     _opacityItem->setValue(value.toDouble() * 100);
+  else if (propertyName == "modulation")
+    _modulationItem->setValue(value);
 }
 
 ColorGui::ColorGui(Paint::ptr paint)
@@ -109,6 +123,73 @@ void ColorGui::setValue(QString propertyName, QVariant value)
 }
 
 TextureGui::TextureGui(Paint::ptr paint) : PaintGui(paint) {
+  texture = qSharedPointerCast<Texture>(paint);
+  Q_CHECK_PTR(texture);
+
+  // Color correction (collapsed).
+  _colorCorrectionItem = _variantManager->addProperty(QtVariantPropertyManager::groupTypeId(),
+                                                      tr("Color correction"));
+  _brightnessItem = _addColorCorrectionProperty(tr("Brightness"), -1, 1, texture->getBrightness());
+  _contrastItem   = _addColorCorrectionProperty(tr("Contrast"),    0, 2, texture->getContrast());
+  _saturationItem = _addColorCorrectionProperty(tr("Saturation"),  0, 2, texture->getSaturation());
+  _hueItem        = _addColorCorrectionProperty(tr("Hue"),        -1, 1, texture->getHue());
+  _topItem->addSubProperty(_colorCorrectionItem);
+
+  QtTreePropertyBrowser* browser = qobject_cast<QtTreePropertyBrowser*>(_propertyBrowser);
+  if (browser)
+    browser->setExpanded(browser->items(_colorCorrectionItem).at(0), false);
+}
+
+QtVariantProperty* TextureGui::_addColorCorrectionProperty(const QString& name, double minimum, double maximum, double value)
+{
+  QtVariantProperty* item = _variantManager->addProperty(QVariant::Double, name);
+  item->setAttribute("minimum", minimum);
+  item->setAttribute("maximum", maximum);
+  item->setAttribute("decimals", 2);
+  item->setAttribute("singleStep", 0.05);
+  item->setValue(value);
+  _colorCorrectionItem->addSubProperty(item);
+  return item;
+}
+
+void TextureGui::setValue(QtProperty* property, const QVariant& value)
+{
+  if (property == _brightnessItem)
+  {
+    texture->setBrightness(value.toFloat());
+    emit valueChanged(_paint);
+  }
+  else if (property == _contrastItem)
+  {
+    texture->setContrast(value.toFloat());
+    emit valueChanged(_paint);
+  }
+  else if (property == _saturationItem)
+  {
+    texture->setSaturation(value.toFloat());
+    emit valueChanged(_paint);
+  }
+  else if (property == _hueItem)
+  {
+    texture->setHue(value.toFloat());
+    emit valueChanged(_paint);
+  }
+  else
+    PaintGui::setValue(property, value);
+}
+
+void TextureGui::setValue(QString propertyName, QVariant value)
+{
+  if (propertyName == "brightness")
+    _brightnessItem->setValue(value);
+  else if (propertyName == "contrast")
+    _contrastItem->setValue(value);
+  else if (propertyName == "saturation")
+    _saturationItem->setValue(value);
+  else if (propertyName == "hue")
+    _hueItem->setValue(value);
+  else
+    PaintGui::setValue(propertyName, value);
 }
 
 ImageGui::ImageGui(Paint::ptr paint)
@@ -130,8 +211,13 @@ _imageFileItem->setValue(image->getUri());
   _imageRateItem->setAttribute("decimals", 1);
   _imageRateItem->setValue(rate);
 
+  _imageCompressedItem = _variantManager->addProperty(QVariant::Bool,
+                                                      tr("Compress on GPU"));
+  _imageCompressedItem->setValue(image->isCompressed());
+
   _topItem->addSubProperty(_imageFileItem);
   _topItem->addSubProperty(_imageRateItem);
+  _topItem->addSubProperty(_imageCompressedItem);
 }
 
 void ImageGui::setValue(QtProperty* property, const QVariant& value) {
@@ -145,6 +231,11 @@ void ImageGui::setValue(QtProperty* property, const QVariant& value) {
     image->setRate(value.toDouble()/100.0);
     emit valueChanged(_paint);
   }
+  else if (property == _imageCompressedItem)
+  {
+    image->setCompressed(value.toBool());
+    emit valueChanged(_paint);
+  }
   else
     TextureGui::setValue(property, value);
 }
@@ -155,6 +246,8 @@ void ImageGui::setValue(QString propertyName, QVariant value)
     _imageFileItem->setValue(value);
   else if (propertyName == "rate")
     _imageRateItem->setValue(value.toDouble()*100);
+  else if (propertyName == "compressed")
+    _imageCompressedItem->setValue(value);
   else
     TextureGui::setValue(propertyName, value);
 }
@@ -171,6 +264,10 @@ VideoGui::VideoGui(Paint::ptr paint)
   _mediaFileItem->setAttribute("filter", tr("Video files (%1);;All files (*)").arg(MM::VIDEO_FILES_FILTER));
   _mediaFileItem->setValue(media->getUri());
 
+  _mediaPlaylistItem = _variantManager->addProperty(QVariant::String,
+                                                    tr("Playlist (eg. a.mov | 2x; b.mp4 | 30s)"));
+  _mediaPlaylistItem->setValue(media->getPlaylist());
+
   _mediaRateItem = _variantManager->addProperty(QVariant::Double,
                                                 tr("Speed (%)"));
   // we need to save it because the call to setAttribute will set it to minimum
@@ -186,13 +283,50 @@ VideoGui::VideoGui(Paint::ptr paint)
   _mediaVolumeItem->setAttribute("decimals", 1);
   _mediaVolumeItem->setValue(volume);
 
+  _mediaCropItem = _variantManager->addProperty(QVariant::Bool,
+                                                tr("Crop to input shapes"));
+  _mediaCropItem->setValue(media->isCropToInputShapes());
+
+  _mediaDecoderThreadsItem = _variantManager->addProperty(QVariant::Int,
+                                                          tr("Decoder threads (0 = default)"));
+  _mediaDecoderThreadsItem->setAttribute("minimum", 0);
+  _mediaDecoderThreadsItem->setAttribute("maximum", 64);
+  _mediaDecoderThreadsItem->setValue(media->getDecoderThreads());
+
+  _mediaConverterThreadsItem = _variantManager->addProperty(QVariant::Int,
+                                                            tr("Converter threads (0 = default)"));
+  _mediaConverterThreadsItem->setAttribute("minimum", 0);
+  _mediaConverterThreadsItem->setAttribute("maximum", 64);
+  _mediaConverterThreadsItem->setValue(media->getConverterThreads());
+
+  _mediaThreadPriorityItem = _variantManager->addProperty(QVariant::Int,
+                                                          tr("Thread priority (0 = default)"));
+  _mediaThreadPriorityItem->setAttribute("minimum", -2);
+  _mediaThreadPriorityItem->setAttribute("maximum", 2);
+  _mediaThreadPriorityItem->setValue(media->getThreadPriority());
+
+  _mediaCpuSetItem = _variantManager->addProperty(QVariant::String,
+                                                  tr("CPU set (eg. 0-3, auto, none)"));
+  _mediaCpuSetItem->setValue(media->getCpuSet());
+
+  _mediaAudioAnalysisItem = _variantManager->addProperty(QVariant::Bool,
+                                                         tr("Audio analysis"));
+  _mediaAudioAnalysisItem->setValue(media->hasAudioAnalysis());
+
 //  _mediaReverseItem = _variantManager->addProperty(QVariant::Bool,
 //                                                tr("Reverse"));
 //  _mediaReverseItem->setValue(false);
 
   _topItem->addSubProperty(_mediaFileItem);
+  _topItem->addSubProperty(_mediaPlaylistItem);
   _topItem->addSubProperty(_mediaRateItem);
   _topItem->addSubProperty(_mediaVolumeItem);
+  _topItem->addSubProperty(_mediaCropItem);
+  _topItem->addSubProperty(_mediaAudioAnalysisItem);
+  _topItem->addSubProperty(_mediaDecoderThreadsItem);
+  _topItem->addSubProperty(_mediaConverterThreadsItem);
+  _topItem->addSubProperty(_mediaThreadPriorityItem);
+  _topItem->addSubProperty(_mediaCpuSetItem);
 //  _topItem->addSubProperty(_mediaReverseItem);
 }
 
@@ -203,6 +337,13 @@ void VideoGui::setValue(QtProperty* property, const QVariant& value)
     media->setUri(value.toString());
     emit valueChanged(_paint);
   }
+  else if (property == _mediaPlaylistItem)
+  {
+    // Show playlist as understood (or previous one if invalid).
+    media->setPlaylist(value.toString());
+    _mediaPlaylistItem->setValue(media->getPlaylist());
+    emit valueChanged(_paint);
+  }
   else if (property == _mediaRateItem)
   {
     //double rateSign = (media->getRate() <= 0 ? -1 : +1);
@@ -220,6 +361,36 @@ void VideoGui::setValue(QtProperty* property, const QVariant& value)
     media->setVolume(value.toDouble()/100.0);
     emit valueChanged(_paint);
   }
+  else if (property == _mediaCropItem)
+  {
+    media->setCropToInputShapes(value.toBool());
+    emit valueChanged(_paint);
+  }
+  else if (property == _mediaDecoderThreadsItem)
+  {
+    media->setDecoderThreads(value.toInt());
+    emit valueChanged(_paint);
+  }
+  else if (property == _mediaConverterThreadsItem)
+  {
+    media->setConverterThreads(value.toInt());
+    emit valueChanged(_paint);
+  }
+  else if (property == _mediaThreadPriorityItem)
+  {
+    media->setThreadPriority(value.toInt());
+    emit valueChanged(_paint);
+  }
+  else if (property == _mediaCpuSetItem)
+  {
+    media->setCpuSet(value.toString());
+    emit valueChanged(_paint);
+  }
+  else if (property == _mediaAudioAnalysisItem)
+  {
+    media->setAudioAnalysis(value.toBool());
+    emit valueChanged(_paint);
+  }
   else
     TextureGui::setValue(property, value);
 }
@@ -228,10 +399,168 @@ void VideoGui::setValue(QString propertyName, QVariant value)
 {
   if (propertyName == "uri")
     _mediaFileItem->setValue(value);
-  if (propertyName == "rate")
+  else if (propertyName == "playlist")
+    _mediaPlaylistItem->setValue(value);
+  else if (propertyName == "rate")
     _mediaRateItem->setValue(value.toDouble()*100);
-  if (propertyName == "volume")
+  else if (propertyName == "volume")
     _mediaVolumeItem->setValue(value.toDouble()*100);
+  else if (propertyName == "cropToInputShapes")
+    _mediaCropItem->setValue(value);
+  else if (propertyName == "decoderThreads")
+    _mediaDecoderThreadsItem->setValue(value);
+  else if (propertyName == "converterThreads")
+    _mediaConverterThreadsItem->setValue(value);
+  else if (propertyName == "threadPriority")
+    _mediaThreadPriorityItem->setValue(value);
+  else if (propertyName == "cpuSet")
+    _mediaCpuSetItem->setValue(value);
+  else if (propertyName == "audioAnalysis")
+    _mediaAudioAnalysisItem->setValue(value);
+  else
+    TextureGui::setValue(propertyName, value);
+}
+
+TestSourceGui::TestSourceGui(Paint::ptr paint)
+: VideoGui(paint)
+{
+  source = qSharedPointerCast<TestSource>(paint);
+  Q_CHECK_PTR(source);
+
+  // Settings replace the video file (and playlists and audio do not apply to test sources).
+  _topItem->removeSubProperty(_mediaFileItem);
+  _topItem->removeSubProperty(_mediaPlaylistItem);
+  _topItem->removeSubProperty(_mediaAudioAnalysisItem);
+
+  _patternItem = _variantManager->addProperty(QtVariantPropertyManager::enumTypeId(),
+                                              tr("Pattern"));
+  _patternItem->setAttribute("enumNames", TestSource::patterns());
+  _patternItem->setValue(TestSource::patterns().indexOf(source->getPattern()));
+
+  _widthItem = _variantManager->addProperty(QVariant::Int,
+                                            tr("Width"));
+  _widthItem->setAttribute("minimum", 16);
+  _widthItem->setAttribute("maximum", 8192);
+  _widthItem->setValue(source->getSourceWidth());
+
+  _heightItem = _variantManager->addProperty(QVariant::Int,
+                                             tr("Height"));
+  _heightItem->setAttribute("minimum", 16);
+  _heightItem->setAttribute("maximum", 8192);
+  _heightItem->setValue(source->getSourceHeight());
+
+  _framesPerSecondItem = _variantManager->addProperty(QVariant::Int,
+                                                      tr("Frames per second"));
+  _framesPerSecondItem->setAttribute("minimum", 1);
+  _framesPerSecondItem->setAttribute("maximum", 240);
+  _framesPerSecondItem->setValue(source->getFramesPerSecond());
+
+  QStringList encoderNames = TestSource::encoders();
+  encoderNames[0] = tr("none (raw)");
+  _encoderItem = _variantManager->addProperty(QtVariantPropertyManager::enumTypeId(),
+                                              tr("Encode/decode"));
+  _encoderItem->setAttribute("enumNames", encoderNames);
+  _encoderItem->setValue(TestSource::encoders().indexOf(source->getEncoder()));
+
+  // Insert at the top, where the video file used to be.
+  _topItem->insertSubProperty(_patternItem, 0);
+  _topItem->insertSubProperty(_widthItem, _patternItem);
+  _topItem->insertSubProperty(_heightItem, _widthItem);
+  _topItem->insertSubProperty(_framesPerSecondItem, _heightItem);
+  _topItem->insertSubProperty(_encoderItem, _framesPerSecondItem);
+}
+
+void TestSourceGui::setValue(QtProperty* property, const QVariant& value)
+{
+  if (property == _patternItem)
+  {
+    source->setPattern(TestSource::patterns().value(value.toInt()));
+    emit valueChanged(_paint);
+  }
+  else if (property == _widthItem)
+  {
+    source->setSourceWidth(value.toInt());
+    emit valueChanged(_paint);
+  }
+  else if (property == _heightItem)
+  {
+    source->setSourceHeight(value.toInt());
+    emit valueChanged(_paint);
+  }
+  else if (property == _framesPerSecondItem)
+  {
+    source->setFramesPerSecond(value.toInt());
+    emit valueChanged(_paint);
+  }
+  else if (property == _encoderItem)
+  {
+    source->setEncoder(TestSource::encoders().value(value.toInt()));
+    emit valueChanged(_paint);
+  }
+  else
+    VideoGui::setValue(property, value);
+}
+
+void TestSourceGui::setValue(QString propertyName, QVariant value)
+{
+  if (propertyName == "pattern")
+    _patternItem->setValue(TestSource::patterns().indexOf(value.toString()));
+  else if (propertyName == "sourceWidth")
+    _widthItem->setValue(value);
+  else if (propertyName == "sourceHeight")
+    _heightItem->setValue(value);
+  else if (propertyName == "framesPerSecond")
+    _framesPerSecondItem->setValue(value);
+  else if (propertyName == "encoder")
+    _encoderItem->setValue(TestSource::encoders().indexOf(value.toString()));
+  else
+    VideoGui::setValue(propertyName, value);
+}
+
+PluginSourceGui::PluginSourceGui(Paint::ptr paint)
+: TextureGui(paint)
+{
+  source = qSharedPointerCast<PluginSource>(paint);
+  Q_CHECK_PTR(source);
+
+  _pluginFileItem = _variantManager->addProperty(VariantManager::filePathTypeId(),
+                                                 tr("Plugin file"));
+  _pluginFileItem->setAttribute("filter", tr("Plugins (%1);;All files (*)").arg(PluginSource::PLUGIN_FILES_FILTER));
+  _pluginFileItem->setValue(source->getUri());
+
+  _pluginConfigItem = _variantManager->addProperty(QVariant::String,
+                                                   tr("Configuration"));
+  _pluginConfigItem->setValue(source->getConfig());
+
+  _topItem->addSubProperty(_pluginFileItem);
+  _topItem->addSubProperty(_pluginConfigItem);
+}
+
+void PluginSourceGui::setValue(QtProperty* property, const QVariant& value)
+{
+  if (property == _pluginFileItem)
+  {
+    // Show previous plugin if the new one could not be loaded.
+    source->setUri(value.toString());
+    _pluginFileItem->setValue(source->getUri());
+    emit valueChanged(_paint);
+  }
+  else if (property == _pluginConfigItem)
+  {
+    source->setConfig(value.toString());
+    _pluginConfigItem->setValue(source->getConfig());
+    emit valueChanged(_paint);
+  }
+  else
+    TextureGui::setValue(property, value);
+}
+
+void PluginSourceGui::setValue(QString propertyName, QVariant value)
+{
+  if (propertyName == "uri")
+    _pluginFileItem->setValue(value);
+  else if (propertyName == "config")
+    _pluginConfigItem->setValue(value);
   else
     TextureGui::setValue(propertyName, value);
 }
@@ -80,6 +80,7 @@ protected:
   QtVariantPropertyManager* _variantManager;
   QtProperty* _topItem;
   QtVariantProperty* _opacityItem;
+  QtVariantProperty* _modulationItem;
 };
 
 class ColorGui : public PaintGui {
@@ -104,6 +105,21 @@ class TextureGui : public PaintGui {
 public:
   TextureGui(Paint::ptr paint);
   virtual ~TextureGui() {}
+
+public slots:
+  virtual void setValue(QtProperty* property, const QVariant& value);
+  virtual void setValue(QString propertyName, QVariant value);
+
+protected:
+  QSharedPointer<Texture> texture;
+  QtProperty* _colorCorrectionItem;
+  QtVariantProperty* _brightnessItem;
+  QtVariantProperty* _contrastItem;
+  QtVariantProperty* _saturationItem;
+  QtVariantProperty* _hueItem;
+
+private:
+  QtVariantProperty* _addColorCorrectionProperty(const QString& name, double minimum, double maximum, double value);
 };
 
 class ImageGui : public TextureGui {
@@ -121,6 +137,7 @@ protected:
   QSharedPointer<Image> image;
   QtVariantProperty* _imageFileItem;
   QtVariantProperty* _imageRateItem;
+  QtVariantProperty* _imageCompressedItem;
 };
 
 class VideoGui : public TextureGui {
@@ -137,11 +154,55 @@ public slots:
 protected:
   QSharedPointer<Video> media;
   QtVariantProperty* _mediaFileItem;
+  QtVariantProperty* _mediaPlaylistItem;
   QtVariantProperty* _mediaRateItem;
   QtVariantProperty* _mediaVolumeItem;
+  QtVariantProperty* _mediaCropItem;
+  QtVariantProperty* _mediaDecoderThreadsItem;
+  QtVariantProperty* _mediaConverterThreadsItem;
+  QtVariantProperty* _mediaThreadPriorityItem;
+  QtVariantProperty* _mediaCpuSetItem;
+  QtVariantProperty* _mediaAudioAnalysisItem;
 //  QtVariantProperty* _mediaReverseItem;
 };
 
+class PluginSourceGui : public TextureGui {
+  Q_OBJECT
+
+public:
+  PluginSourceGui(Paint::ptr paint);
+  virtual ~PluginSourceGui() {}
+
+public slots:
+  virtual void setValue(QtProperty* property, const QVariant& value);
+  virtual void setValue(QString propertyName, QVariant value);
+
+protected:
+  QSharedPointer<PluginSource> source;
+  QtVariantProperty* _pluginFileItem;
+  QtVariantProperty* _pluginConfigItem;
+};
+
+class TestSourceGui : public VideoGui {
+  Q_OBJECT
+
+public:
+  TestSourceGui(Paint::ptr paint);
+  virtual ~TestSourceGui() {}
+
+public slots:
+  virtual void setValue(QtProperty* property, const QVariant& value);
+  virtual void setValue(QString propertyName, QVariant value);
+
+protected:
+  QSharedPointer<TestSource> source;
+  QtVariantProperty* _patternItem;
+  QtVariantProperty* _widthItem;
+  QtVariantProperty* _heightItem;
+  QtVariantProperty* _framesPerSecondItem;
+  QtVariantProperty* _encoderItem;
+};
+
 }
 
 #endif /* PAINTGUI_H_ */
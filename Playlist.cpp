@@ -0,0 +1,98 @@
+/*
+ * Playlist.cpp
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Playlist.h"
+
+#include <QStringList>
+#include <QDebug>
+
+namespace mmp {
+
+const QChar Playlist::ITEM_SEPARATOR   = ';';
+const QChar Playlist::OPTION_SEPARATOR = '|';
+
+bool Playlist::parse(const QString& playlist)
+{
+  QList<PlaylistItem> items;
+  foreach (const QString& entry, playlist.split(ITEM_SEPARATOR, QString::SkipEmptyParts))
+  {
+    QStringList fields = entry.split(OPTION_SEPARATOR);
+    PlaylistItem item;
+    item.uri = fields[0].trimmed();
+    if (item.uri.isEmpty())
+      continue;
+
+    if (fields.size() > 2)
+    {
+      qWarning() << "Invalid playlist item '" << entry << "'." << endl;
+      return false;
+    }
+
+    // Option: duration ("30s") or number of loops ("2x").
+    if (fields.size() == 2)
+    {
+      QString option = fields[1].trimmed().toLower();
+      bool ok = false;
+      if (option.endsWith('s'))
+      {
+        item.duration = option.left(option.size() - 1).toDouble(&ok);
+        ok = ok && item.duration > 0;
+      }
+      else if (option.endsWith('x'))
+      {
+        item.loops = option.left(option.size() - 1).toInt(&ok);
+        ok = ok && item.loops > 0;
+      }
+
+      if (!ok)
+      {
+        qWarning() << "Invalid playlist option '" << fields[1] << "' (expected eg. 30s or 2x)." << endl;
+        return false;
+      }
+    }
+
+    items.append(item);
+  }
+
+  _items = items;
+  return true;
+}
+
+QString Playlist::toString() const
+{
+  QStringList entries;
+  foreach (const PlaylistItem& item, _items)
+  {
+    QString entry = item.uri;
+    if (item.hasDuration())
+      entry += QString(" %1 %2s").arg(OPTION_SEPARATOR).arg(item.duration);
+    else if (item.loops != 1)
+      entry += QString(" %1 %2x").arg(OPTION_SEPARATOR).arg(item.loops);
+    entries.append(entry);
+  }
+  return entries.join(QString(ITEM_SEPARATOR) + " ");
+}
+
+int Playlist::indexOf(const QString& uri) const
+{
+  for (int i=0; i<_items.size(); i++)
+    if (_items[i].uri == uri)
+      return i;
+  return (-1);
+}
+
+}
@@ -0,0 +1,80 @@
+/*
+ * Playlist.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PLAYLIST_H_
+#define PLAYLIST_H_
+
+#include <QString>
+#include <QList>
+
+#include "MM.h"
+
+namespace mmp {
+
+/**
+ * One media of a playlist, played either for a given duration (looping if the media is
+ * shorter) or a given number of times.
+ */
+struct PlaylistItem
+{
+  PlaylistItem() : duration(0), loops(1) {}
+
+  QString uri;
+  qreal   duration; // in seconds (0 ==> use loops)
+  int     loops;    // number of times the media is played (if duration is 0)
+
+  bool hasDuration() const { return duration > 0; }
+};
+
+/**
+ * Ordered list of media played one after the other (and looping back to the first one).
+ *
+ * Playlists are written as items separated by semicolons, each item being an URI optionally
+ * followed by a vertical bar and either a duration in seconds or a number of loops, eg.:
+ *   intro.mov | 2x; loop.mp4 | 30s; outro.mov
+ */
+class Playlist
+{
+public:
+  Playlist() {}
+
+  /// Parses a playlist. Returns false (and leaves playlist unchanged) if invalid.
+  bool parse(const QString& playlist);
+
+  /// Returns playlist in the same form as the one accepted by parse().
+  QString toString() const;
+
+  int size() const { return _items.size(); }
+  bool isEmpty() const { return _items.isEmpty(); }
+  const PlaylistItem& item(int i) const { return _items[i]; }
+
+  /// Index of the first item with given uri (-1 if none).
+  int indexOf(const QString& uri) const;
+
+  /// Index of the item following item i.
+  int next(int i) const { return (i + 1) % _items.size(); }
+
+  static const QChar ITEM_SEPARATOR;
+  static const QChar OPTION_SEPARATOR;
+
+private:
+  QList<PlaylistItem> _items;
+};
+
+}
+
+#endif /* PLAYLIST_H_ */
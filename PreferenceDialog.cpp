@@ -107,6 +107,8 @@ bool PreferenceDialog::loadSettings()
   _stickyRadiusBox->setCurrentText(settings.value("vertexStickRadius", MM::VERTEX_STICK_RADIUS).toString());
   // Show screen resolution on output
   _showResolutionBox->setChecked(settings.value("showResolution", MM::SHOW_OUTPUT_RESOLUTION).toBool());
+  // Vertical sync
+  _swapIntervalBox->setValue(settings.value("swapInterval", MM::DEFAULT_SWAP_INTERVAL).toInt());
   // Set preferred test signal pattern
   _radioGroup.at(settings.value("signalTestCard", MM::DEFAULT_TEST_CARD).toInt())->setChecked(true);
   // Set toolbar icon size
@@ -114,6 +116,13 @@ bool PreferenceDialog::loadSettings()
                                          settings.value("toolbarIconSize", MM::TOOLBAR_ICON_SIZE)));
   // Set language
   _languageBox->setCurrentIndex(_languageBox->findData(settings.value("language", MM::DEFAULT_LANGUAGE)));
+  // Media decoding
+  _decoderThreadsBox->setValue(settings.value("decoderThreads", MM::DEFAULT_DECODER_THREADS).toInt());
+  _converterThreadsBox->setValue(settings.value("converterThreads", MM::DEFAULT_CONVERTER_THREADS).toInt());
+  _threadPriorityBox->setValue(settings.value("threadPriority", MM::DEFAULT_THREAD_PRIORITY).toInt());
+  _cpuSetEdit->setText(settings.value("cpuSet", MM::DEFAULT_CPU_SET).toString());
+  // Images
+  _compressImagesBox->setChecked(settings.value("compressImages", MM::DEFAULT_COMPRESS_IMAGES).toBool());
 
   return true;
 }
@@ -131,6 +140,9 @@ void PreferenceDialog::applySettings()
   settings.setValue("vertexStickRadius", _stickyRadiusBox->currentText());
   // Show screen resolution on output
   settings.setValue("showResolution", _showResolutionBox->isChecked());
+  // Vertical sync
+  settings.setValue("swapInterval", _swapIntervalBox->value());
+  mainWindow->setSwapInterval(_swapIntervalBox->value());
   // Set preferred test signal pattern
   for (QRadioButton *radio: _radioGroup) {
     if (radio->isChecked()) {
@@ -142,6 +154,16 @@ void PreferenceDialog::applySettings()
   settings.setValue("toolbarIconSize", _toolbarIconSizeBox->currentData());
   // Set language
   settings.setValue("language", _languageBox->currentData());
+  // Media decoding (applies to media loaded from now on)
+  settings.setValue("decoderThreads", _decoderThreadsBox->value());
+  settings.setValue("converterThreads", _converterThreadsBox->value());
+  settings.setValue("threadPriority", _threadPriorityBox->value());
+  settings.setValue("cpuSet", _cpuSetEdit->text().trimmed());
+  Video::setDefaultThreading(_decoderThreadsBox->value(), _converterThreadsBox->value(),
+                             _threadPriorityBox->value(), _cpuSetEdit->text());
+  // Images (applies to images imported from now on)
+  settings.setValue("compressImages", _compressImagesBox->isChecked());
+  Image::setDefaultCompressed(_compressImagesBox->isChecked());
 }
 
 void PreferenceDialog::refreshCurrentIP()
@@ -231,6 +253,17 @@ void PreferenceDialog::createOutputPage()
 
   _showResolutionBox = new QCheckBox(tr("Show resolution on output"));
 
+  _swapIntervalBox = new QSpinBox;
+  _swapIntervalBox->setRange(0, 4);
+  _swapIntervalBox->setSpecialValueText(tr("Off (frame rate)"));
+  _swapIntervalBox->setSuffix(tr(" refresh(es) per frame"));
+  _swapIntervalBox->setToolTip(tr("With vertical sync, the output window shows a new frame every given number "
+                                  "of refreshes of its display, and sets the frame rate."));
+
+  QFormLayout *syncForm = new QFormLayout;
+  syncForm->setFieldGrowthPolicy(QFormLayout::FieldsStayAtSizeHint);
+  syncForm->addRow(tr("Vertical sync"), _swapIntervalBox);
+
   _classicRadio = new QRadioButton(tr("Classic test card"));
   _palTestRadio = new QRadioButton(tr("PAL test card"));
   _ntscTestRadio = new QRadioButton(tr("NTSC test card"));
@@ -258,6 +291,7 @@ void PreferenceDialog::createOutputPage()
 
   QVBoxLayout *outputLayout = new QVBoxLayout;
   outputLayout->addWidget(_showResolutionBox);
+  outputLayout->addLayout(syncForm);
   outputLayout->addSpacing(30);
   outputLayout->addLayout(testLayout);
   outputLayout->addStretch();
@@ -342,7 +376,52 @@ void PreferenceDialog::createControlsPage()
 
 void PreferenceDialog::createAdvancedPage()
 {
-  _advancedPage = new QTabWidget;
+  _advancedPage = new QWidget;
+
+  // Media decoding
+  _decoderThreadsBox = new QSpinBox;
+  _decoderThreadsBox->setRange(0, 64);
+  _decoderThreadsBox->setSpecialValueText(tr("Automatic"));
+
+  _converterThreadsBox = new QSpinBox;
+  _converterThreadsBox->setRange(0, 64);
+  _converterThreadsBox->setSpecialValueText(tr("Automatic"));
+
+  _threadPriorityBox = new QSpinBox;
+  _threadPriorityBox->setRange(-2, 2);
+
+  _cpuSetEdit = new QLineEdit;
+  _cpuSetEdit->setPlaceholderText(tr("eg. 0-3,8, auto or none"));
+  _cpuSetEdit->setToolTip(tr("CPUs the media streaming threads are pinned to. "
+                             "\"auto\" (default) spreads media over blocks of CPUs, \"none\" or empty disables pinning."));
+
+  QFormLayout *decodingForm = new QFormLayout;
+  decodingForm->setFieldGrowthPolicy(QFormLayout::FieldsStayAtSizeHint);
+  decodingForm->addRow(tr("Decoder threads"), _decoderThreadsBox);
+  decodingForm->addRow(tr("Color conversion threads"), _converterThreadsBox);
+  decodingForm->addRow(tr("Thread priority"), _threadPriorityBox);
+  decodingForm->addRow(tr("CPU set"), _cpuSetEdit);
+
+  QGroupBox *decodingGroupBox = new QGroupBox(tr("Media decoding"));
+  decodingGroupBox->setLayout(decodingForm);
+
+  // Images
+  _compressImagesBox = new QCheckBox(tr("Compress imported still images on the GPU (BC1/BC3)"));
+  _compressImagesBox->setToolTip(tr("Uses 4 to 8 times less video memory, at the cost of some image quality. "
+                                    "Compressed images are cached on disk."));
+
+  QVBoxLayout *imagesLayout = new QVBoxLayout;
+  imagesLayout->addWidget(_compressImagesBox);
+
+  QGroupBox *imagesGroupBox = new QGroupBox(tr("Images"));
+  imagesGroupBox->setLayout(imagesLayout);
+
+  QVBoxLayout *pageLayout = new QVBoxLayout;
+  pageLayout->addWidget(decodingGroupBox);
+  pageLayout->addWidget(imagesGroupBox);
+  pageLayout->addStretch();
+
+  _advancedPage->setLayout(pageLayout);
 }
 
 void PreferenceDialog::createPreferencesList()
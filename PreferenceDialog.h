@@ -87,6 +87,7 @@ private:
 
   // Output widgets
   QCheckBox *_showResolutionBox;
+  QSpinBox *_swapIntervalBox;
   QRadioButton *_classicRadio;
   QRadioButton *_palTestRadio;
   QRadioButton *_ntscTestRadio;
@@ -107,6 +108,13 @@ private:
   QPushButton *_ipRefreshButton;
 
   // Advanced widgets
+  // Media decoding
+  QSpinBox *_decoderThreadsBox;
+  QSpinBox *_converterThreadsBox;
+  QSpinBox *_threadPriorityBox;
+  QLineEdit *_cpuSetEdit;
+  // Images
+  QCheckBox *_compressImagesBox;
 
   // Common widgets
   QListWidget *_listWidget;
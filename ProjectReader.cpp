@@ -73,6 +73,9 @@ void ProjectReader::parseProject(const QDomElement& project)
   QDomElement paints = project.firstChildElement(ProjectLabels::PAINTS);
   QDomElement mappings = project.firstChildElement(ProjectLabels::MAPPINGS);
 
+  // Analyze all media in parallel while paints are being created.
+  _window->startMediaPreflight(MediaPreflight::mediaUris(project));
+
   // Parse paints.
   QDomNode paintNode = paints.firstChild();
   while (!paintNode.isNull())
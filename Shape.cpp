@@ -21,7 +21,7 @@
 
 namespace mmp {
 
-MShape::MShape(const QVector<QPointF>& vertices_) : _isLocked(false) {
+MShape::MShape(const QVector<QPointF>& vertices_) : _isLocked(false), _revision(0) {
   setVertices(vertices_);
   build();
 }
@@ -43,6 +43,13 @@ void MShape::translate(const QPointF& offset)
   // We can feel free to translate every vertex without check by default.
   for (QVector<QPointF>::iterator it = vertices.begin(); it != vertices.end(); ++it)
     *it += offset;
+  _verticesChanged();
+}
+
+QRectF MShape::getBoundingRect() const
+{
+  // Polygonal shapes are contained within their vertices.
+  return QPolygonF(vertices).boundingRect();
 }
 
 void MShape::read(const QDomElement& obj)
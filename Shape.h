@@ -44,6 +44,10 @@ namespace mmp {
 
 /**
  * Shape represented by a series of control points.
+ *
+ * Each change to the vertices increases the revision of the shape and stamps the changed
+ * vertices with it, so that caches (eg. of graphics items) can tell what changed since they
+ * were built without comparing vertices.
  */
 class MShape : public Serializable
 {
@@ -54,7 +58,7 @@ class MShape : public Serializable
 public:
   typedef QSharedPointer<MShape> ptr;
 
-  MShape() : _isLocked(false) {}
+  MShape() : _isLocked(false), _revision(0) {}
   MShape(const QVector<QPointF>& vertices_);
   virtual ~MShape() {}
 
@@ -96,6 +100,9 @@ public:
   /// Translate all vertices of shape by the vector (x,y).
   virtual void translate(const QPointF& offset);
 
+  /// Returns the smallest rectangle containing the whole shape.
+  virtual QRectF getBoundingRect() const;
+
   virtual void copyFrom(const MShape& shape);
 
   virtual MShape* clone() const;
@@ -110,8 +117,15 @@ public:
     // Deep copy.
     vertices.resize(vertices_.size());
     qCopy(vertices_.begin(), vertices_.end(), vertices.begin());
+    _verticesChanged();
   }
 
+  /// Revision of the vertices (increases each time one of them changes).
+  quint64 getRevision() const { return _revision; }
+
+  /// Revision at which vertex i last changed (vertices changed since revision r have a greater one).
+  quint64 getVertexRevision(int i) const { return _vertexRevisions[i]; }
+
   virtual void read(const QDomElement& obj);
   virtual void write(QDomElement& obj);
 
@@ -122,11 +136,22 @@ protected:
   void _addVertex(const QPointF& vertex)
   {
     vertices.push_back(vertex);
+    _vertexRevisions.push_back(++_revision);
   }
 
   void _rawSetVertex(int i, const QPointF& v)
   {
-    vertices[i] = v;
+    if (vertices[i] != v)
+    {
+      vertices[i] = v;
+      _vertexRevisions[i] = ++_revision;
+    }
+  }
+
+  /// Marks all vertices as changed (to be called when vertices are changed directly).
+  void _verticesChanged()
+  {
+    _vertexRevisions.fill(++_revision, vertices.size());
   }
 
   /// Returns a new MShape (using default constructor).
@@ -134,6 +159,10 @@ protected:
 
   // Lists QProperties that should NOT be parsed automatically.
   virtual QList<QString> _propertiesSpecial() const { return Serializable::_propertiesSpecial() << "vertices"; }
+
+private:
+  quint64 _revision;
+  QVector<quint64> _vertexRevisions;
 };
 
 
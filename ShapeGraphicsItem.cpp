@@ -23,6 +23,13 @@
 
 #include "MainWindow.h"
 
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QVector2D>
+#include <QVector4D>
+#include <QtConcurrent>
+#include <QtMath>
+
 namespace mmp {
 
 ShapeGraphicsItem::ShapeGraphicsItem(Mapping::ptr mapping, bool output)
@@ -54,6 +61,11 @@ void ShapeGraphicsItem::paint(QPainter *painter,
   if (isOutput())
     setZValue(getMapping()->getDepth());
 
+  // Output views draw the composition of the output instead (see OutputRenderer).
+  OutputRenderer* renderer = MainWindow::window()->getOutputRenderer();
+  if (isOutput() && renderer && renderer->isActive() && !renderer->isRendering())
+    return;
+
   // Paint if visible.
   if (isMappingVisible())
   {
@@ -202,8 +214,61 @@ void EllipseColorGraphicsItem::_doPaint(QPainter* painter,
   painter->drawPath(shape());
 }
 
+// Applies color correction (see Texture) and blends the previous texture (sampled at the matching
+// place, see _beginShading()) into the current one.
+static const char* TEXTURE_VERTEX_SHADER =
+  "#version 120\n"
+  "void main() {\n"
+  "  gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;\n"
+  "  gl_FrontColor = gl_Color;\n"
+  "  gl_Position = ftransform();\n"
+  "}\n";
+
+static const char* TEXTURE_FRAGMENT_SHADER =
+  "#version 120\n"
+  "uniform sampler2D current;\n"
+  "uniform sampler2D previous;\n"
+  "uniform vec2 previousScale;\n"
+  "uniform vec2 previousOffset;\n"
+  "uniform float progress;\n"        // 1 ==> previous texture is not shown
+  "uniform vec4 currentBalance;\n"   // brightness, contrast, saturation * cos(hue), saturation * sin(hue)
+  "uniform vec4 previousBalance;\n"
+  // Same as videobalance: contrast and brightness on luma, hue and saturation on chroma.
+  "vec4 balance(vec4 color, vec4 b) {\n"
+  "  float y = dot(color.rgb, vec3(0.299, 0.587, 0.114));\n"
+  "  float u = dot(color.rgb, vec3(-0.14713, -0.28886, 0.436));\n"
+  "  float v = dot(color.rgb, vec3(0.615, -0.51499, -0.10001));\n"
+  "  y = (y - 0.0625) * b.y + 0.0625 + b.x;\n"
+  "  vec2 uv = vec2(u * b.z - v * b.w, v * b.z + u * b.w);\n"
+  "  vec3 rgb = vec3(y + 1.13983 * uv.y, y - 0.39465 * uv.x - 0.58060 * uv.y, y + 2.03211 * uv.x);\n"
+  "  return vec4(clamp(rgb, 0.0, 1.0), color.a);\n"
+  "}\n"
+  "void main() {\n"
+  "  vec2 coord = gl_TexCoord[0].st / gl_TexCoord[0].q;\n"
+  "  vec4 color = balance(texture2D(current, coord), currentBalance);\n"
+  "  if (progress < 1.0) {\n"
+  "    vec4 from = balance(texture2D(previous, coord * previousScale + previousOffset), previousBalance);\n"
+  "    color = mix(from, color, progress);\n"
+  "  }\n"
+  "  gl_FragColor = color * gl_Color;\n"
+  "}\n";
+
+// Color correction of a texture as passed to the shader.
+static QVector4D _colorBalance(const Texture& texture)
+{
+  qreal angle = texture.getHue() * M_PI;
+  return QVector4D(texture.getBrightness(), texture.getContrast(),
+                   texture.getSaturation() * qCos(angle), texture.getSaturation() * qSin(angle));
+}
+
+// Number of floats per vertex in vertex buffers (position then homogeneous input point).
+static const int VERTEX_SIZE = 6;
+
 TextureGraphicsItem::TextureGraphicsItem(Mapping::ptr mapping, bool output)
-  : ShapeGraphicsItem(mapping, output)
+  : ShapeGraphicsItem(mapping, output),
+    _shading(false),
+    _verticesChanged(false),
+    _vertexBuffer(QOpenGLBuffer::VertexBuffer)
 {
   _textureMapping = qSharedPointerCast<TextureMapping>(mapping);
   Q_CHECK_PTR(_textureMapping);
@@ -234,7 +299,9 @@ void TextureGraphicsItem::_doDrawInput(QPainter* painter)
     // FIXME: Does this draw the quad counterclockwise?
     glBegin (GL_QUADS);
     {
-      QRectF rect = mapFromScene(_texture.toStrongRef()->getRect()).boundingRect();
+      // Only draw the region of the texture that is actually available (it might be cropped).
+      QSharedPointer<Texture> texture = _texture.toStrongRef();
+      QRectF rect = mapFromScene(QRectF(texture->getBitsRect()).translated(texture->getX(), texture->getY())).boundingRect();
 
       Util::correctGlTexCoord(0, 0);
       glVertex3f (rect.x(), rect.y(), 0);
@@ -256,11 +323,14 @@ void TextureGraphicsItem::_prePaint(QPainter* painter,
                                     const QStyleOptionGraphicsItem *option)
 {
   Q_UNUSED(option);
+  QSharedPointer<TextureMapping> textureMapping = _textureMapping.toStrongRef();
+
+  // Follow the paint of the mapping (it can be changed at any time).
+  _texture = qSharedPointerCast<Texture>(textureMapping->getPaint());
   QSharedPointer<Texture> texture = _texture.toStrongRef();
   painter->beginNativePainting();
 
-  // Project source texture and sent it to destination.
-  texture->update();
+  // NOTE: Textures are updated once per frame before rendering (see MainWindow::updatePaints()).
 
   // Only works for similar shapes.
   // TODO:remettre
@@ -272,15 +342,46 @@ void TextureGraphicsItem::_prePaint(QPainter* painter,
 
   // Get texture.
   glEnable (GL_TEXTURE_2D);
-  glBindTexture(GL_TEXTURE_2D, texture->getTextureId());
+  _bindTexture(*texture);
+
+  // Blend in the previous paint while in transition and correct colors (only if needed).
+  QSharedPointer<Texture> previous;
+  if (isOutput() && textureMapping->isInTransition())
+    previous = qSharedPointerDynamicCast<Texture>(textureMapping->getPreviousPaint());
+  if (previous || texture->hasColorCorrection())
+    _shading = _beginShading(previous, textureMapping->getTransitionProgress());
+
+  // Set texture color (apply opacity).
+  glColor4f(1.0f, 1.0f, 1.0f,
+            isOutput() ? getMapping()->getComputedOpacity() : getMapping()->getPaint()->getOpacity());
+
+}
+
+void TextureGraphicsItem::_postPaint(QPainter* painter,
+                                     const QStyleOptionGraphicsItem *option)
+{
+  Q_UNUSED(option);
+
+  if (_shading)
+  {
+    _textureProgram()->release();
+    _shading = false;
+  }
+
+  glDisable(GL_TEXTURE_2D);
+
+  painter->endNativePainting();
+}
+
+void TextureGraphicsItem::_bindTexture(Texture& texture)
+{
+  glBindTexture(GL_TEXTURE_2D, texture.getTextureId());
 
   // Copy bits to texture iff necessary.
-  texture->lockMutex();
-  if (texture->bitsHaveChanged())
+  texture.lockMutex();
+  if (texture.bitsHaveChanged())
   {
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
-                 texture->getWidth(), texture->getHeight(), 0, GL_RGBA,
-                 GL_UNSIGNED_BYTE, texture->getBits());
+    Util::uploadTextureBits(texture);
     // NOTE: We would gain in efficiency if we were able to just update the texture using glTexSubImage2D
     // See: http://stackoverflow.com/questions/11217121/how-to-manage-memory-with-texture-in-opengl
 //    glTexSubImage2D(GL_TEXTURE_2D,
@@ -288,27 +389,123 @@ void TextureGraphicsItem::_prePaint(QPainter* painter,
 //        texture->getWidth(), texture->getHeight(), 0,
 //        GL_RGBA, GL_UNSIGNED_BYTE, texture->getBits());
   }
-  texture->unlockMutex();
+  texture.unlockMutex();
 
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
 
-  // Set texture color (apply opacity).
-  glColor4f(1.0f, 1.0f, 1.0f,
-            isOutput() ? getMapping()->getComputedOpacity() : getMapping()->getPaint()->getOpacity());
+bool TextureGraphicsItem::_beginShading(const QSharedPointer<Texture>& previous, qreal progress)
+{
+  QOpenGLShaderProgram* program = _textureProgram();
+  if (!program)
+    return false;
 
+  QSharedPointer<Texture> texture = _texture.toStrongRef();
+  program->bind();
+  program->setUniformValue("current", 0);
+  program->setUniformValue("currentBalance", _colorBalance(*texture));
+  program->setUniformValue("progress", GLfloat(previous ? progress : 1));
+  if (!previous)
+    return true;
+
+  // Previous texture goes on the second texture unit.
+  QOpenGLFunctions* gl = QOpenGLContext::currentContext()->functions();
+  gl->glActiveTexture(GL_TEXTURE1);
+  _bindTexture(*previous);
+  gl->glActiveTexture(GL_TEXTURE0);
+
+  // Geometry only carries the texture coordinates of the current texture: map them to the
+  // coordinates of the same input points in the previous texture.
+  QRectF from = QRectF(texture->getBitsRect()).translated(texture->getX(), texture->getY());
+  QRectF to   = QRectF(previous->getBitsRect()).translated(previous->getX(), previous->getY());
+
+  program->setUniformValue("previous", 1);
+  program->setUniformValue("previousBalance", _colorBalance(*previous));
+  program->setUniformValue("previousScale",  QVector2D(from.width() / to.width(), from.height() / to.height()));
+  program->setUniformValue("previousOffset", QVector2D((from.x() - to.x()) / to.width(), (from.y() - to.y()) / to.height()));
+  return true;
 }
 
-void TextureGraphicsItem::_postPaint(QPainter* painter,
-                                     const QStyleOptionGraphicsItem *option)
+QOpenGLShaderProgram* TextureGraphicsItem::_textureProgram()
 {
-  Q_UNUSED(option);
+  // Built once per context and owned by it.
+  QOpenGLContext* context = QOpenGLContext::currentContext();
+  QOpenGLShaderProgram* program = context->findChild<QOpenGLShaderProgram*>("texture");
+  if (program || context->property("textureProgramUnavailable").toBool())
+    return program;
+
+  program = new QOpenGLShaderProgram(context);
+  program->setObjectName("texture");
+  if (!program->addShaderFromSourceCode(QOpenGLShader::Vertex, TEXTURE_VERTEX_SHADER) ||
+      !program->addShaderFromSourceCode(QOpenGLShader::Fragment, TEXTURE_FRAGMENT_SHADER) ||
+      !program->link())
+  {
+    // Paints will be switched without transition and shown without color correction.
+    qWarning() << "Cannot build texture shader: " << program->log() << endl;
+    context->setProperty("textureProgramUnavailable", true);
+    delete program;
+    program = NULL;
+  }
+  return program;
+}
 
-  glDisable(GL_TEXTURE_2D);
+void TextureGraphicsItem::_clearVertices()
+{
+  _vertices.clear();
+  _verticesTransform = sceneTransform();
+  _verticesChanged = true;
+}
 
-  painter->endNativePainting();
+void TextureGraphicsItem::_addVertex(const QPointF& inputPoint, const QPointF& outputPoint, qreal weight)
+{
+  _vertices << outputPoint.x() << outputPoint.y()
+            << inputPoint.x() * weight << inputPoint.y() * weight << 0 << weight;
+}
+
+void TextureGraphicsItem::_drawVertices()
+{
+  if (_vertices.isEmpty())
+    return;
+
+  // Upload vertices iff they changed (falls back on client-side arrays if buffers are unavailable).
+  quintptr base = 0;
+  bool buffered = (_vertexBuffer.isCreated() || _vertexBuffer.create());
+  if (buffered)
+  {
+    _vertexBuffer.bind();
+    if (_verticesChanged)
+      _vertexBuffer.allocate(_vertices.constData(), _vertices.size() * sizeof(GLfloat));
+  }
+  else
+    base = quintptr(_vertices.constData());
+  _verticesChanged = false;
+
+  // Map input points to the region actually covered by the bits (see Util::setGlTexPoint()).
+  QSharedPointer<Texture> texture = _texture.toStrongRef();
+  QRect bitsRect = texture->getBitsRect();
+  glMatrixMode(GL_TEXTURE);
+  glPushMatrix();
+  glLoadIdentity();
+  glScalef(1.0f / bitsRect.width(), 1.0f / bitsRect.height(), 1.0f);
+  glTranslatef(-texture->getX() - bitsRect.x(), -texture->getY() - bitsRect.y(), 0.0f);
+
+  const GLsizei stride = VERTEX_SIZE * sizeof(GLfloat);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glVertexPointer(2, GL_FLOAT, stride, (const GLvoid*) base);
+  glTexCoordPointer(4, GL_FLOAT, stride, (const GLvoid*) (base + 2 * sizeof(GLfloat)));
+  glDrawArrays(GL_TRIANGLES, 0, _vertices.size() / VERTEX_SIZE);
+  glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+
+  glPopMatrix();
+  glMatrixMode(GL_MODELVIEW);
+
+  if (buffered)
+    _vertexBuffer.release();
 }
 
 QPainterPath PolygonTextureGraphicsItem::shape() const
@@ -329,15 +526,21 @@ void TriangleTextureGraphicsItem::_doDrawOutput(QPainter* painter)
   Q_UNUSED(painter);
   if (isOutput())
   {
-    MShape::ptr inputShape = _inputShape.toStrongRef();
-    glBegin(GL_TRIANGLES);
+    MShape::ptr inputShape  = _inputShape.toStrongRef();
+    MShape::ptr outputShape = _shape.toStrongRef();
+
+    // Rebuild vertices iff the triangles changed.
+    if (inputShape->getRevision() != _cachedInputRevision ||
+        outputShape->getRevision() != _cachedOutputRevision || _verticesMoved())
     {
+      _cachedInputRevision  = inputShape->getRevision();
+      _cachedOutputRevision = outputShape->getRevision();
+      _clearVertices();
       for (int i=0; i<inputShape->nVertices(); i++)
-      {
-        Util::setGlTexPoint(*_texture.toStrongRef(), inputShape->getVertex(i), mapFromScene(getShape()->getVertex(i)));
-      }
+        _addVertex(inputShape->getVertex(i), mapFromScene(outputShape->getVertex(i)));
     }
-    glEnd();
+
+    _drawVertices();
   }
 }
 
@@ -348,9 +551,17 @@ PolygonTextureGraphicsItem::PolygonTextureGraphicsItem(Mapping::ptr mapping, boo
 MeshTextureGraphicsItem::MeshTextureGraphicsItem(Mapping::ptr mapping, bool output) : PolygonTextureGraphicsItem(mapping, output) {
   _controlPainter.reset(new MeshControlPainter(this));
   _nHorizontalQuads = _nVerticalQuads = -1;
+  _cachedInputRevision = _cachedOutputRevision = 0;
+  _buildingInputRevision = _buildingOutputRevision = 0;
+  _tessellationPending = false;
+  _fullRebuildRequested = false;
   _wasGrabbing = false;
+  _wasHomography = false;
 }
 
+// Corners of the cell at (x, y) of a mesh, as offsets to (x, y).
+static const int CELL_CORNERS[4][2] = { {0, 0}, {1, 0}, {1, 1}, {0, 1} };
+
 void MeshTextureGraphicsItem::_doDrawOutput(QPainter* painter)
 {
   Q_UNUSED(painter);
@@ -358,18 +569,14 @@ void MeshTextureGraphicsItem::_doDrawOutput(QPainter* painter)
   {
     QSharedPointer<Mesh> outputMesh = qSharedPointerCast<Mesh>(_shape);
     QSharedPointer<Mesh> inputMesh  = qSharedPointerCast<Mesh>(_inputShape);
-    QVector<QVector<Quad::ptr> > outputQuads = outputMesh->getQuads2d();
-    QVector<QVector<Quad::ptr> > inputQuads  = inputMesh->getQuads2d();
 
     // Check if we increased or decreased number of columns/rows in mesh.
-    bool forceRebuild = false;
     if (_nHorizontalQuads != outputMesh->nHorizontalQuads() ||
         _nVerticalQuads != outputMesh->nVerticalQuads())
     {
-      forceRebuild = true;
-      _cachedQuadItems.resize(_nHorizontalQuads = outputMesh->nHorizontalQuads());
-      for (int i=0; i<_nHorizontalQuads; i++)
-        _cachedQuadItems[i].resize(_nVerticalQuads = outputMesh->nVerticalQuads());
+      _fullRebuildRequested = true;
+      _nHorizontalQuads = outputMesh->nHorizontalQuads();
+      _nVerticalQuads   = outputMesh->nVerticalQuads();
     }
 
     // Keep track of whether we are currently grabbing the shape or a vertex so as to
@@ -377,73 +584,220 @@ void MeshTextureGraphicsItem::_doDrawOutput(QPainter* painter)
     bool grabbing = (isMappingCurrent() &&
                      (getCanvas()->shapeGrabbed() || getCanvas()->vertexGrabbed()));
 
-    // Max depth is adjusted to draw less quads during click & drag.
-    int maxDepth = (grabbing ? MM::MESH_SUBDIVISION_MAX_DEPTH_EDITING : MM::MESH_SUBDIVISION_MAX_DEPTH);
+    // Max depth is adjusted to draw less quads during click & drag (cells are not subdivided
+    // when mapped through homographies).
+    bool homography = _textureMapping.toStrongRef()->hasHomographyProjection();
+    int maxDepth = (homography ? 0 :
+                    grabbing ? MM::MESH_SUBDIVISION_MAX_DEPTH_EDITING : MM::MESH_SUBDIVISION_MAX_DEPTH);
+    if (homography != _wasHomography)
+      _fullRebuildRequested = true;
+    _wasHomography = homography;
 
     // Force rebuild on shape/vertex release.
     if (_wasGrabbing && !grabbing) {
-      forceRebuild = true;
+      _fullRebuildRequested = true;
     }
     _wasGrabbing = grabbing;
 
-    // Go through the mesh quad by quad.
-    for (int x = 0; x < outputMesh->nHorizontalQuads(); x++)
-    {
-      for (int y = 0; y < outputMesh->nVerticalQuads(); y++)
-      {
-        Quad::ptr inputQuad  = inputQuads[x][y];
-        Quad::ptr outputQuad = outputQuads[x][y];
+    // Sub-quads are mapped to item coordinates.
+    if (_verticesMoved())
+      _fullRebuildRequested = true;
 
-        // Verify if item needs recomputing.
-        CacheQuadItem& item = _cachedQuadItems[x][y];
-        if (forceRebuild ||
-            item.parent.input->toPolygon()  != inputQuad->toPolygon() ||
-            item.parent.output->toPolygon() != outputQuad->toPolygon()) {
+    // Vertices are rebuilt iff at least one cache cell changed.
+    bool rebuilt = false;
 
-          // Copy input and output quads for verification purposes.
-          item.parent.input  = inputQuad;
-          item.parent.output = outputQuad;
-
-          // Recompute sub quads.
-          item.subQuads.clear();
+    // Collect the cells of a tessellation running in the background.
+    if (_tessellationPending && _tessellation.isFinished())
+    {
+      _finishTessellation();
+      rebuilt = true;
+    }
 
-          QSizeF size = mapFromScene(outputQuad->toPolygon()).boundingRect().size();
-          float area = size.width() * size.height();
+    // Current cells keep being drawn while a tessellation is running.
+    if (!_tessellationPending)
+    {
+      // Subdivide all the cells.
+      if (_fullRebuildRequested)
+      {
+        _fullRebuildRequested = false;
+        _startTessellation(*inputMesh, *outputMesh, maxDepth);
 
-          // Rebuild cache quad item.
-          _buildCacheQuadItem(item, inputQuad, outputQuad, area, 0.0001f, 0.001f, MM::MESH_SUBDIVISION_MIN_AREA, maxDepth);
+        // Nothing to draw meanwhile: wait for the cells (still built in parallel).
+        if (_tessellationPending && _cachedCells.isEmpty())
+        {
+          _tessellation.waitForFinished();
+          _finishTessellation();
         }
+        rebuilt = rebuilt || !_tessellationPending;
+      }
 
-        // Draw all the cached items.
-        for (CacheQuadMapping m: item.subQuads)
+      // Go through the mesh quad by quad (unless nothing changed).
+      else if (inputMesh->getRevision()  != _cachedInputRevision ||
+               outputMesh->getRevision() != _cachedOutputRevision)
+      {
+        for (int x = 0; x < _nHorizontalQuads; x++)
         {
-          glBegin(GL_QUADS);
-          for (int i = 0; i < outputQuad->nVertices(); i++)
+          for (int y = 0; y < _nVerticalQuads; y++)
           {
-            Util::setGlTexPoint(*_texture.toStrongRef(), m.input->getVertex(i), mapFromScene(m.output->getVertex(i)));
+            // Verify if cell needs recomputing (ie. one of its vertices changed).
+            bool changed = false;
+            for (int i = 0; i < 4 && !changed; i++)
+            {
+              int cx = x + CELL_CORNERS[i][0];
+              int cy = y + CELL_CORNERS[i][1];
+              changed = (inputMesh->getVertexRevision2d(cx, cy)  > _cachedInputRevision ||
+                         outputMesh->getVertexRevision2d(cx, cy) > _cachedOutputRevision);
+            }
+
+            if (changed) {
+              CellJob job;
+              for (int i = 0; i < 4; i++)
+              {
+                int cx = x + CELL_CORNERS[i][0];
+                int cy = y + CELL_CORNERS[i][1];
+                job.input[i]  = inputMesh->getVertex2d(cx, cy);
+                job.output[i] = mapFromScene(outputMesh->getVertex2d(cx, cy));
+              }
+              job.cell = &_cachedCells[x * _nVerticalQuads + y];
+              job.maxDepth = maxDepth;
+
+              // Rebuild cache cell.
+              _buildCell(job);
+              rebuilt = true;
+            }
           }
-          glEnd();
         }
+        _cachedInputRevision  = inputMesh->getRevision();
+        _cachedOutputRevision = outputMesh->getRevision();
+      }
+    }
+
+    if (rebuilt)
+      _rebuildVertices(homography);
+
+    // Draw everything at once.
+    _drawVertices();
+
+    // Render again until the cells of the tessellation are collected.
+    if (_tessellationPending)
+      MainWindow::window()->updateCanvases();
+  }
+}
+
+void MeshTextureGraphicsItem::_startTessellation(const Mesh& inputMesh, const Mesh& outputMesh, int maxDepth)
+{
+  int nCells = _nHorizontalQuads * _nVerticalQuads;
+  _buildingCells.resize(nCells);
+  _jobs.resize(nCells);
+
+  // Gather the quads of all the cells (item coordinates can only be computed here).
+  for (int x = 0; x < _nHorizontalQuads; x++)
+  {
+    for (int y = 0; y < _nVerticalQuads; y++)
+    {
+      int k = x * _nVerticalQuads + y;
+      CellJob& job = _jobs[k];
+      for (int i = 0; i < 4; i++)
+      {
+        int cx = x + CELL_CORNERS[i][0];
+        int cy = y + CELL_CORNERS[i][1];
+        job.input[i]  = inputMesh.getVertex2d(cx, cy);
+        job.output[i] = mapFromScene(outputMesh.getVertex2d(cx, cy));
       }
+      job.cell = &_buildingCells[k];
+      job.maxDepth = maxDepth;
     }
   }
+  _buildingInputRevision  = inputMesh.getRevision();
+  _buildingOutputRevision = outputMesh.getRevision();
+
+  if (nCells >= MM::MESH_TESSELLATION_PARALLEL_MIN_CELLS)
+  {
+    _tessellation = QtConcurrent::map(_jobs, &MeshTextureGraphicsItem::_buildCell);
+    _tessellationPending = true;
+  }
+  else
+  {
+    for (CellJob& job: _jobs)
+      _buildCell(job);
+    _finishTessellation();
+  }
+}
+
+void MeshTextureGraphicsItem::_finishTessellation()
+{
+  // Previous cells will be reused by the next tessellation.
+  _cachedCells.swap(_buildingCells);
+  _cachedInputRevision  = _buildingInputRevision;
+  _cachedOutputRevision = _buildingOutputRevision;
+  _tessellationPending = false;
 }
 
-void MeshTextureGraphicsItem::_buildCacheQuadItem(CacheQuadItem& item, const Quad::ptr& inputQuad, const Quad::ptr& outputQuad, float outputArea, float inputThreshod, float outputThreshold, int minArea, int maxDepth)
+void MeshTextureGraphicsItem::_rebuildVertices(bool homography)
+{
+  // Gather all the cached cells, each sub-quad being split in two triangles.
+  static const int QUAD_TRIANGLES[] = { 0, 1, 2, 0, 2, 3 };
+  _clearVertices();
+  for (const CacheCell& cell: _cachedCells)
+  {
+    const GLfloat* inputs  = cell.subInputs.constData();
+    const GLfloat* outputs = cell.subOutputs.constData();
+    for (int q = 0; q < cell.nSubQuads(); q++, inputs += QUAD_SIZE, outputs += QUAD_SIZE)
+    {
+      QPointF input[4], output[4];
+      for (int i = 0; i < 4; i++)
+      {
+        input[i]  = QPointF(inputs[2*i],  inputs[2*i+1]);
+        output[i] = QPointF(outputs[2*i], outputs[2*i+1]);
+      }
+
+      // Homography from the output (in item coordinates) to the input.
+      QTransform h;
+      bool projective = homography &&
+          QTransform::quadToQuad(QPolygonF() << output[0] << output[1] << output[2] << output[3],
+                                 QPolygonF() << input[0]  << input[1]  << input[2]  << input[3], h);
+      for (int i: QUAD_TRIANGLES)
+      {
+        qreal weight = (projective ? h.m13() * output[i].x() + h.m23() * output[i].y() + h.m33() : 1);
+        _addVertex(input[i], output[i], weight);
+      }
+    }
+  }
+}
+
+void MeshTextureGraphicsItem::_buildCell(CellJob& job)
+{
+  // Recompute sub quads (keeping the buffers allocated).
+  CacheCell& cell = *job.cell;
+  cell.subInputs.resize(0);
+  cell.subOutputs.resize(0);
+
+  // Area of the bounding rectangle of the output quad.
+  const QPointF* output = job.output;
+  qreal left   = qMin(qMin(output[0].x(), output[1].x()), qMin(output[2].x(), output[3].x()));
+  qreal right  = qMax(qMax(output[0].x(), output[1].x()), qMax(output[2].x(), output[3].x()));
+  qreal top    = qMin(qMin(output[0].y(), output[1].y()), qMin(output[2].y(), output[3].y()));
+  qreal bottom = qMax(qMax(output[0].y(), output[1].y()), qMax(output[2].y(), output[3].y()));
+  float area = (right - left) * (bottom - top);
+
+  _buildCacheCell(cell, job.input, job.output, area, 0.0001f, 0.001f, MM::MESH_SUBDIVISION_MIN_AREA, job.maxDepth);
+}
+
+void MeshTextureGraphicsItem::_buildCacheCell(CacheCell& cell, const QPointF* input, const QPointF* output, float outputArea, float inputThreshod, float outputThreshold, int minArea, int maxDepth)
 {
   bool stop = false;
   if (maxDepth == 0 || outputArea < minArea)
     stop = true;
   else {
-    QPointF oa = mapFromScene(outputQuad->getVertex(0));
-    QPointF ob = mapFromScene(outputQuad->getVertex(1));
-    QPointF oc = mapFromScene(outputQuad->getVertex(2));
-    QPointF od = mapFromScene(outputQuad->getVertex(3));
+    const QPointF& oa = output[0];
+    const QPointF& ob = output[1];
+    const QPointF& oc = output[2];
+    const QPointF& od = output[3];
 
-    QPointF ia = inputQuad->getVertex(0);
-    QPointF ib = inputQuad->getVertex(1);
-    QPointF ic = inputQuad->getVertex(2);
-    QPointF id = inputQuad->getVertex(3);
+    const QPointF& ia = input[0];
+    const QPointF& ib = input[1];
+    const QPointF& ic = input[2];
+    const QPointF& id = input[3];
 
     QPointF outputV1 = oa-ob;
     QPointF outputV2 = oc-ob;
@@ -477,27 +831,31 @@ void MeshTextureGraphicsItem::_buildCacheQuadItem(CacheQuadItem& item, const Qua
   //
   if (stop)
   {
-    item.subQuads.append( (CacheQuadMapping){ inputQuad, outputQuad } );
+    for (int i = 0; i < 4; i++)
+    {
+      cell.subInputs  << input[i].x()  << input[i].y();
+      cell.subOutputs << output[i].x() << output[i].y();
+    }
   }
   else // subdivide
   {
-    QList<Quad::ptr> inputSubQuads  = _split(*inputQuad);
-    QList<Quad::ptr> outputSubQuads = _split(*outputQuad);
-    for (int i = 0; i < inputSubQuads.size(); i++)
+    QPointF inputSubQuads[4][4];
+    QPointF outputSubQuads[4][4];
+    _split(input,  inputSubQuads);
+    _split(output, outputSubQuads);
+    for (int i = 0; i < 4; i++)
     {
-      _buildCacheQuadItem(item, inputSubQuads[i], outputSubQuads[i], outputArea*0.25, inputThreshod, outputThreshold, minArea, (maxDepth == -1 ? -1 : maxDepth - 1));
+      _buildCacheCell(cell, inputSubQuads[i], outputSubQuads[i], outputArea*0.25, inputThreshod, outputThreshold, minArea, (maxDepth == -1 ? -1 : maxDepth - 1));
     }
   }
 }
 
-QList<Quad::ptr> MeshTextureGraphicsItem::_split(const Quad& quad)
+void MeshTextureGraphicsItem::_split(const QPointF* quad, QPointF subQuads[4][4])
 {
-  QList<Quad::ptr> quads;
-
-  QPointF a = quad.getVertex(0);
-  QPointF b = quad.getVertex(1);
-  QPointF c = quad.getVertex(2);
-  QPointF d = quad.getVertex(3);
+  const QPointF& a = quad[0];
+  const QPointF& b = quad[1];
+  const QPointF& c = quad[2];
+  const QPointF& d = quad[3];
 
   QPointF ab = (a + b) * 0.5f;
   QPointF bc = (b + c) * 0.5f;
@@ -506,12 +864,15 @@ QList<Quad::ptr> MeshTextureGraphicsItem::_split(const Quad& quad)
 
   QPointF abcd = (ab + cd) * 0.5f;
 
-  quads.append(Quad::ptr(new Quad(a, ab, abcd, ad)));
-  quads.append(Quad::ptr(new Quad(ab, b, bc, abcd)));
-  quads.append(Quad::ptr(new Quad(abcd, bc, c, cd)));
-  quads.append(Quad::ptr(new Quad(ad, abcd, cd, d)));
-
-  return quads;
+  const QPointF quads[4][4] = {
+    { a, ab, abcd, ad },
+    { ab, b, bc, abcd },
+    { abcd, bc, c, cd },
+    { ad, abcd, cd, d }
+  };
+  for (int i = 0; i < 4; i++)
+    for (int j = 0; j < 4; j++)
+      subQuads[i][j] = quads[i][j];
 }
 
 EllipseTextureGraphicsItem::DrawingData::DrawingData(const QSharedPointer<Ellipse>& ellipse)
@@ -552,6 +913,8 @@ void EllipseTextureGraphicsItem::DrawingData::setPointOfEllipseAtAngle(QPointF&
 
 EllipseTextureGraphicsItem::EllipseTextureGraphicsItem(Mapping::ptr mapping, bool output) : TextureGraphicsItem(mapping, output) {
   _controlPainter.reset(new EllipseControlPainter(this));
+  _cachedInputRevision = _cachedOutputRevision = 0;
+  _nTriangles = 0;
 }
 
 QPainterPath EllipseTextureGraphicsItem::shape() const
@@ -578,58 +941,86 @@ void EllipseTextureGraphicsItem::_doDrawOutput(QPainter* painter)
   // Get input and output ellipses.
   QSharedPointer<Ellipse> inputEllipse  = qSharedPointerCast<Ellipse>(_inputShape);
   QSharedPointer<Ellipse> outputEllipse = qSharedPointerCast<Ellipse>(_shape);
-  QSharedPointer<Texture> texture = _texture.toStrongRef();
 
-  // Data for calculating drawing.
-  DrawingData inputData(inputEllipse);
-  DrawingData outputData(outputEllipse);
-
-  // Points that contain the triangle positions on the border of the ellipse.
-  QPointF currentInputPoint;
-  QPointF prevInputPoint(0, 0);
-  QPointF currentOutputPoint;
-  QPointF prevOutputPoint(0, 0);
-
-  // Draw each quarter of the ellipse.
-  for (int i=0; i<N_QUARTERS; i++)
+  // Rebuild triangles iff one of the ellipses or the needed precision changed.
+  int nTriangles = _nTrianglesOnScreen(*outputEllipse);
+  if (inputEllipse->getRevision()  != _cachedInputRevision ||
+      outputEllipse->getRevision() != _cachedOutputRevision ||
+      nTriangles != _nTriangles || _verticesMoved())
   {
-    // Total angle range of current quarter.
-    float inputAngleSpanInQuarter  = inputData.getSpanInQuarter(i);
-    float outputAngleSpanInQuarter = outputData.getSpanInQuarter(i);
-
-    // N. triangles (computed according to output).
-    int nTrianglesInQuarter  = ceil(outputAngleSpanInQuarter / (2*M_PI) * MM::ELLIPSE_N_TRIANGLES);
+    _cachedInputRevision  = inputEllipse->getRevision();
+    _cachedOutputRevision = outputEllipse->getRevision();
+    _nTriangles = nTriangles;
+    _clearVertices();
+
+    // Data for calculating drawing.
+    DrawingData inputData(inputEllipse);
+    DrawingData outputData(outputEllipse);
+    QPointF outputControlCenter = mapFromScene(outputData.controlCenter);
+
+    // Points that contain the triangle positions on the border of the ellipse.
+    QPointF currentInputPoint;
+    QPointF prevInputPoint(0, 0);
+    QPointF currentOutputPoint;
+    QPointF prevOutputPoint(0, 0);
+
+    // Build each quarter of the ellipse.
+    for (int i=0; i<N_QUARTERS; i++)
+    {
+      // Total angle range of current quarter.
+      float inputAngleSpanInQuarter  = inputData.getSpanInQuarter(i);
+      float outputAngleSpanInQuarter = outputData.getSpanInQuarter(i);
 
-    // Angle per triangle.
-    float inputAnglePerTriangle  = inputAngleSpanInQuarter / nTrianglesInQuarter;
-    float outputAnglePerTriangle = outputAngleSpanInQuarter / nTrianglesInQuarter;
+      // N. triangles (computed according to output).
+      int nTrianglesInQuarter  = ceil(outputAngleSpanInQuarter / (2*M_PI) * nTriangles);
 
-    float inputAngle  = inputData.quarterAngles[i];
-    float outputAngle = outputData.quarterAngles[i];
-    for (int j=0; j<=nTrianglesInQuarter; j++, inputAngle += inputAnglePerTriangle, outputAngle += outputAnglePerTriangle)
-    {
-      // Set next (current) points.
-      inputData.setPointOfEllipseAtAngle(currentInputPoint, inputAngle);
-      outputData.setPointOfEllipseAtAngle(currentOutputPoint, outputAngle);
+      // Angle per triangle.
+      float inputAnglePerTriangle  = inputAngleSpanInQuarter / nTrianglesInQuarter;
+      float outputAnglePerTriangle = outputAngleSpanInQuarter / nTrianglesInQuarter;
 
-      if (j > 0) // We don't draw the first triangle.
+      float inputAngle  = inputData.quarterAngles[i];
+      float outputAngle = outputData.quarterAngles[i];
+      for (int j=0; j<=nTrianglesInQuarter; j++, inputAngle += inputAnglePerTriangle, outputAngle += outputAnglePerTriangle)
       {
-        // Draw triangle.
-        glBegin(GL_TRIANGLES);
-        Util::setGlTexPoint(*texture, inputData.controlCenter, outputData.controlCenter);
-        Util::setGlTexPoint(*texture, prevInputPoint,     prevOutputPoint);
-        Util::setGlTexPoint(*texture, currentInputPoint,  currentOutputPoint);
-        glEnd();
-      }
+        // Set next (current) points.
+        inputData.setPointOfEllipseAtAngle(currentInputPoint, inputAngle);
+        outputData.setPointOfEllipseAtAngle(currentOutputPoint, outputAngle);
+        currentOutputPoint = mapFromScene(currentOutputPoint);
 
-      // Save point for next iteration.
-      prevInputPoint.setX(currentInputPoint.x());
-      prevInputPoint.setY(currentInputPoint.y());
-      prevOutputPoint.setX(currentOutputPoint.x());
-      prevOutputPoint.setY(currentOutputPoint.y());
-    }
+        if (j > 0) // We don't draw the first triangle.
+        {
+          // Add triangle.
+          _addVertex(inputData.controlCenter, outputControlCenter);
+          _addVertex(prevInputPoint,          prevOutputPoint);
+          _addVertex(currentInputPoint,       currentOutputPoint);
+        }
 
+        // Save point for next iteration.
+        prevInputPoint  = currentInputPoint;
+        prevOutputPoint = currentOutputPoint;
+      }
+    }
   }
+
+  _drawVertices();
+}
+
+int EllipseTextureGraphicsItem::_nTrianglesOnScreen(const Ellipse& ellipse) const
+{
+  // Largest scale at which the ellipse is shown (the same for all views so that the triangles
+  // are not rebuilt each time the item is painted in another view).
+  qreal scale = 0;
+  foreach (QGraphicsView* view, scene()->views())
+    scale = qMax(scale, qSqrt(qAbs(view->viewportTransform().determinant())));
+
+  // Circumference (Ramanujan's approximation) on screen.
+  qreal a = ellipse.getHorizontalRadius() * scale;
+  qreal b = ellipse.getVerticalRadius() * scale;
+  qreal circumference = M_PI * (3 * (a + b) - qSqrt((3 * a + b) * (a + 3 * b)));
+
+  // Rounded up to a multiple of 8 so that small changes of size do not rebuild the triangles.
+  int nTriangles = (qCeil(circumference / MM::ELLIPSE_TRIANGLE_EDGE) + 7) & ~7;
+  return qBound(MM::ELLIPSE_MIN_TRIANGLES, nTriangles, MM::ELLIPSE_MAX_TRIANGLES);
 }
 
 }
@@ -32,6 +32,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include <QFuture>
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+
 #include "Shapes.h"
 
 #include "Paint.h"
@@ -184,10 +188,51 @@ protected:
   virtual void _doDrawOutput(QPainter* painter) = 0;
   virtual void _doDrawInput(QPainter* painter);
 
+  /// Binds texture to the active texture unit, uploading its bits if they changed.
+  static void _bindTexture(Texture& texture);
+
+  /**
+   * Binds the texture shader: applies color correction and crossfades from the previous texture
+   * (if not null) by progress. Returns false if shaders are not available.
+   */
+  bool _beginShading(const QSharedPointer<Texture>& previous, qreal progress);
+
+  /// Shader used to draw textures when needed (NULL if unavailable).
+  static QOpenGLShaderProgram* _textureProgram();
+
+  /**
+   * Output geometry is kept between frames as triangles: subclasses rebuild it only when needed
+   * (calling _clearVertices() then _addVertex() for each vertex) and draw it with _drawVertices().
+   */
+  void _clearVertices();
+
+  /**
+   * Adds a vertex mapping inputPoint (in the input canvas) to outputPoint (in item coordinates).
+   * Input points are interpolated projectively according to their weights (the denominator of
+   * the homography mapping the output to the input at that vertex, or 1 for affine mapping).
+   */
+  void _addVertex(const QPointF& inputPoint, const QPointF& outputPoint, qreal weight=1);
+
+  /// Draws the vertices in one call, uploading them first if they changed.
+  void _drawVertices();
+
+  /// Returns true iff the item moved in the scene since the vertices were built.
+  bool _verticesMoved() const { return sceneTransform() != _verticesTransform; }
+
 protected:
   QWeakPointer<TextureMapping> _textureMapping;
   QWeakPointer<Texture> _texture;
   QWeakPointer<MShape> _inputShape;
+  bool _shading;
+
+private:
+  // Interleaved vertices: position (item coordinates) then homogeneous input point (canvas
+  // coordinates, mapped to texture coordinates on drawing so that the geometry does not depend
+  // on the texture).
+  QVector<GLfloat> _vertices;
+  QTransform _verticesTransform;
+  bool _verticesChanged;
+  QOpenGLBuffer _vertexBuffer;
 };
 
 /// Graphics item for textured polygons (eg. triangles).
@@ -206,60 +251,119 @@ public:
 class TriangleTextureGraphicsItem : public PolygonTextureGraphicsItem
 {
 public:
-  TriangleTextureGraphicsItem(Mapping::ptr mapping, bool output=true) : PolygonTextureGraphicsItem(mapping, output) {}
+  TriangleTextureGraphicsItem(Mapping::ptr mapping, bool output=true)
+    : PolygonTextureGraphicsItem(mapping, output), _cachedInputRevision(0), _cachedOutputRevision(0) {}
   virtual ~TriangleTextureGraphicsItem(){}
 
   virtual void _doDrawOutput(QPainter* painter);
 
+private:
+  // Revisions of the input and output shapes the vertices were built from.
+  quint64 _cachedInputRevision;
+  quint64 _cachedOutputRevision;
 };
 
 /**
  * Graphics item for textured mesh.
  * The drawing technique recursively subdivides the quad to approximate projective mapping and thus
- * avoiding artifacts on the diagonals. Subdivided structure is cached to increase performance.
+ * avoiding artifacts on the diagonals. Subdivided structure is cached to increase performance and
+ * drawn from a vertex buffer rebuilt only when the cache changes.
  * Source: Oliveira, M. "Correcting Texture Mapping Errors Introduced by Graphics Hardware"
+ *
+ * Alternatively (see TextureMapping::projections()), each cell is drawn as two triangles whose
+ * input points are the homogeneous coordinates given by the homography of the cell, which makes
+ * the texture lookup exact (perspective-correct) without any subdivision.
  */
 class MeshTextureGraphicsItem : public PolygonTextureGraphicsItem
 {
-  // Internal use (cache). A structure consisting of the input and output quads of mapping.
-  struct CacheQuadMapping {
-    Quad::ptr input;
-    Quad::ptr output;
+  // Number of floats taken by the corners (a, b, c, d) of a quad in cache buffers.
+  static const int QUAD_SIZE = 8;
+
+  // Internal use (cache). Sub-quads of a cell of the mesh, stored as flat arrays of corners: input
+  // points, and output points in item coordinates. Buffers are reused between rebuilds (no
+  // allocation once grown).
+  struct CacheCell {
+    QVector<GLfloat> subInputs;
+    QVector<GLfloat> subOutputs;
+
+    int nSubQuads() const { return subInputs.size() / QUAD_SIZE; }
   };
 
-  // Internal use (cache). Contains a parent mapping and all its sub-mappings.
-  struct CacheQuadItem {
-    CacheQuadMapping parent;
-    QList<CacheQuadMapping> subQuads;
+  // Internal use (tessellation). A cell to subdivide: its input and output (item coordinates)
+  // quads and the cache cell receiving its sub-quads.
+  struct CellJob {
+    QPointF input[4];
+    QPointF output[4];
+    CacheCell* cell;
+    int maxDepth;
   };
 public:
   MeshTextureGraphicsItem(Mapping::ptr mapping, bool output=true);
-  virtual ~MeshTextureGraphicsItem(){}
+  virtual ~MeshTextureGraphicsItem() { _tessellation.waitForFinished(); }
 
   virtual void _doDrawOutput(QPainter* painter);
 
 private:
   /**
-   * Builds cache item recursively using the technique described in
+   * Subdivides all the cells into _buildingCells, on the worker pool for large meshes (the
+   * current cells keep being drawn until _finishTessellation() is called), otherwise right away.
+   */
+  void _startTessellation(const Mesh& inputMesh, const Mesh& outputMesh, int maxDepth);
+
+  // Makes the cells built by the last tessellation current.
+  void _finishTessellation();
+
+  // Rebuilds the vertices from the cache cells.
+  void _rebuildVertices(bool homography);
+
+  // Subdivides a cell (thread-safe).
+  static void _buildCell(CellJob& job);
+
+  /**
+   * Builds cache cell recursively using the technique described in
    * Oliveira, M. "Correcting Texture Mapping Errors Introduced by Graphics Hardware"
+   * Output points are in item coordinates.
    */
-  void _buildCacheQuadItem(CacheQuadItem& item, const Quad::ptr& inputQuad, const Quad::ptr& outputQuad,
-                           float outputArea, float inputThreshold = 0.0001f, float outputThreshold = 0.001f,
-                           int minArea=MM::MESH_SUBDIVISION_MIN_AREA, int maxDepth=-1);
+  static void _buildCacheCell(CacheCell& cell, const QPointF* input, const QPointF* output,
+                              float outputArea, float inputThreshold = 0.0001f, float outputThreshold = 0.001f,
+                              int minArea=MM::MESH_SUBDIVISION_MIN_AREA, int maxDepth=-1);
 
-  // Help function that returns four equal-size sub-quads from a quad.
-  QList<Quad::ptr> _split(const Quad& quad);
+  // Help function that computes four equal-size sub-quads (4 corners each) from a quad.
+  static void _split(const QPointF* quad, QPointF subQuads[4][4]);
 
-  // Contains the current cache.
-  QVector<QVector<CacheQuadItem> > _cachedQuadItems;
+  // Contains the current cache (cells of column x are at x * _nVerticalQuads).
+  QVector<CacheCell> _cachedCells;
   int _nHorizontalQuads;
   int _nVerticalQuads;
 
-  // True iff shape was being grabbed last time _buildCacheQuadItem() was called.
+  // Revisions of the input and output meshes the cache was built from (only the cells touching
+  // vertices changed since then are rebuilt).
+  quint64 _cachedInputRevision;
+  quint64 _cachedOutputRevision;
+
+  // Full rebuilds go through a tessellation building the other buffer of cells (swapped with
+  // the current one when done).
+  QVector<CacheCell> _buildingCells;
+  QVector<CellJob> _jobs;
+  quint64 _buildingInputRevision;
+  quint64 _buildingOutputRevision;
+  QFuture<void> _tessellation;
+  bool _tessellationPending;
+
+  // True iff all cells need to be subdivided again (kept until a tessellation can start).
+  bool _fullRebuildRequested;
+
+  // True iff shape was being grabbed last time _buildCacheCell() was called.
   bool _wasGrabbing;
+
+  // True iff cells were mapped through homographies last time the cache was built.
+  bool _wasHomography;
 };
 
-/// Graphics item for textured mesh.
+/**
+ * Graphics item for textured ellipse, drawn as a fan of triangles around the control center
+ * (cached, the number of triangles following the size of the ellipse on screen).
+ */
 class EllipseTextureGraphicsItem : public TextureGraphicsItem
 {
   static const int N_QUARTERS = 4;
@@ -288,6 +392,15 @@ public:
   virtual void _doDrawOutput(QPainter* painter);
 
   static void _setPointOfEllipseAtAngle(QPointF& point, const QPointF& center, float hRadius, float vRadius, float rotation, float circularAngle);
+
+private:
+  // Number of triangles needed for the outline of the ellipse to look smooth in the views.
+  int _nTrianglesOnScreen(const Ellipse& ellipse) const;
+
+  // Revisions of the input and output ellipses and number of triangles the vertices were built with.
+  quint64 _cachedInputRevision;
+  quint64 _cachedOutputRevision;
+  int _nTriangles;
 };
 
 }
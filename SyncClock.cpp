@@ -0,0 +1,169 @@
+/*
+ * SyncClock.cpp
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SyncClock.h"
+
+#include <QtGlobal>
+#include <QDebug>
+
+// GStreamer includes.
+#include <gst/gst.h>
+#include <gst/net/gstnet.h>
+
+namespace mmp {
+
+// Instances only talk to each other on this machine.
+static const gchar* SYNC_ADDRESS = "127.0.0.1";
+
+const qreal SyncClock::MAX_LATENESS = 0.25;
+
+SyncClock::Mode SyncClock::_mode = SyncClock::OFF;
+GstClock* SyncClock::_clock = NULL;
+GstNetTimeProvider* SyncClock::_provider = NULL;
+GstBus* SyncClock::_bus = NULL;
+qreal SyncClock::_roundTripTime = -1;
+qreal SyncClock::_clockOffset = 0;
+
+bool SyncClock::start(Mode mode, int port)
+{
+  stop();
+  if (mode == OFF)
+    return true;
+
+  if (mode == MASTER)
+  {
+    // Publish the system clock.
+    _clock = gst_system_clock_obtain();
+    _provider = gst_net_time_provider_new(_clock, SYNC_ADDRESS, port);
+    if (!_provider)
+    {
+      qWarning() << "Cannot publish sync clock on port " << port << "." << endl;
+      stop();
+      return false;
+    }
+    _roundTripTime = 0;
+  }
+  else
+  {
+    // Follow the master's clock.
+    _clock = gst_net_client_clock_new("mapmap-sync-clock", SYNC_ADDRESS, port, 0);
+    if (!_clock)
+    {
+      qWarning() << "Cannot create sync clock on port " << port << "." << endl;
+      stop();
+      return false;
+    }
+
+    // Get statistics about the synchronization.
+    _bus = gst_bus_new();
+    g_object_set(_clock, "bus", _bus, NULL);
+  }
+
+  _mode = mode;
+  qDebug() << "Sync clock started as " << (mode == MASTER ? "master" : "slave")
+           << " on port " << port << "." << endl;
+  return true;
+}
+
+void SyncClock::stop()
+{
+  if (_provider)
+  {
+    gst_object_unref(_provider);
+    _provider = NULL;
+  }
+  if (_bus)
+  {
+    if (_clock)
+      g_object_set(_clock, "bus", NULL, NULL);
+    gst_object_unref(_bus);
+    _bus = NULL;
+  }
+  if (_clock)
+  {
+    gst_object_unref(_clock);
+    _clock = NULL;
+  }
+  _mode = OFF;
+  _roundTripTime = -1;
+  _clockOffset = 0;
+}
+
+bool SyncClock::isSynchronized()
+{
+  return (_clock != NULL && gst_clock_is_synced(_clock));
+}
+
+quint64 SyncClock::now()
+{
+  GstClock* clock = (_clock ? (GstClock*) gst_object_ref(_clock) : gst_system_clock_obtain());
+  GstClockTime time = gst_clock_get_time(clock);
+  gst_object_unref(clock);
+  return time;
+}
+
+int SyncClock::msecsToNextTick(qreal framesPerSecond)
+{
+  if (framesPerSecond <= 0)
+    return 0;
+
+  quint64 period = quint64(GST_SECOND / framesPerSecond);
+  quint64 remaining = period - now() % period;
+  return qMax(int((remaining + GST_MSECOND / 2) / GST_MSECOND), 1);
+}
+
+void SyncClock::update()
+{
+  if (!_clock)
+    return;
+
+  // Instances run on the same machine, hence on the same system clock: the difference
+  // between the shared clock and the system clock is the error of the shared clock.
+  GstClock* systemClock = gst_system_clock_obtain();
+  _clockOffset = (qreal) GST_CLOCK_DIFF(gst_clock_get_time(systemClock), gst_clock_get_time(_clock)) / GST_SECOND;
+  gst_object_unref(systemClock);
+
+  if (!_bus)
+    return;
+
+  GstMessage* msg;
+  while ((msg = gst_bus_pop_filtered(_bus, GST_MESSAGE_ELEMENT)) != NULL)
+  {
+    const GstStructure* stats = gst_message_get_structure(msg);
+    guint64 rtt;
+    if (stats && gst_structure_has_name(stats, "gst-netclock-statistics") &&
+        gst_structure_get_uint64(stats, "rtt-average", &rtt))
+      _roundTripTime = (qreal) rtt / GST_SECOND;
+    gst_message_unref(msg);
+  }
+}
+
+bool SyncClock::modeFromString(const QString& name, Mode* mode)
+{
+  QString lower = name.trimmed().toLower();
+  if (lower == "off")
+    *mode = OFF;
+  else if (lower == "master")
+    *mode = MASTER;
+  else if (lower == "slave")
+    *mode = SLAVE;
+  else
+    return false;
+  return true;
+}
+
+}
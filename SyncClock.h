@@ -0,0 +1,109 @@
+/*
+ * SyncClock.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SYNC_CLOCK_H_
+#define SYNC_CLOCK_H_
+
+#include <QString>
+
+#include "MM.h"
+
+// Avoids including GStreamer headers in the whole project.
+typedef struct _GstClock GstClock;
+typedef struct _GstBus GstBus;
+typedef struct _GstNetTimeProvider GstNetTimeProvider;
+
+namespace mmp {
+
+/**
+ * Clock shared by several MapMap instances running on the same machine, so that their
+ * videos play frame-locked (eg. one instance per projector).
+ *
+ * One instance is the master: it publishes its clock on the loopback interface (GStreamer
+ * network time provider). The others are slaves: they follow the master's clock. All video
+ * pipelines of all instances then run on that clock, and the position of every (seekable)
+ * video is locked to the shared timeline (clock time modulo duration of the video). Render
+ * ticks are aligned on the same timeline.
+ *
+ * Synchronization is off unless start() is called (see command line options).
+ */
+class SyncClock
+{
+public:
+  enum Mode {
+    OFF,
+    MASTER,
+    SLAVE
+  };
+
+  /// Starts synchronization in given mode using given (UDP) port. Returns false on error.
+  static bool start(Mode mode, int port=MM::DEFAULT_SYNC_PORT);
+
+  /// Stops synchronization (already created pipelines keep the shared clock).
+  static void stop();
+
+  static Mode mode() { return _mode; }
+  static bool isActive() { return _mode != OFF; }
+
+  /// Returns true iff the shared clock can be relied upon (always true for master).
+  static bool isSynchronized();
+
+  /// Current time on the shared clock (in nanoseconds).
+  static quint64 now();
+
+  /// The shared clock, to be used by pipelines (NULL if inactive).
+  static GstClock* clock() { return _clock; }
+
+  /// Number of milliseconds until the next render tick of the shared timeline at given frame rate.
+  static int msecsToNextTick(qreal framesPerSecond);
+
+  /**
+   * Reads the statistics posted by the slave clock. Should be called regularly
+   * (from the main thread).
+   */
+  static void update();
+
+  /// Average round-trip time to the master (in seconds; 0 for master, -1 if unknown).
+  static qreal getRoundTripTime() { return _roundTripTime; }
+
+  /// Offset of the local clock with respect to the master clock (in seconds).
+  static qreal getClockOffset() { return _clockOffset; }
+
+  /// Parses a mode name ("off", "master" or "slave"). Returns false if invalid.
+  static bool modeFromString(const QString& name, Mode* mode);
+
+  /// Time given to pipelines to seek before the position they seek to is reached (in ns).
+  static const quint64 SEEK_LEAD = 250000000LL;
+
+  /// Minimum time given to pipelines to seek back to the start of a clip when looping (in ns).
+  static const quint64 MIN_SEEK_LEAD = 20000000LL;
+
+  /// Lateness of a video (in seconds) above which its position is locked again.
+  static const qreal MAX_LATENESS;
+
+private:
+  static Mode _mode;
+  static GstClock* _clock;
+  static GstNetTimeProvider* _provider;
+  static GstBus* _bus;
+  static qreal _roundTripTime;
+  static qreal _clockOffset;
+};
+
+}
+
+#endif /* SYNC_CLOCK_H_ */
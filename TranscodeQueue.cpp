@@ -0,0 +1,306 @@
+/*
+ * TranscodeQueue.cpp
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TranscodeQueue.h"
+
+#include <QRunnable>
+#include <QThread>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QStandardPaths>
+#include <QDebug>
+
+// GStreamer includes.
+#include <gst/gst.h>
+
+namespace mmp {
+
+/**
+ * One conversion, run on a worker thread.
+ */
+class TranscodeJob : public QRunnable
+{
+public:
+  TranscodeJob(TranscodeQueue* queue, int id, int tag, const QString& sourceUri,
+               const QString& destinationFile, const QSize& size, int generation) :
+    _queue(queue), _id(id), _tag(tag), _sourceUri(sourceUri), _destinationFile(destinationFile),
+    _size(size), _generation(generation),
+    _pipeline(NULL), _muxer(NULL), _hasVideo(false), _hasAudio(false)
+  {}
+
+  virtual void run();
+
+  static void gstPadAddedCallback(GstElement *src, GstPad *newPad, TranscodeJob* job);
+
+private:
+  // Runs the pipeline until the end. Returns false (and sets error) on failure.
+  bool _transcode(const QString& outputFile, QString* error);
+
+  // Creates elements, adds them to the pipeline and links them (then to the muxer).
+  bool _addBranch(GstPad* srcPad, const QList<GstElement*>& elements);
+
+  bool _isCancelled() const { return _queue->_cancelGeneration.load() != _generation; }
+
+  TranscodeQueue* _queue;
+  int _id;
+  int _tag;
+  QString _sourceUri;
+  QString _destinationFile;
+  QSize _size;
+  int _generation;
+
+  GstElement* _pipeline;
+  GstElement* _muxer;
+  bool _hasVideo;
+  bool _hasAudio;
+};
+
+void TranscodeJob::run()
+{
+  QString error;
+  QString partFile = _destinationFile + ".part";
+
+  if (_isCancelled())
+    error = QObject::tr("cancelled");
+
+  // Write to a temporary file so that a partial file is never mistaken for a finished one.
+  else if (_transcode(partFile, &error))
+  {
+    QFile::remove(_destinationFile);
+    if (!QFile::rename(partFile, _destinationFile))
+      error = QObject::tr("cannot rename %1").arg(partFile);
+  }
+
+  if (!error.isEmpty())
+  {
+    QFile::remove(partFile);
+    emit _queue->jobFailed(_id, _tag, _sourceUri, error);
+  }
+  else
+    emit _queue->jobFinished(_id, _tag, _sourceUri, _destinationFile);
+
+  _queue->_nPendingJobs.deref();
+}
+
+bool TranscodeJob::_transcode(const QString& outputFile, QString* error)
+{
+  // Process URI.
+  QByteArray source = _sourceUri.toUtf8();
+  gchar* uri = NULL;
+  if (gst_uri_is_valid(source.constData()))
+    uri = g_strdup(source.constData());
+  else
+    uri = gst_filename_to_uri(source.constData(), NULL);
+  if (!uri)
+  {
+    *error = QObject::tr("invalid URI");
+    return false;
+  }
+
+  // Build the static part of the pipeline: decoder, muxer and file sink.
+  _pipeline = gst_pipeline_new(NULL);
+  GstElement* decoder = gst_element_factory_make("uridecodebin", NULL);
+  _muxer = gst_element_factory_make("qtmux", NULL);
+  GstElement* sink = gst_element_factory_make("filesink", NULL);
+  if (!_pipeline || !decoder || !_muxer || !sink)
+  {
+    *error = QObject::tr("not all elements could be created");
+    if (_pipeline) gst_object_unref(_pipeline);
+    if (decoder) gst_object_unref(decoder);
+    if (_muxer) gst_object_unref(_muxer);
+    if (sink) gst_object_unref(sink);
+    g_free(uri);
+    return false;
+  }
+
+  g_object_set(decoder, "uri", uri, NULL);
+  g_object_set(sink, "location", QFile::encodeName(outputFile).constData(), NULL);
+  g_free(uri);
+
+  gst_bin_add_many(GST_BIN(_pipeline), decoder, _muxer, sink, NULL);
+  gst_element_link(_muxer, sink);
+  g_signal_connect(decoder, "pad-added", G_CALLBACK(TranscodeJob::gstPadAddedCallback), this);
+
+  if (gst_element_set_state(_pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+    *error = QObject::tr("cannot start pipeline");
+
+  // Run until end-of-stream or error, reporting progress.
+  GstBus* bus = gst_element_get_bus(_pipeline);
+  while (error->isEmpty())
+  {
+    GstMessage* msg = gst_bus_timed_pop_filtered(bus, TranscodeQueue::PROGRESS_INTERVAL * GST_MSECOND,
+                                                 GstMessageType(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    if (msg)
+    {
+      if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR)
+      {
+        GError* err = NULL;
+        gst_message_parse_error(msg, &err, NULL);
+        *error = (err ? QString(err->message) : QObject::tr("unknown error"));
+        g_clear_error(&err);
+      }
+      gst_message_unref(msg);
+      break;
+    }
+
+    if (_isCancelled())
+    {
+      *error = QObject::tr("cancelled");
+      break;
+    }
+
+    gint64 position, duration;
+    if (gst_element_query_position(_pipeline, GST_FORMAT_TIME, &position) &&
+        gst_element_query_duration(_pipeline, GST_FORMAT_TIME, &duration) && duration > 0)
+      emit _queue->jobProgress(_id, _tag, qBound(0.0, qreal(position) / duration, 1.0));
+  }
+
+  if (error->isEmpty() && !_hasVideo)
+    *error = QObject::tr("no video stream");
+
+  gst_element_set_state(_pipeline, GST_STATE_NULL);
+  gst_object_unref(bus);
+  gst_object_unref(_pipeline);
+  _pipeline = _muxer = NULL;
+
+  return error->isEmpty();
+}
+
+void TranscodeJob::gstPadAddedCallback(GstElement *src, GstPad *newPad, TranscodeJob* job)
+{
+  Q_UNUSED(src);
+
+  GstCaps *caps = gst_pad_query_caps(newPad, NULL);
+  const gchar *type = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+
+  // Video: scale and encode every frame as a JPEG.
+  if (g_str_has_prefix(type, "video/x-raw") && !job->_hasVideo)
+  {
+    GstElement* scaleCaps = gst_element_factory_make("capsfilter", NULL);
+    GstElement* encoder   = gst_element_factory_make("jpegenc", NULL);
+    if (scaleCaps && encoder)
+    {
+      GstCaps* size = gst_caps_new_simple("video/x-raw",
+                                          "width",  G_TYPE_INT, job->_size.width(),
+                                          "height", G_TYPE_INT, job->_size.height(),
+                                          "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1,
+                                          NULL);
+      g_object_set(scaleCaps, "caps", size, NULL);
+      gst_caps_unref(size);
+      g_object_set(encoder, "quality", TranscodeQueue::JPEG_QUALITY, NULL);
+    }
+
+    job->_hasVideo = job->_addBranch(newPad, QList<GstElement*>()
+                                     << gst_element_factory_make("queue", NULL)
+                                     << gst_element_factory_make("videoconvert", NULL)
+                                     << gst_element_factory_make("videoscale", NULL)
+                                     << scaleCaps
+                                     << encoder);
+  }
+
+  // Audio: keep it uncompressed (cheap to decode).
+  else if (g_str_has_prefix(type, "audio/x-raw") && !job->_hasAudio)
+  {
+    job->_hasAudio = job->_addBranch(newPad, QList<GstElement*>()
+                                     << gst_element_factory_make("queue", NULL)
+                                     << gst_element_factory_make("audioconvert", NULL)
+                                     << gst_element_factory_make("audioresample", NULL));
+  }
+
+  gst_caps_unref(caps);
+}
+
+bool TranscodeJob::_addBranch(GstPad* srcPad, const QList<GstElement*>& elements)
+{
+  // Verify that all elements were created.
+  if (elements.contains(NULL))
+  {
+    qWarning() << "Not all transcoding elements could be created." << endl;
+    foreach (GstElement* element, elements)
+      if (element)
+        gst_object_unref(element);
+    return false;
+  }
+
+  foreach (GstElement* element, elements)
+    gst_bin_add(GST_BIN(_pipeline), element);
+
+  // Link elements together then to the muxer (which provides the appropriate request pad).
+  bool linked = true;
+  for (int i=0; i<elements.size() - 1; i++)
+    linked = linked && gst_element_link(elements[i], elements[i+1]);
+  linked = linked && gst_element_link(elements.last(), _muxer);
+
+  GstPad* sinkPad = gst_element_get_static_pad(elements.first(), "sink");
+  linked = linked && !GST_PAD_LINK_FAILED(gst_pad_link(srcPad, sinkPad));
+  gst_object_unref(sinkPad);
+
+  foreach (GstElement* element, elements)
+    gst_element_sync_state_with_parent(element);
+
+  if (!linked)
+    qWarning() << "Could not link transcoding branch." << endl;
+  return linked;
+}
+
+TranscodeQueue::TranscodeQueue(QObject* parent) :
+  QObject(parent),
+  _nPendingJobs(0),
+  _cancelGeneration(0),
+  _nextJobId(0)
+{
+  // Leave most of the CPUs to playback.
+  setMaxWorkers(QThread::idealThreadCount() / 4);
+}
+
+TranscodeQueue::~TranscodeQueue()
+{
+  cancelAll();
+  _pool.waitForDone();
+}
+
+int TranscodeQueue::enqueue(const QString& sourceUri, const QString& destinationFile, const QSize& size, int tag)
+{
+  int id = _nextJobId++;
+  _nPendingJobs.ref();
+  _pool.start(new TranscodeJob(this, id, tag, sourceUri, destinationFile, size, _cancelGeneration.load()));
+  return id;
+}
+
+void TranscodeQueue::cancelAll()
+{
+  _cancelGeneration.ref();
+}
+
+QString TranscodeQueue::intermediateFileName(const QString& sourceUri, const QSize& size)
+{
+  QFileInfo source(sourceUri);
+  QString fileName = QString("%1_mmp_%2x%3.mov").arg(source.completeBaseName()).arg(size.width()).arg(size.height());
+
+  // Next to the source if possible.
+  QFileInfo directory(source.absolutePath());
+  if (directory.isDir() && directory.isWritable())
+    return QDir(source.absolutePath()).filePath(fileName);
+
+  // Otherwise in the cache.
+  QDir cache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+  cache.mkpath(".");
+  return cache.filePath(fileName);
+}
+
+}
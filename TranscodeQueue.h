@@ -0,0 +1,93 @@
+/*
+ * TranscodeQueue.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRANSCODE_QUEUE_H_
+#define TRANSCODE_QUEUE_H_
+
+#include <QObject>
+#include <QString>
+#include <QSize>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+#include "MM.h"
+
+namespace mmp {
+
+/**
+ * Background queue that converts media files into an intra-frame intermediate
+ * (Motion JPEG + PCM audio in a QuickTime container) at a given resolution.
+ * Intra-only files can be seeked instantly and have a predictable decoding cost.
+ *
+ * Jobs run on a pool of worker threads, each using its own GStreamer pipeline.
+ * Signals are emitted from worker threads (use queued connections).
+ */
+class TranscodeQueue : public QObject
+{
+  Q_OBJECT
+
+public:
+  TranscodeQueue(QObject* parent=0);
+  virtual ~TranscodeQueue();
+
+  /**
+   * Queues the conversion of a media file to given size. The (optional) tag is sent back with
+   * the signals (eg. the id of the paint using the media). Returns the job id.
+   */
+  int enqueue(const QString& sourceUri, const QString& destinationFile, const QSize& size, int tag=0);
+
+  /// Cancels all pending and running jobs (running jobs are stopped as soon as possible).
+  void cancelAll();
+
+  /// Number of jobs not yet finished.
+  int nPendingJobs() const { return _nPendingJobs.load(); }
+
+  /// Maximum number of jobs running at the same time.
+  void setMaxWorkers(int nWorkers) { _pool.setMaxThreadCount(qMax(nWorkers, 1)); }
+  int getMaxWorkers() const { return _pool.maxThreadCount(); }
+
+  /// Returns a file name for the intermediate of a media file (in the same directory if writable).
+  static QString intermediateFileName(const QString& sourceUri, const QSize& size);
+
+  /// Quality of JPEG frames (0-100).
+  static const int JPEG_QUALITY = 85;
+
+  /// Interval at which progress is reported (in ms).
+  static const int PROGRESS_INTERVAL = 250;
+
+signals:
+  /// Progress of a job (from 0 to 1).
+  void jobProgress(int jobId, int tag, qreal progress);
+
+  /// A job has finished successfully: the intermediate is available.
+  void jobFinished(int jobId, int tag, const QString& sourceUri, const QString& destinationFile);
+
+  /// A job has failed (or was cancelled).
+  void jobFailed(int jobId, int tag, const QString& sourceUri, const QString& error);
+
+private:
+  friend class TranscodeJob;
+
+  QThreadPool _pool;
+  QAtomicInt  _nPendingJobs;
+  QAtomicInt  _cancelGeneration; // jobs created before the last cancelAll() are stopped
+  int _nextJobId;
+};
+
+}
+
+#endif /* TRANSCODE_QUEUE_H_ */
@@ -25,6 +25,8 @@
 #include <QDir>
 #include <iostream>
 #include <QRegExp>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
 
 namespace mmp {
 
@@ -37,10 +39,11 @@ void correctGlTexCoord(GLfloat x, GLfloat y)
 
 void setGlTexPoint(const Texture& texture, const QPointF& inputPoint, const QPointF& outputPoint)
 {
-  // Set point in texture.
+  // Set point in texture (relative to the region actually covered by the bits).
+  QRect bitsRect = texture.getBitsRect();
   correctGlTexCoord(
-    (inputPoint.x() - texture.getX()) / (GLfloat) texture.getWidth(),
-    (inputPoint.y() - texture.getY()) / (GLfloat) texture.getHeight());
+    (inputPoint.x() - texture.getX() - bitsRect.x()) / (GLfloat) bitsRect.width(),
+    (inputPoint.y() - texture.getY() - bitsRect.y()) / (GLfloat) bitsRect.height());
   // Add point in output.
   glVertex2f(
     outputPoint.x(),
@@ -48,6 +51,41 @@ void setGlTexPoint(const Texture& texture, const QPointF& inputPoint, const QPoi
   );
 }
 
+/**
+ * Uploads the bits of a texture to the currently bound GL_TEXTURE_2D, using its compressed
+ * version if there is one and the driver supports it.
+ */
+void uploadTextureBits(Texture& texture)
+{
+  // NOTE: Bits need to be fetched first since they determine the region they cover.
+  const uchar* bits = texture.getBits();
+  QRect bitsRect = texture.getBitsRect();
+
+  GLenum compressedFormat = 0;
+  int compressedSize = 0;
+  const uchar* compressedBits = texture.getCompressedBits(&compressedFormat, &compressedSize);
+  if (compressedBits && hasS3tcTextureCompression())
+  {
+    QOpenGLContext::currentContext()->functions()->glCompressedTexImage2D(
+          GL_TEXTURE_2D, 0, compressedFormat,
+          bitsRect.width(), bitsRect.height(), 0,
+          compressedSize, compressedBits);
+  }
+  else
+  {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
+                 bitsRect.width(), bitsRect.height(), 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, bits);
+  }
+}
+
+/// Returns true iff the current OpenGL context supports S3TC (BC1/BC3) compressed textures.
+bool hasS3tcTextureCompression()
+{
+  QOpenGLContext* context = QOpenGLContext::currentContext();
+  return (context && context->hasExtension("GL_EXT_texture_compression_s3tc"));
+}
+
 /**
  * Convenience function to map a variable from one coordinate space
  * to another.
@@ -49,6 +49,15 @@ void correctGlTexCoord(GLfloat x, GLfloat y);
  */
 void setGlTexPoint(const Texture& texture, const QPointF& inputPoint, const QPointF& outputPoint);
 
+/**
+ * Uploads the bits of a texture to the currently bound GL_TEXTURE_2D, using its compressed
+ * version if there is one and the driver supports it.
+ */
+void uploadTextureBits(Texture& texture);
+
+/// Returns true iff the current OpenGL context supports S3TC (BC1/BC3) compressed textures.
+bool hasS3tcTextureCompression();
+
 /**
  * Maps a number from a range to another.
  */
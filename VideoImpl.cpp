@@ -22,11 +22,30 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "VideoImpl.h"
+#include "SyncClock.h"
 #include <cstring>
+#include <cmath>
+#include <QThread>
 #include <iostream>
 
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 namespace mmp {
 
+qreal VideoImpl::_defaultMaxFramesPerSecond = MM::DEFAULT_FRAMES_PER_SECOND;
+
+int VideoImpl::_defaultDecoderThreads   = MM::DEFAULT_DECODER_THREADS;
+int VideoImpl::_defaultConverterThreads = MM::DEFAULT_CONVERTER_THREADS;
+int VideoImpl::_defaultThreadPriority   = MM::DEFAULT_THREAD_PRIORITY;
+QString VideoImpl::_defaultCpuSet       = MM::DEFAULT_CPU_SET;
+int VideoImpl::_nSchedulerSlots = 0;
+
 // -------- private implementation of VideoImpl -------
 
 bool VideoImpl::hasVideoSupport()
@@ -61,10 +80,18 @@ const uchar* VideoImpl::getBits()
   // Reset bits changed.
   _bitsChanged = false;
 
+  // Remember which region of the frame these bits correspond to.
+  _currentBitsRect = _sampleBitsRect;
+
   // Return data.
   return (hasBits() ? _data : NULL);
 }
 
+QRect VideoImpl::getBitsRect() const
+{
+  return (_currentBitsRect.isNull() ? QRect(0, 0, _width, _height) : _currentBitsRect);
+}
+
 QString VideoImpl::getUri() const
 {
   return _uri;
@@ -107,6 +134,38 @@ void VideoImpl::setVolume(double volume)
   }
 }
 
+void VideoImpl::setMaxFramesPerSecond(qreal fps)
+{
+  if (fps <= 0)
+  {
+    qDebug() << "Cannot set max frames per second to " << fps << ", ignoring." << endl;
+    return;
+  }
+
+  // Only update if needed.
+  if (_maxFramesPerSecond != fps)
+  {
+    _maxFramesPerSecond = fps;
+    _updateMaxFramesPerSecond();
+  }
+}
+
+void VideoImpl::setCropRect(const QRect& rect)
+{
+  // Only update crop if needed.
+  if (_cropRect != rect)
+  {
+    _cropRect = rect;
+    _updateCrop();
+  }
+}
+
+void VideoImpl::setDefaultMaxFramesPerSecond(qreal fps)
+{
+  if (fps > 0)
+    _defaultMaxFramesPerSecond = fps;
+}
+
 void VideoImpl::build()
 {
   qDebug() << "Building video impl";
@@ -158,12 +217,11 @@ GstFlowReturn VideoImpl::gstNewSampleCallback(GstElement*, VideoImpl *p)
 
   // Get next frame.
   GstSample *sample = gst_app_sink_pull_sample(GST_APP_SINK(p->_appsink0));
-
-  // Unref last frame.
-  p->_freeCurrentSample();
-
-  // Set current frame.
-  p->_currentFrameSample = sample;
+  if (sample == NULL)
+  {
+    p->unlockMutex();
+    return GST_FLOW_OK;
+  }
 
   // For live sources, video dimensions have not been set, because
   // gstPadAddedCallback is never called. Fix dimensions from first sample /
@@ -177,20 +235,52 @@ GstFlowReturn VideoImpl::gstNewSampleCallback(GstElement*, VideoImpl *p)
     gst_structure_get_int(structure, "height", &p->_height);
   }
 
-  // Try to retrieve data bits of frame.
-  GstMapInfo& map = p->_mapInfo;
-  GstBuffer *buffer = gst_sample_get_buffer( sample );
-  if (gst_buffer_map(buffer, &map, GST_MAP_READ))
+  // Frames are flowing again (eg. after looping back).
+  p->_reachedEnd = false;
+
+  QueuedSample queued;
+  queued.sample = sample;
+
+  // Retrieve the region of the frame covered by this sample (the frame might be cropped).
   {
-    p->_currentFrameBuffer = buffer;
-    // For debugging:
-    //gst_util_dump_mem(map.data, map.size)
+    gint sampleWidth  = p->_width;
+    gint sampleHeight = p->_height;
+    GstStructure *structure = gst_caps_get_structure(gst_sample_get_caps(sample), 0);
+    gst_structure_get_int(structure, "width",  &sampleWidth);
+    gst_structure_get_int(structure, "height", &sampleHeight);
+
+    // Elements downstream of the cropper run in this same streaming thread: the crop applied
+    // last is the one of this sample.
+    queued.bitsRect = QRect(p->_appliedCropOffset, QSize(sampleWidth, sampleHeight));
+  }
 
-    // Retrieve data from map info.
-    p->_data = map.data;
+  // Retrieve presentation time of the frame (in running time, so that rate and seeking are accounted for).
+  queued.runningTime = GST_CLOCK_TIME_NONE;
+  queued.duration    = GST_CLOCK_TIME_NONE;
+  GstBuffer *buffer = gst_sample_get_buffer(sample);
+  GstSegment *segment = gst_sample_get_segment(sample);
+  if (buffer && segment && GST_BUFFER_PTS_IS_VALID(buffer))
+  {
+    queued.runningTime = gst_segment_to_running_time(segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+    queued.duration    = GST_BUFFER_DURATION(buffer);
+  }
 
-    // Bits have changed.
-    p->_bitsChanged = true;
+  // Insert in jitter buffer, ordered by presentation time (samples without a time go last).
+  int i = p->_frameQueue.size();
+  if (GST_CLOCK_TIME_IS_VALID(queued.runningTime))
+  {
+    while (i > 0 &&
+           (!GST_CLOCK_TIME_IS_VALID(p->_frameQueue[i-1].runningTime) ||
+            p->_frameQueue[i-1].runningTime > queued.runningTime))
+      i--;
+  }
+  p->_frameQueue.insert(i, queued);
+
+  // Buffer full: oldest frame will never be displayed.
+  while (p->_frameQueue.size() > FRAME_QUEUE_SIZE)
+  {
+    gst_sample_unref(p->_frameQueue.takeFirst().sample);
+    p->_nSkippedFrames++;
   }
 
   p->unlockMutex();
@@ -198,9 +288,37 @@ GstFlowReturn VideoImpl::gstNewSampleCallback(GstElement*, VideoImpl *p)
   return GST_FLOW_OK;
 }
 
+GstPadProbeReturn VideoImpl::gstCropProbeCallback(GstPad *pad, GstPadProbeInfo *info, VideoImpl* p)
+{
+  Q_UNUSED(pad);
+  Q_UNUSED(info);
+
+  p->lockMutex();
+  bool pending = p->_cropPending;
+  QRect crop = p->_pendingCrop;
+  p->_cropPending = false;
+  p->unlockMutex();
+
+  // Cropper reconfigures itself before processing the buffer.
+  if (pending)
+  {
+    g_object_set (p->_videocrop0,
+                  "left",   crop.left(),
+                  "top",    crop.top(),
+                  "right",  p->_width  - (crop.left() + crop.width()),
+                  "bottom", p->_height - (crop.top()  + crop.height()),
+                  NULL);
+    p->_appliedCropOffset = crop.topLeft();
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
 VideoImpl::VideoImpl() :
 _pipeline(NULL),
 _queue0(NULL),
+_videorate0(NULL),
+_videocrop0(NULL),
 _videoconvert0(NULL),
 _capsfilter0(NULL),
 _videoscale0(NULL),
@@ -210,6 +328,8 @@ _audioconvert0(NULL),
 _audioresample0(NULL),
 _audiovolume0(NULL),
 _audiosink0(NULL),
+_audiolevel0(NULL),
+_audiospectrum0(NULL),
 _bus(NULL),
 _currentFrameSample(NULL),
 _currentFrameBuffer(NULL),
@@ -221,6 +341,23 @@ _duration(0),
 _data(NULL),
 _seekEnabled(false),
 _rate(1.0),
+_maxFramesPerSecond(_defaultMaxFramesPerSecond),
+_decoderThreads(0),
+_converterThreads(0),
+_threadPriority(0),
+_cpuSet(""),
+_schedulerSlot(_nSchedulerSlots++),
+_nRepeatedFrames(0),
+_nSkippedFrames(0),
+_currentFrameEnd(GST_CLOCK_TIME_NONE),
+_lateness(0),
+_usesSyncClock(false),
+_syncLocked(false),
+_audioAnalysisEnabled(false),
+_looping(true),
+_reachedEnd(false),
+_nLoops(0),
+_cropPending(false),
 _movieReady(false),
 _playState(false),
 _uri("")
@@ -260,6 +397,8 @@ void VideoImpl::freeResources()
 
   // Free all components.
   _freeElement(&_queue0);
+  _freeElement(&_videorate0);
+  _freeElement(&_videocrop0);
   _freeElement(&_capsfilter0);
   _freeElement(&_videoscale0);
   _freeElement(&_videoconvert0);
@@ -270,14 +409,27 @@ void VideoImpl::freeResources()
   _freeElement(&_audioresample0);
   _freeElement(&_audiovolume0);
   _freeElement(&_audiosink0);
+  _freeElement(&_audiolevel0);
+  _freeElement(&_audiospectrum0);
 
   qDebug() << "Freeing remaining samples/buffers" << endl;
 
   // Frees current sample and buffer.
   _freeCurrentSample();
+  _clearFrameQueue();
+  _nRepeatedFrames = _nSkippedFrames = 0;
+  _currentFrameEnd = GST_CLOCK_TIME_NONE;
+  _lateness = 0;
+  _usesSyncClock = _syncLocked = false;
+  _reachedEnd = false;
+  _nLoops = 0;
+  _audioAnalysis.reset();
 
   // Reset other informations.
   _bitsChanged = false;
+  _sampleBitsRect = _currentBitsRect = _cropRect = _pendingCrop = QRect();
+  _cropPending = false;
+  _appliedCropOffset = QPoint();
   _width = _height = (-1);
   _duration = 0;
   _videoIsConnected = false;
@@ -288,7 +440,9 @@ void VideoImpl::resetMovie()
 {
   if (_seekEnabled)
   {
-    if (_rate > 0)
+    if (_syncLocked)
+      _lockToSyncClock();
+    else if (_rate > 0)
       seekTo((guint64)0);
     else
     {
@@ -312,17 +466,21 @@ bool VideoImpl::createVideoComponents()
 
   // Create the video elements.
   _queue0 = gst_element_factory_make ("queue", "queue0");
+  _videorate0 = gst_element_factory_make ("videorate", "videorate0");
+  _videocrop0 = gst_element_factory_make ("videocrop", "videocrop0");
   _videoconvert0 = gst_element_factory_make ("videoconvert", "videoconvert0");
   _videoscale0 = gst_element_factory_make ("videoscale", "videoscale0");
   _capsfilter0 = gst_element_factory_make ("capsfilter", "capsfilter0");
   _appsink0 = gst_element_factory_make ("appsink", "appsink0");
 
   // Verify that they were created.
-  if (!_queue0 || !_videoconvert0 || ! _videoscale0 || ! _capsfilter0 || !_appsink0)
+  if (!_queue0 || !_videorate0 || !_videocrop0 || !_videoconvert0 || ! _videoscale0 || ! _capsfilter0 || !_appsink0)
   {
     qWarning() << "Not all video elements could be created." << endl;
     if (! _pipeline) g_printerr("_pipeline");
     if (! _queue0) g_printerr("_queue0");
+    if (! _videorate0) g_printerr("_videorate0");
+    if (! _videocrop0) g_printerr("_videocrop0");
     if (! _videoconvert0) g_printerr("_videoconvert0");
     if (! _videoscale0) g_printerr("videoscale0");
     if (! _capsfilter0) g_printerr("capsfilter0");
@@ -332,16 +490,33 @@ bool VideoImpl::createVideoComponents()
 
   // Add them to pipeline.
   gst_bin_add_many (GST_BIN (_pipeline),
-                    _queue0, _videoconvert0, _videoscale0, _capsfilter0, _appsink0,
+                    _queue0, _videorate0, _videocrop0, _videoconvert0, _videoscale0, _capsfilter0, _appsink0,
                     NULL);
 
   // Link.
-  if (! gst_element_link_many (_queue0, _videoconvert0, _capsfilter0, _videoscale0, _appsink0, NULL))
+  // NOTE: The rate limiter and cropper come *before* the colorspace converter so that frames
+  // (and regions of frames) that will never be rendered are dropped before being converted.
+  if (! gst_element_link_many (_queue0, _videorate0, _videocrop0, _videoconvert0, _capsfilter0, _videoscale0, _appsink0, NULL))
   {
-    qWarning() << "Could not link video queue, colorspace converter, caps filter, scaler and app sink." << endl;
+    qWarning() << "Could not link video queue, rate limiter, cropper, colorspace converter, caps filter, scaler and app sink." << endl;
     return false;
   }
 
+  // Configure rate limiter: only drop frames (never duplicate them) and never let
+  // through more frames than what we can render.
+  g_object_set (_videorate0, "drop-only", TRUE, NULL);
+  _updateMaxFramesPerSecond();
+
+  // Configure number of colorspace conversion threads (only supported by recent versions of GStreamer).
+  int nConverterThreads = converterThreads();
+  if (nConverterThreads > 0)
+  {
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(_videoconvert0), "n-threads"))
+      g_object_set (_videoconvert0, "n-threads", (guint) nConverterThreads, NULL);
+    else
+      qWarning() << "Colorspace converter does not support multithreading: ignoring number of threads." << endl;
+  }
+
   // Configure video appsink.
   GstCaps *videoCaps = gst_caps_from_string ("video/x-raw,format=RGBA");
   g_object_set (_capsfilter0, "caps", videoCaps, NULL);
@@ -350,9 +525,16 @@ bool VideoImpl::createVideoComponents()
                            "max-buffers", 1,     // only one buffer (the last) is maintained in the queue
                            "drop", TRUE,         // ... other buffers are dropped
                            "sync", TRUE,
+                           "qos", TRUE,          // send QoS events upstream so that late frames are skipped by decoders
+                           "ts-offset", (gint64) -FRAME_QUEUE_LOOKAHEAD, // deliver samples early to fill the jitter buffer
                            NULL);
 
   g_signal_connect (_appsink0, "new-sample", G_CALLBACK (VideoImpl::gstNewSampleCallback), this);
+
+  // Crop is changed in between frames.
+  GstPad *cropPad = gst_element_get_static_pad (_videocrop0, "sink");
+  gst_pad_add_probe (cropPad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback) VideoImpl::gstCropProbeCallback, this, NULL);
+  gst_object_unref (cropPad);
   gst_caps_unref (videoCaps);
 
   return true;
@@ -383,17 +565,25 @@ bool VideoImpl::createAudioComponents()
     return false;
   }
 
+  // Analyze audio before volume is applied.
+  QList<GstElement*> elements;
+  elements << _audioqueue0 << _audioconvert0 << _audioresample0;
+  if (_audioAnalysisEnabled && AudioAnalysis::createTap(&_audiolevel0, &_audiospectrum0))
+    elements << _audiolevel0 << _audiospectrum0;
+  elements << _audiovolume0 << _audiosink0;
+
   // Add them to pipeline.
-  gst_bin_add_many (GST_BIN (_pipeline),
-                    _audioqueue0, _audioconvert0, _audioresample0, _audiovolume0, _audiosink0,
-                    NULL);
+  foreach (GstElement* element, elements)
+    gst_bin_add (GST_BIN (_pipeline), element);
 
   // Link.
-  if (! gst_element_link_many (_audioqueue0, _audioconvert0, _audioresample0,
-                               _audiovolume0, _audiosink0, NULL))
+  for (int i=0; i<elements.size() - 1; i++)
   {
-    qDebug() << "Could not link audio queue, converter, resampler and audio sink." << endl;
-    return false;
+    if (! gst_element_link (elements[i], elements[i+1]))
+    {
+      qDebug() << "Could not link audio queue, converter, resampler, analysis and audio sink." << endl;
+      return false;
+    }
   }
 
   // Configure audio appsink.
@@ -420,16 +610,30 @@ bool VideoImpl::createAudioComponents()
 void VideoImpl::update()
 {
   // Check for end-of-stream or terminate.
-  if (_eos() || _terminate)
+  if (_terminate)
   {
     _setFinished(true);
     resetMovie();
   }
+  else if (_eos())
+  {
+    _setFinished(true);
+    _endOfStream();
+  }
   else
   {
     _setFinished(false);
   }
 
+  // Lock position to the shared timeline (again if we fell behind).
+  if (_playState && _canSyncToClock() &&
+      (!_syncLocked || _lateness > SyncClock::MAX_LATENESS))
+  {
+    if (_syncLocked)
+      qDebug() << "Movie " << _uri << " is " << _lateness << "s late: locking it again to sync clock." << endl;
+    _lockToSyncClock();
+  }
+
 //  // Check if movie is ready and connected.
 //  if (!isReady())
 //  {
@@ -440,10 +644,14 @@ void VideoImpl::update()
   _checkMessages();
 }
 
+ bool VideoImpl::sourceExists(const QString& uri) const
+ {
+   return g_file_test(uri.toUtf8().constData(), G_FILE_TEST_EXISTS);
+ }
+
  bool VideoImpl::loadMovie(const QString& filename) {
    // Verify if file exists.
-   const gchar* filetestpath = (const gchar*) filename.toUtf8().constData();
-   if (FALSE == g_file_test(filetestpath, G_FILE_TEST_EXISTS))
+   if (!sourceExists(filename))
    {
      qDebug() << "File " << filename << " does not exist" << endl;
      return false;
@@ -480,6 +688,16 @@ void VideoImpl::update()
 
    //setVolume(0);
 
+   // Run on the clock shared with other instances. Base time is then set when position
+   // is locked to the shared timeline (see _lockToSyncClock()).
+   if (SyncClock::isActive())
+   {
+     gst_pipeline_use_clock(GST_PIPELINE(_pipeline), SyncClock::clock());
+     if (!isLive())
+       gst_element_set_start_time(_pipeline, GST_CLOCK_TIME_NONE);
+     _usesSyncClock = true;
+   }
+
    // Listen to the bus.
    _bus = gst_element_get_bus (_pipeline);
 
@@ -508,11 +726,104 @@ bool VideoImpl::setPlayState(bool play)
   }
   else
   {
+    // Time went on while paused: position must be locked again.
+    if (play && !_playState)
+      _syncLocked = false;
+
     _playState = play;
     return true;
   }
 }
 
+void VideoImpl::_endOfStream()
+{
+  // End already handled (end-of-stream is both polled and posted on the bus).
+  if (_reachedEnd)
+    return;
+
+  // Loop back (or stay on last frame).
+  if (_looping)
+  {
+    _nLoops++;
+    resetMovie();
+  }
+  _reachedEnd = true;
+}
+
+qint64 VideoImpl::getRemainingTime()
+{
+  if (_reachedEnd)
+    return 0;
+
+  gint64 position, duration;
+  if (!_pipeline || _rate == 0 ||
+      !gst_element_query_position (_pipeline, GST_FORMAT_TIME, &position) ||
+      !gst_element_query_duration (_pipeline, GST_FORMAT_TIME, &duration) || duration <= 0)
+    return (-1);
+
+  return (qint64) ((_rate > 0 ? qMax(duration - position, (gint64)0) : position) / qAbs(_rate));
+}
+
+bool VideoImpl::playIn(quint64 delay)
+{
+  if (_pipeline == NULL || !_isMovieReady())
+    return false;
+
+  // Fix the clock so that base time is not recomputed when the pipeline goes to playing.
+  GstClock* clock = gst_pipeline_get_clock(GST_PIPELINE(_pipeline));
+  if (clock)
+  {
+    gst_pipeline_use_clock(GST_PIPELINE(_pipeline), clock);
+    gst_element_set_start_time(_pipeline, GST_CLOCK_TIME_NONE);
+    gst_element_set_base_time(_pipeline, gst_clock_get_time(clock) + delay);
+    gst_object_unref(clock);
+  }
+
+  // Pipeline is prerolled: it goes to playing right away.
+  bool result = setPlayState(true);
+
+  // Position follows the (shared) clock from now on.
+  _syncLocked = _usesSyncClock;
+
+  // Base time is recomputed again when seeking (eg. when looping) unless synchronized.
+  if (clock && !_usesSyncClock)
+    gst_element_set_start_time(_pipeline, 0);
+
+  return result;
+}
+
+bool VideoImpl::_canSyncToClock()
+{
+  return (_usesSyncClock && _pipeline && !isLive() && _seekEnabled && _isMovieReady() && _rate == 1.0);
+}
+
+bool VideoImpl::_lockToSyncClock()
+{
+  gint64 duration;
+  if (!gst_element_query_duration (_pipeline, GST_FORMAT_TIME, &duration) || duration <= 0)
+    return false;
+
+  // Start playing from the position the shared timeline will have reached after seeking,
+  // or from the beginning if the timeline loops back before then.
+  quint64 start = SyncClock::now() + SyncClock::SEEK_LEAD;
+  quint64 position = start % duration;
+  if (position + SyncClock::MIN_SEEK_LEAD <= SyncClock::SEEK_LEAD)
+  {
+    start -= position;
+    position = 0;
+  }
+
+  // Running time zero (ie. position) will be reached at clock time start. Base time stays
+  // as is when the pipeline goes back to playing after the flushing seek (start time is none).
+  gst_element_set_base_time(_pipeline, start);
+  if (!seekTo((guint64)position))
+    return false;
+
+  _lateness = 0;
+  _syncLocked = true;
+  return true;
+}
+
 bool VideoImpl::seekTo(double position)
 {
   gint64 duration;
@@ -541,7 +852,9 @@ bool VideoImpl::seekTo(guint64 positionNanoSeconds)
 
     // Free the current sample and reset.
     _freeCurrentSample();
+    _clearFrameQueue();
     _bitsChanged = false;
+    _reachedEnd = false;
 
     // Seek to position.
     bool result = gst_element_seek_simple(
@@ -615,7 +928,7 @@ void VideoImpl::_checkMessages()
       // End-of-stream ////////////////////////////////////////
       case GST_MESSAGE_EOS:
         // Automatically loop back.
-        resetMovie();
+        _endOfStream();
 //        _terminate = true;
 //        _finish();
         break;
@@ -739,9 +1052,294 @@ void  VideoImpl::_updateRate()
     qWarning() << "Cannot perform seek event" << endl;
   }
 
+  // Flushing resets running time: buffered frames are now out of sync.
+  lockMutex();
+  _clearFrameQueue();
+  unlockMutex();
+
   qDebug() << "Current rate: " << _rate << "." << endl;
 }
 
+void VideoImpl::_updateMaxFramesPerSecond()
+{
+  if (_videorate0 == NULL)
+    return;
+
+  // Rate limiter only accepts integer rates: round up so as to never drop a frame that could be rendered.
+  gint maxRate = (gint) ceil(_maxFramesPerSecond);
+  g_object_set (_videorate0, "max-rate", maxRate, NULL);
+
+#ifdef VIDEO_IMPL_VERBOSE
+  qDebug() << "Max decoding rate: " << maxRate << " fps." << endl;
+#endif
+}
+
+void VideoImpl::_updateCrop()
+{
+  // Cannot crop until we know the frame dimensions.
+  if (_videocrop0 == NULL || _width <= 0 || _height <= 0)
+    return;
+
+  // Clip crop region to frame (null region means no cropping).
+  QRect frame(0, 0, _width, _height);
+  QRect crop = (_cropRect.isNull() ? frame : _cropRect.intersected(frame));
+  if (crop.isEmpty())
+    crop = frame;
+
+  // Applied from the streaming thread with the next frame (see gstCropProbeCallback()).
+  lockMutex();
+  _pendingCrop = crop;
+  _cropPending = true;
+  unlockMutex();
+}
+
+int VideoImpl::decoderThreads() const
+{
+  int nThreads = (_decoderThreads > 0 ? _decoderThreads : _defaultDecoderThreads);
+
+  // When spreading movies automatically, match the number of threads to the block of CPUs.
+  if (nThreads <= 0 && (_cpuSet.isEmpty() ? _defaultCpuSet : _cpuSet) == "auto")
+    nThreads = cpus().size();
+
+  return nThreads;
+}
+
+int VideoImpl::converterThreads() const
+{
+  return (_converterThreads > 0 ? _converterThreads : _defaultConverterThreads);
+}
+
+int VideoImpl::threadPriority() const
+{
+  return (_threadPriority != 0 ? _threadPriority : _defaultThreadPriority);
+}
+
+QList<int> VideoImpl::cpus() const
+{
+  QString cpuSet = (_cpuSet.isEmpty() ? _defaultCpuSet : _cpuSet);
+  if (cpuSet == "none")
+    return QList<int>();
+  else if (cpuSet != "auto")
+    return _parseCpuSet(cpuSet);
+
+  // Automatic: each movie gets its own block of CPUs, blocks being assigned in a round-robin fashion.
+  int nCpus = QThread::idealThreadCount();
+  if (nCpus <= 1)
+    return QList<int>();
+
+  int explicitThreads = (_decoderThreads > 0 ? _decoderThreads : _defaultDecoderThreads);
+  int blockSize = (explicitThreads > 0 ? explicitThreads : qMax(nCpus / AUTO_CPU_BLOCKS, 1));
+  blockSize = qMin(blockSize, nCpus);
+
+  int nBlocks = nCpus / blockSize;
+  int start = (_schedulerSlot % nBlocks) * blockSize;
+  QList<int> list;
+  for (int i=0; i<blockSize; i++)
+    list.append(start + i);
+  return list;
+}
+
+void VideoImpl::applyStreamingThreadSettings() const
+{
+  QList<int> cpuList = cpus();
+  int priority = threadPriority();
+
+#ifdef Q_OS_LINUX
+  // Pin thread.
+  if (!cpuList.isEmpty())
+  {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    foreach (int cpu, cpuList)
+      CPU_SET(cpu, &cpuSet);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet) != 0)
+      qWarning() << "Could not set CPU affinity of streaming thread." << endl;
+  }
+
+  // Adjust niceness of this thread only (on Linux, threads have their own nice value).
+  if (priority != 0)
+  {
+    pid_t tid = (pid_t) syscall(SYS_gettid);
+    if (setpriority(PRIO_PROCESS, tid, -priority * THREAD_PRIORITY_NICE_STEP) != 0)
+      qWarning() << "Could not set priority of streaming thread (raising priority requires privileges)." << endl;
+  }
+#else
+  static bool warned = false;
+  if (!warned && (!cpuList.isEmpty() || priority != 0))
+  {
+    qWarning() << "Thread priority and CPU pinning are not supported on this platform: ignored." << endl;
+    warned = true;
+  }
+#endif
+}
+
+void VideoImpl::configureDecoderThreads(GstElement *decoder) const
+{
+  int nThreads = decoderThreads();
+  if (nThreads <= 0)
+    return;
+
+  // Different decoders use different names for the same thing (eg. avdec_*: "max-threads", vpxdec: "threads").
+  static const char* threadPropertyNames[] = { "max-threads", "threads", "n-threads", NULL };
+  for (const char** name = threadPropertyNames; *name; name++)
+  {
+    GParamSpec* spec = g_object_class_find_property(G_OBJECT_GET_CLASS(decoder), *name);
+    if (!spec)
+      continue;
+
+    if (G_PARAM_SPEC_VALUE_TYPE(spec) == G_TYPE_UINT)
+      g_object_set (decoder, *name, (guint) nThreads, NULL);
+    else if (G_PARAM_SPEC_VALUE_TYPE(spec) == G_TYPE_INT)
+      g_object_set (decoder, *name, (gint) nThreads, NULL);
+    else
+      continue;
+
+#ifdef VIDEO_IMPL_VERBOSE
+    qDebug() << "Decoder " << GST_ELEMENT_NAME(decoder) << " set to use " << nThreads << " threads." << endl;
+#endif
+    break;
+  }
+}
+
+GstBusSyncReply VideoImpl::gstBusSyncHandler(GstBus *bus, GstMessage *message, VideoImpl* p)
+{
+  Q_UNUSED(bus);
+
+  // Stream status "enter" messages are posted from within the newly started streaming thread.
+  if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_STREAM_STATUS)
+  {
+    GstStreamStatusType type;
+    gst_message_parse_stream_status(message, &type, NULL);
+    if (type == GST_STREAM_STATUS_TYPE_ENTER)
+      p->applyStreamingThreadSettings();
+  }
+
+  // Audio measures are handled right away (on the streaming thread) and dropped.
+  if (p->_audiolevel0 && p->_audioAnalysis.handleMessage(message))
+    return GST_BUS_DROP;
+
+  // Let messages go through to the bus.
+  return GST_BUS_PASS;
+}
+
+QList<int> VideoImpl::_parseCpuSet(const QString& cpuSet)
+{
+  QList<int> list;
+  int nCpus = QThread::idealThreadCount();
+  foreach (const QString& item, cpuSet.split(',', QString::SkipEmptyParts))
+  {
+    QStringList bounds = item.trimmed().split('-');
+    bool okFirst = false, okLast = false;
+    int first = bounds[0].toInt(&okFirst);
+    int last  = (bounds.size() == 2 ? bounds[1].toInt(&okLast) : first);
+    if (!okFirst || (bounds.size() == 2 && !okLast) || bounds.size() > 2)
+    {
+      qWarning() << "Invalid CPU set entry '" << item << "': ignored." << endl;
+      continue;
+    }
+
+    for (int cpu = qMax(first, 0); cpu <= last && (nCpus <= 0 || cpu < nCpus); cpu++)
+      if (!list.contains(cpu))
+        list.append(cpu);
+  }
+  return list;
+}
+
+void VideoImpl::selectFrame(qreal displayDelay)
+{
+  lockMutex();
+
+  // Compute the running time at which the next rendered image will be displayed.
+  GstClockTime displayTime = GST_CLOCK_TIME_NONE;
+  GstClock* clock = (_pipeline ? gst_element_get_clock(_pipeline) : NULL);
+  if (clock)
+  {
+    GstClockTime now = gst_clock_get_time(clock) + (GstClockTime)(qMax(displayDelay, 0.0) * GST_SECOND);
+    GstClockTime baseTime = gst_element_get_base_time(_pipeline);
+    if (now >= baseTime)
+      displayTime = now - baseTime;
+    gst_object_unref(clock);
+
+    // Playback scheduled to start later (see playIn()): keep current frame.
+    if (now < baseTime && _playState)
+    {
+      unlockMutex();
+      return;
+    }
+  }
+
+  // Pick the last frame that should have started being displayed by then.
+  int index = -1;
+  if (!GST_CLOCK_TIME_IS_VALID(displayTime))
+    index = _frameQueue.size() - 1; // no clock: just show the most recent frame
+  else
+  {
+    for (int i=0; i<_frameQueue.size(); i++)
+    {
+      if (!GST_CLOCK_TIME_IS_VALID(_frameQueue[i].runningTime) || _frameQueue[i].runningTime <= displayTime)
+        index = i;
+      else
+        break;
+    }
+  }
+
+  if (index >= 0)
+    _setCurrentFrame(index);
+  else if (_playState && hasBits())
+    _nRepeatedFrames++; // nothing new to show: previous frame is shown again
+
+  // Audio measures of what is heard when the image is displayed.
+  if (_audiolevel0)
+    _audioAnalysis.update(_playState ? displayTime : GST_CLOCK_TIME_NONE);
+
+  // Measure how late the frame shown is (ie. how long it has been due to be replaced).
+  if (GST_CLOCK_TIME_IS_VALID(displayTime) && GST_CLOCK_TIME_IS_VALID(_currentFrameEnd) && _playState)
+    _lateness = (displayTime > _currentFrameEnd ? qreal(displayTime - _currentFrameEnd) / GST_SECOND : 0);
+  else
+    _lateness = 0;
+
+  unlockMutex();
+}
+
+void VideoImpl::_setCurrentFrame(int index)
+{
+  // Frames before the selected one will never be displayed.
+  for (int i=0; i<index; i++)
+  {
+    gst_sample_unref(_frameQueue.takeFirst().sample);
+    _nSkippedFrames++;
+  }
+  QueuedSample queued = _frameQueue.takeFirst();
+
+  // Unref last frame.
+  _freeCurrentSample();
+
+  // Set current frame.
+  _currentFrameSample = queued.sample;
+  _sampleBitsRect = queued.bitsRect;
+  _currentFrameEnd = (GST_CLOCK_TIME_IS_VALID(queued.runningTime) && GST_CLOCK_TIME_IS_VALID(queued.duration) ?
+                      queued.runningTime + queued.duration : GST_CLOCK_TIME_NONE);
+
+  // Try to retrieve data bits of frame.
+  GstBuffer *buffer = gst_sample_get_buffer(queued.sample);
+  if (buffer && gst_buffer_map(buffer, &_mapInfo, GST_MAP_READ))
+  {
+    _currentFrameBuffer = buffer;
+
+    // Retrieve data from map info.
+    _data = _mapInfo.data;
+
+    // Bits have changed.
+    _bitsChanged = true;
+  }
+}
+
+void VideoImpl::_clearFrameQueue()
+{
+  while (!_frameQueue.isEmpty())
+    gst_sample_unref(_frameQueue.takeFirst().sample);
+}
+
 void VideoImpl::_freeCurrentSample() {
   if (_currentFrameBuffer != NULL)
   {
@@ -782,6 +1380,12 @@ bool VideoImpl::waitForNextBits(int timeout, const uchar** bits)
   time.start();
   while (time.elapsed() < timeout)
   {
+    // Take the most recent frame (frames are not being selected by the renderer while we wait).
+    lockMutex();
+    if (!_frameQueue.isEmpty())
+      _setCurrentFrame(_frameQueue.size() - 1);
+    unlockMutex();
+
     // Bits available.
     if (hasBits() && bitsHaveChanged())
     {
@@ -32,6 +32,7 @@
 
 // Other includes.
 #include "MM.h"
+#include "AudioAnalysis.h"
 #include <QtOpenGL>
 #include <QMutex>
 #include <QWaitCondition>
@@ -96,6 +97,12 @@ public:
    */
   const uchar* getBits();
 
+  /**
+   * Returns the region of the video frame covered by the bits last returned by getBits().
+   * This is the whole frame unless cropping is active (see setCropRect()).
+   */
+  QRect getBitsRect() const;
+
   /// Returns true iff bits have started flowing (ie. if there is at least a first sample available).
   bool hasBits() const { return (_currentFrameSample != NULL); }
 
@@ -118,6 +125,13 @@ public:
   void audioConnect() { _audioIsConnected = true; }
   bool audioIsSupported() const { return _audioqueue0 != NULL; }
 
+  /// Enables/disables the analysis of the audio (takes effect the next time a movie is loaded).
+  void setAudioAnalysis(bool enabled) { _audioAnalysisEnabled = enabled; }
+  bool hasAudioAnalysis() const { return _audioAnalysisEnabled; }
+
+  /// Analysis of the audio heard (NULL if not analyzed).
+  const AudioAnalysis* getAudioAnalysis() const { return (_audiolevel0 ? &_audioAnalysis : NULL); }
+
   /**
    * Performs regular updates (checks if movie is ready and checks messages).
    */
@@ -148,10 +162,127 @@ public:
 
   void resetMovie();
 
+  /**
+   * Sets the maximum rate (in frames per second) at which frames are let through
+   * to the color conversion stage. Should be set to the render frame rate: frames that
+   * would never be displayed are dropped before being converted.
+   */
+  void setMaxFramesPerSecond(qreal fps);
+  qreal getMaxFramesPerSecond() const { return _maxFramesPerSecond; }
+
+  /**
+   * Crops the video frames at decoding time to given region of the frame (in pixels), so that
+   * only that region is converted and uploaded. A null rectangle disables cropping.
+   * Can be called while playing: the pipeline is not rebuilt.
+   */
+  void setCropRect(const QRect& rect);
+  QRect getCropRect() const { return _cropRect; }
+
+  /**
+   * Picks, among buffered samples, the frame whose presentation time best matches the time at
+   * which the next rendered image will be displayed (ie. now + displayDelay seconds). Should be
+   * called once per rendered frame, before the bits are fetched.
+   */
+  void selectFrame(qreal displayDelay);
+
+  /// Number of rendered frames that repeated the previous video frame (since movie was loaded).
+  quint64 getRepeatedFrames() const { return _nRepeatedFrames; }
+
+  /// Number of video frames that were never displayed (since movie was loaded).
+  quint64 getSkippedFrames() const { return _nSkippedFrames; }
+
+  /**
+   * How late (in seconds) the frame last selected by selectFrame() is with respect to the
+   * pipeline clock. When synchronized with other instances, this is the skew to the shared timeline.
+   */
+  qreal getLateness() const { return _lateness; }
+
+  /// Returns true iff position is locked to the timeline of the sync clock (see SyncClock).
+  bool isSyncLocked() const { return _syncLocked; }
+
+  /**
+   * Enables/disables looping. When disabled, the last frame is kept when the end of the
+   * movie is reached (see hasReachedEnd()).
+   */
+  void setLooping(bool looping) { _looping = looping; }
+  bool isLooping() const { return _looping; }
+
+  /// Number of times the movie looped back since it was loaded.
+  int getLoopCount() const { return _nLoops; }
+
+  /// Returns true iff the end of the movie was reached (and it did not loop back).
+  bool hasReachedEnd() const { return _reachedEnd && !_looping; }
+
+  /// Time (in nanoseconds) until the end of the movie is reached (-1 if unknown).
+  qint64 getRemainingTime();
+
+  /**
+   * Starts playing a prerolled (paused and ready) movie so that its first frame is due
+   * in delay nanoseconds. Returns false if the movie is not ready.
+   */
+  bool playIn(quint64 delay);
+
+  /// Creates a new (unloaded) implementation of the same kind (eg. to preroll another movie).
+  virtual VideoImpl* newInstance() const = 0;
+
+  /// Sets the default maximum frame rate used by newly created pipelines.
+  static void setDefaultMaxFramesPerSecond(qreal fps);
+  static qreal getDefaultMaxFramesPerSecond() { return _defaultMaxFramesPerSecond; }
+
+  /**
+   * Threading of the decoding pipeline. For each setting, zero (or an empty CPU set) means
+   * the default value is used (see the setDefault...() methods below). These settings take
+   * effect the next time a movie is loaded.
+   */
+  /// Number of threads used by the decoder (0 = default).
+  void setDecoderThreads(int nThreads) { _decoderThreads = qMax(nThreads, 0); }
+  int getDecoderThreads() const { return _decoderThreads; }
+
+  /// Number of threads used by the colorspace converter (0 = default).
+  void setConverterThreads(int nThreads) { _converterThreads = qMax(nThreads, 0); }
+  int getConverterThreads() const { return _converterThreads; }
+
+  /// Priority of streaming threads, from THREAD_PRIORITY_MIN to THREAD_PRIORITY_MAX (0 = default).
+  void setThreadPriority(int priority) { _threadPriority = qBound(THREAD_PRIORITY_MIN, priority, THREAD_PRIORITY_MAX); }
+  int getThreadPriority() const { return _threadPriority; }
+
+  /**
+   * CPUs streaming threads are pinned to, as a list of CPU indices and ranges (eg. "0-3,8").
+   * The special value "auto" spreads successive movies over blocks of CPUs, "none" disables
+   * pinning. Empty = default.
+   */
+  void setCpuSet(const QString& cpuSet) { _cpuSet = cpuSet.trimmed(); }
+  QString getCpuSet() const { return _cpuSet; }
+
+  static void setDefaultDecoderThreads(int nThreads) { _defaultDecoderThreads = qMax(nThreads, 0); }
+  static int getDefaultDecoderThreads() { return _defaultDecoderThreads; }
+
+  static void setDefaultConverterThreads(int nThreads) { _defaultConverterThreads = qMax(nThreads, 0); }
+  static int getDefaultConverterThreads() { return _defaultConverterThreads; }
+
+  static void setDefaultThreadPriority(int priority) { _defaultThreadPriority = qBound(THREAD_PRIORITY_MIN, priority, THREAD_PRIORITY_MAX); }
+  static int getDefaultThreadPriority() { return _defaultThreadPriority; }
+
+  static void setDefaultCpuSet(const QString& cpuSet) { _defaultCpuSet = cpuSet.trimmed(); }
+  static QString getDefaultCpuSet() { return _defaultCpuSet; }
+
+  /// Thread priority range (0 = leave threads at their normal priority).
+  static const int THREAD_PRIORITY_MIN = -2;
+  static const int THREAD_PRIORITY_MAX =  2;
+
+  /// Niceness difference between two successive priority levels.
+  static const int THREAD_PRIORITY_NICE_STEP = 5;
+
+  /// Number of blocks CPUs are divided into when the CPU set is "auto".
+  static const int AUTO_CPU_BLOCKS = 4;
+
 protected:
   virtual bool createVideoComponents();
   virtual bool createAudioComponents();
 
+  /// Returns true iff the source designated by uri is available (default: checks that the file exists).
+  virtual bool sourceExists(const QString& uri) const;
+
   void unloadMovie();
   void freeResources();
 
@@ -175,6 +306,31 @@ private:
   // Sends the appropriate seek events to adjust to rate.
   void _updateRate();
 
+  // Applies max frames per second to the rate limiter.
+  void _updateMaxFramesPerSecond();
+
+  // Requests the crop rectangle to be applied to the cropping element (see gstCropProbeCallback()).
+  void _updateCrop();
+
+  // Loops back or stops at end of movie.
+  void _endOfStream();
+
+  // Returns true iff position can be locked to the timeline of the sync clock.
+  bool _canSyncToClock();
+
+  // Seeks so that position matches the timeline of the sync clock (clock time modulo duration).
+  bool _lockToSyncClock();
+
+  // Makes the queued sample at given index the current frame, dropping all the ones before it
+  // (mutex must be locked).
+  void _setCurrentFrame(int index);
+
+  // Removes all samples from the jitter buffer (mutex must be locked).
+  void _clearFrameQueue();
+
+  // Parses a CPU set such as "0-3,8" (invalid and out of range entries are ignored).
+  static QList<int> _parseCpuSet(const QString& cpuSet);
+
   void _freeCurrentSample();
 
   void _freeElement(GstElement** element);
@@ -182,6 +338,10 @@ private:
 public:
   // GStreamer callback that simply sets the #newSample# flag to point to TRUE.
   static GstFlowReturn gstNewSampleCallback(GstElement*, VideoImpl *p);
+
+  // GStreamer probe that applies requested crop to the cropping element right before a buffer
+  // enters it, so that offsets always match the frames that come out of it.
+  static GstPadProbeReturn gstCropProbeCallback(GstPad *pad, GstPadProbeInfo *info, VideoImpl* p);
   //static GstFlowReturn gstNewPreRollCallback (GstAppSink * appsink, gpointer user_data);
 
   // GStreamer callback that plugs the audio/video pads into the proper elements when they
@@ -197,6 +357,28 @@ public:
   /// Wait until first data samples are available (blocking).
   bool waitForNextBits(int timeout, const uchar** bits=0);
 
+  /// Number of decoder threads that should be used (taking defaults into account; 0 = decoder's choice).
+  int decoderThreads() const;
+
+  /// Number of colorspace converter threads that should be used (taking defaults into account; 0 = automatic).
+  int converterThreads() const;
+
+  /// Priority of streaming threads (taking defaults into account).
+  int threadPriority() const;
+
+  /// CPUs streaming threads should be pinned to (taking defaults into account; empty = no pinning).
+  QList<int> cpus() const;
+
+  /// Applies priority and CPU pinning to the calling thread (to be called from streaming threads).
+  void applyStreamingThreadSettings() const;
+
+  /// Sets the number of threads of a decoder element to decoderThreads() (if it has a property for it).
+  void configureDecoderThreads(GstElement *decoder) const;
+
+  // GStreamer bus handler that applies priority and CPU pinning to streaming threads as they start
+  // and handles audio analysis measures.
+  static GstBusSyncReply gstBusSyncHandler(GstBus *bus, GstMessage *message, VideoImpl* p);
+
 protected:
   int _width;
   int _height;
@@ -210,6 +392,8 @@ protected:
   GstElement *_pipeline;
 
   GstElement *_queue0;
+  GstElement *_videorate0;
+  GstElement *_videocrop0;
   GstElement *_capsfilter0;
   GstElement *_videoscale0;
   GstElement *_videoconvert0;
@@ -221,6 +405,10 @@ protected:
   GstElement *_audiovolume0;
   GstElement *_audiosink0;
 
+  // Audio analysis tap (NULL if analysis is disabled).
+  GstElement *_audiolevel0;
+  GstElement *_audiospectrum0;
+
   // gstreamer elements
   GstBus *_bus;
 
@@ -232,6 +420,57 @@ protected:
   GstMapInfo  _mapInfo;
   bool       _bitsChanged;
 
+  /// Region of the frame covered by the current sample.
+  QRect      _sampleBitsRect;
+
+  /// Sample waiting to be displayed.
+  struct QueuedSample
+  {
+    GstSample*   sample;
+    GstClockTime runningTime; // presentation time (in pipeline running time)
+    GstClockTime duration;    // display duration (GST_CLOCK_TIME_NONE if unknown)
+    QRect        bitsRect;    // region of the frame covered by sample
+  };
+
+  /// Jitter buffer: samples not yet displayed, ordered by presentation time.
+  QList<QueuedSample> _frameQueue;
+
+  /// Frame statistics.
+  quint64 _nRepeatedFrames;
+  quint64 _nSkippedFrames;
+
+  /// Running time at which the current frame should be replaced (GST_CLOCK_TIME_NONE if unknown).
+  GstClockTime _currentFrameEnd;
+
+  /// Lateness of the current frame (in seconds).
+  qreal _lateness;
+
+  /// Synchronization with other instances (see SyncClock).
+  bool _usesSyncClock;
+  bool _syncLocked;
+
+  /// Audio analysis (measures made on the streaming thread, see gstBusSyncHandler()).
+  bool _audioAnalysisEnabled;
+  AudioAnalysis _audioAnalysis;
+
+  /// Looping.
+  bool _looping;
+  bool _reachedEnd;
+  int  _nLoops;
+
+  /// Region of the frame covered by the bits last returned by getBits().
+  QRect      _currentBitsRect;
+
+  /// Requested crop region (null ==> no cropping).
+  QRect      _cropRect;
+
+  /// Crop region waiting to be applied by the streaming thread (mutex must be locked).
+  QRect      _pendingCrop;
+  bool       _cropPending;
+
+  /// Offset of the crop applied to the frames coming out of the cropping element (streaming thread only).
+  QPoint     _appliedCropOffset;
+
   /**
    * Contains meta informations about current file.
    */
@@ -247,6 +486,28 @@ protected:
   /// Audio playback volume (0.0 ==> 1.0).
   double _volume;
 
+  /// Maximum number of frames per second sent to conversion (should match render rate).
+  qreal _maxFramesPerSecond;
+
+  /// Default value of _maxFramesPerSecond for new instances.
+  static qreal _defaultMaxFramesPerSecond;
+
+  /// Threading settings (0 / empty ==> use default).
+  int _decoderThreads;
+  int _converterThreads;
+  int _threadPriority;
+  QString _cpuSet;
+
+  /// Default threading settings.
+  static int _defaultDecoderThreads;
+  static int _defaultConverterThreads;
+  static int _defaultThreadPriority;
+  static QString _defaultCpuSet;
+
+  /// Index of this instance used to spread movies over CPUs when the CPU set is "auto".
+  int _schedulerSlot;
+  static int _nSchedulerSlots;
+
   /// Whether or not we are reading video from a shmsrc.
   bool _isSharedMemorySource;
 
@@ -274,6 +535,12 @@ private:
   QString _uri;
 
   static const int MAX_SAMPLES_IN_BUFFER_QUEUES = 30;
+
+  /// Maximum number of samples kept in the jitter buffer.
+  static const int FRAME_QUEUE_SIZE = 4;
+
+  /// How early (in nanoseconds) samples are delivered by the sink ahead of their presentation time.
+  static const gint64 FRAME_QUEUE_LOOKAHEAD = 60 * GST_MSECOND;
 };
 
 }
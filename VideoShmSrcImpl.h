@@ -55,6 +55,7 @@ class VideoShmSrcImpl : public VideoImpl
   ~VideoShmSrcImpl();
   bool loadMovie(const QString& path);
   bool isLive() {return true;}
+  VideoImpl* newInstance() const { return new VideoShmSrcImpl(); }
   bool getAttached();
   void setAttached(bool attach);
 
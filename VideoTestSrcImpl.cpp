@@ -0,0 +1,233 @@
+/*
+ * VideoTestSrcImpl.cpp
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "VideoTestSrcImpl.h"
+#include <QUrl>
+#include <QUrlQuery>
+
+namespace mmp {
+
+const QString VideoTestSrcImpl::URI_SCHEME = "testsrc";
+
+VideoTestSrcImpl::VideoTestSrcImpl() :
+_videotestsrc0(NULL),
+_testcapsfilter0(NULL),
+_encoder0(NULL),
+_parser0(NULL),
+_decoder0(NULL)
+{
+}
+
+QString VideoTestSrcImpl::makeUri(const QString& pattern, int width, int height, int framesPerSecond, const QString& encoder)
+{
+  QUrl url;
+  url.setScheme(URI_SCHEME);
+  url.setHost(pattern.isEmpty() ? patterns().first() : pattern);
+
+  QUrlQuery query;
+  query.addQueryItem("width",     QString::number(width));
+  query.addQueryItem("height",    QString::number(height));
+  query.addQueryItem("framerate", QString::number(framesPerSecond));
+  if (!encoder.isEmpty())
+    query.addQueryItem("encoder", encoder);
+  url.setQuery(query);
+
+  return url.toString();
+}
+
+bool VideoTestSrcImpl::parseUri(const QString& uri, QString* pattern, int* width, int* height, int* framesPerSecond, QString* encoder)
+{
+  QUrl url(uri);
+  if (url.scheme() != URI_SCHEME)
+    return false;
+
+  QUrlQuery query(url);
+  bool ok;
+
+  *pattern = url.host();
+  if (!patterns().contains(*pattern))
+    *pattern = patterns().first();
+
+  *width = query.queryItemValue("width").toInt(&ok);
+  if (!ok || *width <= 0)
+    *width = DEFAULT_WIDTH;
+
+  *height = query.queryItemValue("height").toInt(&ok);
+  if (!ok || *height <= 0)
+    *height = DEFAULT_HEIGHT;
+
+  *framesPerSecond = query.queryItemValue("framerate").toInt(&ok);
+  if (!ok || *framesPerSecond <= 0)
+    *framesPerSecond = DEFAULT_FRAMES_PER_SECOND;
+
+  *encoder = query.queryItemValue("encoder");
+  if (!encoders().contains(*encoder))
+    *encoder = "";
+
+  return true;
+}
+
+QStringList VideoTestSrcImpl::patterns()
+{
+  // Subset of videotestsrc patterns (nicks) that are useful for benchmarking.
+  return QStringList() << "smpte" << "snow" << "ball" << "gradient" << "checkers-8"
+                       << "zone-plate" << "circular" << "pinwheel" << "black";
+}
+
+QStringList VideoTestSrcImpl::encoders()
+{
+  return QStringList() << "" << "h264" << "vp8" << "mjpeg";
+}
+
+bool VideoTestSrcImpl::sourceExists(const QString& uri) const
+{
+  return QUrl(uri).scheme() == URI_SCHEME;
+}
+
+bool VideoTestSrcImpl::_createCodec(const QString& encoder, int framesPerSecond)
+{
+  if (encoder == "h264")
+  {
+    _encoder0 = gst_element_factory_make("x264enc", NULL);
+    _parser0  = gst_element_factory_make("h264parse", NULL);
+    _decoder0 = gst_element_factory_make("avdec_h264", NULL);
+    if (_encoder0)
+    {
+      // Fast, low latency encoding (keyframe every second, like typical media).
+      gst_util_set_object_arg(G_OBJECT(_encoder0), "speed-preset", "ultrafast");
+      gst_util_set_object_arg(G_OBJECT(_encoder0), "tune", "zerolatency");
+      g_object_set (_encoder0, "key-int-max", (guint) framesPerSecond, NULL);
+    }
+  }
+  else if (encoder == "vp8")
+  {
+    _encoder0 = gst_element_factory_make("vp8enc", NULL);
+    _decoder0 = gst_element_factory_make("vp8dec", NULL);
+    if (_encoder0)
+    {
+      g_object_set (_encoder0, "deadline", (gint64) 1, NULL); // realtime
+      g_object_set (_encoder0, "keyframe-max-dist", (gint) framesPerSecond, NULL);
+    }
+  }
+  else if (encoder == "mjpeg")
+  {
+    _encoder0 = gst_element_factory_make("jpegenc", NULL);
+    _decoder0 = gst_element_factory_make("jpegdec", NULL);
+  }
+
+  if (!_encoder0 || !_decoder0 || (encoder == "h264" && !_parser0))
+  {
+    qWarning() << "Encoder or decoder for " << encoder << " could not be created." << endl;
+    if (_encoder0) gst_object_unref(_encoder0);
+    if (_parser0)  gst_object_unref(_parser0);
+    if (_decoder0) gst_object_unref(_decoder0);
+    _encoder0 = _parser0 = _decoder0 = NULL;
+    return false;
+  }
+
+  configureDecoderThreads(_decoder0);
+  return true;
+}
+
+bool VideoTestSrcImpl::loadMovie(const QString& uri) {
+  QString pattern, encoder;
+  int width, height, framesPerSecond;
+  if (!parseUri(uri, &pattern, &width, &height, &framesPerSecond, &encoder))
+  {
+    qWarning() << "Invalid test source: " << uri << "." << endl;
+    return false;
+  }
+
+  if (!VideoImpl::loadMovie(uri))
+    return false;
+
+  // Previous elements were freed along with the previous pipeline.
+  _encoder0 = _parser0 = _decoder0 = NULL;
+
+  _videotestsrc0   = gst_element_factory_make("videotestsrc", NULL);
+  _testcapsfilter0 = gst_element_factory_make("capsfilter", NULL);
+
+  if (!_videotestsrc0 || !_testcapsfilter0)
+  {
+    qWarning() << "Not all elements could be created." << endl;
+    unloadMovie();
+    return false;
+  }
+
+  // Generate frames in real time at requested size and rate.
+  gst_util_set_object_arg(G_OBJECT(_videotestsrc0), "pattern", pattern.toUtf8().constData());
+  g_object_set (_videotestsrc0, "is-live", TRUE, NULL);
+
+  GstCaps *testCaps = gst_caps_new_simple ("video/x-raw",
+                                           "format", G_TYPE_STRING, "I420",
+                                           "width",  G_TYPE_INT, width,
+                                           "height", G_TYPE_INT, height,
+                                           "framerate", GST_TYPE_FRACTION, framesPerSecond, 1,
+                                           NULL);
+  g_object_set (_testcapsfilter0, "caps", testCaps, NULL);
+  gst_caps_unref (testCaps);
+
+  gst_bin_add_many (GST_BIN (_pipeline), _videotestsrc0, _testcapsfilter0, NULL);
+  bool linked = gst_element_link (_videotestsrc0, _testcapsfilter0);
+
+  // Optional encode/decode round-trip.
+  GstElement *last = _testcapsfilter0;
+  if (!encoder.isEmpty())
+  {
+    if (!_createCodec(encoder, framesPerSecond))
+    {
+      unloadMovie();
+      return false;
+    }
+
+    gst_bin_add_many (GST_BIN (_pipeline), _encoder0, _decoder0, NULL);
+    linked = linked && gst_element_link (last, _encoder0);
+    last = _encoder0;
+    if (_parser0)
+    {
+      gst_bin_add (GST_BIN (_pipeline), _parser0);
+      linked = linked && gst_element_link (last, _parser0);
+      last = _parser0;
+    }
+    linked = linked && gst_element_link (last, _decoder0);
+    last = _decoder0;
+  }
+
+  if (!linked || !gst_element_link (last, _queue0))
+  {
+    qWarning() << "Could not link test source." << endl;
+    unloadMovie();
+    return false;
+  }
+
+  // Meta-info is known in advance.
+  _width  = width;
+  _height = height;
+  _seekEnabled = false;
+  videoConnect();
+
+  // Apply priority and CPU pinning to streaming threads.
+  gst_bus_set_sync_handler (_bus, (GstBusSyncHandler) VideoImpl::gstBusSyncHandler, this, NULL);
+
+  setPlayState(true);
+  return true;
+}
+
+VideoTestSrcImpl::~VideoTestSrcImpl()
+{
+}
+
+}
@@ -0,0 +1,92 @@
+/*
+ * VideoTestSrcImpl.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef VIDEO_TESTSRC_IMPL_H_
+#define VIDEO_TESTSRC_IMPL_H_
+
+// GStreamer includes.
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+#include <gst/pbutils/pbutils.h>
+
+// Other includes.
+#include "MM.h"
+#include <QtOpenGL>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <glib.h>
+#if __APPLE__
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+
+#include "VideoImpl.h"
+
+namespace mmp {
+
+/**
+ * Synthetic video source (GStreamer's videotestsrc), optionally encoded and decoded
+ * back on the fly so that it generates the same decoding load as a media file.
+ *
+ * The source is described by an URI of the form:
+ *   testsrc://<pattern>?width=<w>&height=<h>&framerate=<fps>&encoder=<codec>
+ * where codec is empty (raw frames) or one of h264, vp8 and mjpeg.
+ */
+class VideoTestSrcImpl : public VideoImpl
+{
+  public:
+  VideoTestSrcImpl();
+  ~VideoTestSrcImpl();
+  bool loadMovie(const QString& uri);
+  bool isLive() {return true;}
+  VideoImpl* newInstance() const { return new VideoTestSrcImpl(); }
+
+  /// Returns the URI describing a test source with given settings.
+  static QString makeUri(const QString& pattern, int width, int height, int framesPerSecond, const QString& encoder);
+
+  /// Parses a test source URI (missing settings are set to defaults). Returns false if uri is not a test source.
+  static bool parseUri(const QString& uri, QString* pattern, int* width, int* height, int* framesPerSecond, QString* encoder);
+
+  /// Names of available patterns and encoders (first encoder is "" ie. no encoding).
+  static QStringList patterns();
+  static QStringList encoders();
+
+  static const QString URI_SCHEME;
+
+  static const int DEFAULT_WIDTH  = 1920;
+  static const int DEFAULT_HEIGHT = 1080;
+  static const int DEFAULT_FRAMES_PER_SECOND = 30;
+
+  protected:
+  virtual bool sourceExists(const QString& uri) const;
+
+  private:
+  // Creates the encoder, parser (if any) and decoder for given codec. Returns false on failure.
+  bool _createCodec(const QString& encoder, int framesPerSecond);
+
+  GstElement *_videotestsrc0;
+  GstElement *_testcapsfilter0;
+  GstElement *_encoder0;
+  GstElement *_parser0;
+  GstElement *_decoder0;
+};
+
+}
+
+#endif /* ifndef */
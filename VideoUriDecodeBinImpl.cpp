@@ -139,6 +139,17 @@ exit:
   }
 }
 
+void VideoUriDecodeBinImpl::gstDeepElementAddedCallback(GstBin *bin, GstBin *subBin, GstElement *element, VideoUriDecodeBinImpl* p)
+{
+  Q_UNUSED(bin);
+  Q_UNUSED(subBin);
+
+  // Only consider decoders.
+  GstElementFactory* factory = gst_element_get_factory(element);
+  if (factory && gst_element_factory_list_is_type(factory, GST_ELEMENT_FACTORY_TYPE_DECODER))
+    p->configureDecoderThreads(element);
+}
+
 bool VideoUriDecodeBinImpl::loadMovie(const QString& path) {
   VideoImpl::loadMovie(path);
 
@@ -258,6 +269,10 @@ bool VideoUriDecodeBinImpl::loadMovie(const QString& path) {
   // Connect pad signal.
   g_signal_connect (_uridecodebin0, "pad-added", G_CALLBACK (VideoUriDecodeBinImpl::gstPadAddedCallback), this);
 
+  // Configure threading of decoders and streaming threads.
+  g_signal_connect (_uridecodebin0, "deep-element-added", G_CALLBACK (VideoUriDecodeBinImpl::gstDeepElementAddedCallback), this);
+  gst_bus_set_sync_handler (_bus, (GstBusSyncHandler) VideoImpl::gstBusSyncHandler, this, NULL);
+
   // Set uri of decoder.
   g_object_set (_uridecodebin0, "uri", uri, NULL);
 
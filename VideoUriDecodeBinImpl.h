@@ -53,8 +53,13 @@ class VideoUriDecodeBinImpl : public VideoImpl
   VideoUriDecodeBinImpl();
   ~VideoUriDecodeBinImpl();
   static void gstPadAddedCallback(GstElement *src, GstPad *newPad, VideoUriDecodeBinImpl* p);
+
+  // GStreamer callback that configures the number of threads of decoders as they get plugged.
+  static void gstDeepElementAddedCallback(GstBin *bin, GstBin *subBin, GstElement *element, VideoUriDecodeBinImpl* p);
+
   bool loadMovie(const QString& path);
   bool isLive() {return false;}
+  VideoImpl* newInstance() const { return new VideoUriDecodeBinImpl(); }
 
   private:
   GstElement *_uridecodebin0;
@@ -55,6 +55,7 @@ class VideoV4l2SrcImpl : public VideoImpl
   ~VideoV4l2SrcImpl();
   bool loadMovie(const QString& path);
   bool isLive() {return true;}
+  VideoImpl* newInstance() const { return new VideoV4l2SrcImpl(); }
 
   private:
   GstElement *_v4l2src0;
@@ -14,6 +14,9 @@
 #include "MainApplication.h"
 
 #include "MetaObjectRegistry.h"
+#include "MediaPreflight.h"
+#include "SyncClock.h"
+#include "AudioAnalysis.h"
 
 #include <stdlib.h>
 #include <iostream>
@@ -53,8 +56,10 @@ void initRegistry()
 
   // Paints.
   registry.add<Video>();
+  registry.add<TestSource>();
   registry.add<Image>();
   registry.add<Color>();
+  registry.add<PluginSource>();
 
   // Mappings.
   registry.add<TextureMapping>();
@@ -125,6 +130,26 @@ int main(int argc, char *argv[])
     "Use a framerate of <frame-rate> per second.", "frame-rate", QString::number(MM::DEFAULT_FRAMES_PER_SECOND));
   parser.addOption(frameRateOption);
 
+  // --preflight option
+  QCommandLineOption preflightOption(QStringList() << "preflight",
+    "Analyze the media of the project, print a report and exit (exit status is 1 if problems were found).");
+  parser.addOption(preflightOption);
+
+  // --sync option
+  QCommandLineOption syncOption(QStringList() << "sync",
+    "Play frame-locked with other instances on this machine: <sync> is \"master\" (one instance) or \"slave\".", "sync", "off");
+  parser.addOption(syncOption);
+
+  // --sync-port option
+  QCommandLineOption syncPortOption(QStringList() << "sync-port",
+    "Use port number <sync-port> for synchronization.", "sync-port", QString::number(MM::DEFAULT_SYNC_PORT));
+  parser.addOption(syncPortOption);
+
+  // --audio-input option
+  QCommandLineOption audioInputOption(QStringList() << "audio-input",
+    "Analyze the default audio input (modulation sources input.level and input.band<n>).");
+  parser.addOption(audioInputOption);
+
   // Positional argument: file
   parser.addPositionalArgument("file", "Load project from that file.");
 
@@ -137,6 +162,30 @@ int main(int argc, char *argv[])
   {
     Util::eraseSettings();
   }
+  if (parser.isSet(preflightOption))
+  {
+    QString projectFile = (parser.positionalArguments().isEmpty() ?
+                           parser.value("file") : parser.positionalArguments().first());
+    QStringList uris;
+    if (projectFile.isEmpty() || !MediaPreflight::mediaUrisFromFile(projectFile, &uris))
+    {
+      std::cerr << "Cannot read project file " << qPrintable(projectFile) << "." << std::endl;
+      return 1;
+    }
+
+    // Analyze all media in parallel.
+    QList<MediaPreflightReport> reports = MediaPreflight::run(uris);
+    int nProblems = 0;
+    foreach (const MediaPreflightReport& report, reports)
+    {
+      std::cout << (report.likelyToDropFrames ? "[!!] " : "[ok] ") << qPrintable(report.toString()) << std::endl;
+      if (report.likelyToDropFrames)
+        nProblems++;
+    }
+    std::cout << uris.size() << " media file(s) analyzed, " << nProblems << " likely to cause frame drops "
+              << "(estimated decoding capacity: " << MediaPreflight::decodeCapacity() << ")." << std::endl;
+    return (nProblems > 0 ? 1 : 0);
+  }
 
   // IMPORTANT: Translator must be set *before* the MainWindow is created for it to work.
   QSettings settings;
@@ -216,6 +265,20 @@ int main(int argc, char *argv[])
     projectFileValue = args.first();
   }
 
+  // Synchronization must be started before videos are loaded.
+  bool optionOk;
+  SyncClock::Mode syncMode;
+  if (!SyncClock::modeFromString(parser.value("sync"), &syncMode))
+    qFatal("Invalid option <sync>.");
+  int syncPort = parser.value("sync-port").toInt(&optionOk);
+  if (!optionOk || syncPort <= 0 || syncPort > 65535)
+    qFatal("Invalid option <sync-port>.");
+  if (!SyncClock::start(syncMode, syncPort))
+    qWarning() << "Could not start synchronization: playing unsynchronized." << endl;
+
+  if (parser.isSet(audioInputOption) && !AudioInput::start())
+    qWarning() << "Could not start audio input analysis." << endl;
+
   // finally, load the project file.
   if (projectFileValue != "")
   {
@@ -226,7 +289,6 @@ int main(int argc, char *argv[])
   if (oscPortValue != "")
     win->setOscPort(oscPortValue);
 
-  bool optionOk;
   qreal fps = parser.value("frame-rate").toDouble(&optionOk);
   if (optionOk)
     win->setFramesPerSecond(fps);
@@ -256,5 +318,7 @@ int main(int argc, char *argv[])
   int result = app.exec();
 
   delete win;
+  AudioInput::stop();
+  SyncClock::stop();
   return result;
 }
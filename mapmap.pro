@@ -6,17 +6,22 @@ TARGET = mapmap
 QT += gui opengl xml core network
 greaterThan(QT_MAJOR_VERSION, 4) {
   QT -= gui # using widgets instead gui in Qt5
-  QT += widgets multimedia
+  QT += widgets multimedia concurrent
 }
 DEFINES += UNICODE QT_THREAD_SUPPORT QT_CORE_LIB QT_GUI_LIB
 
 HEADERS  = \
     AboutDialog.h \
+    AudioAnalysis.h \
     Commands.h \
     ConcurrentQueue.h \
     ConsoleWindow.h \
     Element.h \
     Ellipse.h \
+    FrameClock.h \
+    FrameProvider.h \
+    FrameProviderPlugin.h \
+    ImageCompressor.h \
     MM.h \
     MainApplication.h \
     MainWindow.h \
@@ -27,15 +32,19 @@ HEADERS  = \
     MapperGLCanvasToolbar.h \
     Mapping.h \
     MappingManager.h \
+    MediaPreflight.h \
     Maths.h \
     Mesh.h \
     MetaObjectRegistry.h \
+    Modulation.h \
     OscInterface.h \
     OscReceiver.h \
     OutputGLCanvas.h \
     OutputGLWindow.h \
+    OutputRenderer.h \
     Paint.h \
     PaintGui.h \
+    Playlist.h \
     Polygon.h \
     PreferenceDialog.h \
     ProjectLabels.h \
@@ -47,6 +56,8 @@ HEADERS  = \
     Shapes.h \
     ShapeControlPainter.h \
     ShapeGraphicsItem.h \
+    SyncClock.h \
+    TranscodeQueue.h \
     Triangle.h \
     UidAllocator.h \
     Util.h \
@@ -54,14 +65,19 @@ HEADERS  = \
     VideoUriDecodeBinImpl.h \
     VideoV4l2SrcImpl.h \
     VideoShmSrcImpl.h \
+    VideoTestSrcImpl.h \
     GuiForward.h
 
 SOURCES  = \
     AboutDialog.cpp \
+    AudioAnalysis.cpp \
     Commands.cpp \
     ConsoleWindow.cpp \
     Element.cpp \
     Ellipse.cpp \
+    FrameClock.cpp \
+    FrameProvider.cpp \
+    ImageCompressor.cpp \
     MM.cpp \
     MainApplication.cpp \
     MainWindow.cpp \
@@ -72,14 +88,18 @@ SOURCES  = \
     MapperGLCanvasToolbar.cpp \
     Mapping.cpp \
     MappingManager.cpp \
+    MediaPreflight.cpp \
     Mesh.cpp \
     MetaObjectRegistry.cpp \
+    Modulation.cpp \
     OscInterface.cpp \
     OscReceiver.cpp \
     OutputGLCanvas.cpp \
     OutputGLWindow.cpp \
+    OutputRenderer.cpp \
     Paint.cpp \
     PaintGui.cpp \
+    Playlist.cpp \
     Polygon.cpp \
     PreferenceDialog.cpp \
     ProjectLabels.cpp \
@@ -89,12 +109,15 @@ SOURCES  = \
     Shape.cpp \
     ShapeControlPainter.cpp \
     ShapeGraphicsItem.cpp \
+    SyncClock.cpp \
+    TranscodeQueue.cpp \
     UidAllocator.cpp \
     Util.cpp \
     VideoImpl.cpp \
     VideoUriDecodeBinImpl.cpp \
     VideoV4l2SrcImpl.cpp \
     VideoShmSrcImpl.cpp \
+    VideoTestSrcImpl.cpp \
     main.cpp
 
 
@@ -133,7 +156,7 @@ unix:!mac {
   CONFIG += link_pkgconfig
   INCLUDE_PATH +=
   PKGCONFIG += \
-    gstreamer-1.0 gstreamer-base-1.0 gstreamer-app-1.0 gstreamer-pbutils-1.0 \
+    gstreamer-1.0 gstreamer-base-1.0 gstreamer-app-1.0 gstreamer-pbutils-1.0 gstreamer-net-1.0 \
     liblo \
     gl x11
   QMAKE_CXXFLAGS_WARN_ON += -Wno-unused-result -Wno-unused-parameter \
@@ -214,6 +237,7 @@ win32 {
   LIBS += $${GST_HOME}/lib/gstapp-1.0.lib \
     $${GST_HOME}/lib/gstbase-1.0.lib \
     $${GST_HOME}/lib/gstpbutils-1.0.lib \
+    $${GST_HOME}/lib/gstnet-1.0.lib \
     $${GST_HOME}/lib/gstreamer-1.0.lib \
     $${GST_HOME}/lib/gobject-2.0.lib \
     $${GST_HOME}/lib/glib-2.0.lib \